@@ -1,59 +1,90 @@
 #include "account.h"
-#include <sstream>
-#include <iomanip>
-#include <random>
+#include "id_generator.h"
 #include <iostream>
 #include <algorithm>
 
-Account::Account(const std::string& number, AccountType type, double balance)
-    : number_(number), type_(type), balance_(balance), creditLimit_(0.0), status_(AccountStatus::ACTIVE) {}
+Account::Account(const std::string& number, AccountType type, Money balance)
+    : number_(number), type_(type), balance_(balance.cents()), creditLimit_(0), status_(AccountStatus::ACTIVE) {}
 
-bool Account::deposit(double amount, const std::string& description) {
-    if (amount <= 0) return false;
-    
-    balance_ += amount;
-    addTransaction("DEPOSIT", amount, description);
+Account::Account(const Account& other)
+    : number_(other.number_), type_(other.type_),
+      balance_(other.balance_.load()), creditLimit_(other.creditLimit_.load()),
+      status_(other.status_), transactions_(other.transactions_) {}
+
+Account& Account::operator=(const Account& other) {
+    number_ = other.number_;
+    type_ = other.type_;
+    balance_ = other.balance_.load();
+    creditLimit_ = other.creditLimit_.load();
+    status_ = other.status_;
+    transactions_ = other.transactions_;
+    return *this;
+}
+
+Account::Account(Account&& other) noexcept
+    : number_(std::move(other.number_)), type_(other.type_),
+      balance_(other.balance_.load()), creditLimit_(other.creditLimit_.load()),
+      status_(other.status_), transactions_(std::move(other.transactions_)) {}
+
+Account& Account::operator=(Account&& other) noexcept {
+    number_ = std::move(other.number_);
+    type_ = other.type_;
+    balance_ = other.balance_.load();
+    creditLimit_ = other.creditLimit_.load();
+    status_ = other.status_;
+    transactions_ = std::move(other.transactions_);
+    return *this;
+}
+
+bool Account::adjustBalance(Money delta, bool enforceLimit) {
+    int64_t current = balance_.load(std::memory_order_relaxed);
+    Money next;
+    do {
+        Money balance = Money::fromCents(current);
+        // Переполнение баланса - отказ, а не исключение посреди перевода
+        if (!Money::add(balance, delta, next)) {
+            return false;
+        }
+        if (enforceLimit && next < -getCreditLimit()) {
+            return false;
+        }
+    } while (!balance_.compare_exchange_weak(current, next.cents(),
+                                             std::memory_order_acq_rel, std::memory_order_relaxed));
     return true;
 }
 
-bool Account::withdraw(double amount, const std::string& description) {
-    if (amount <= 0) return false;
+bool Account::deposit(Money amount, const std::string& description, Transaction* record) {
+    if (amount <= Money()) return false;
     
-    double availableBalance = balance_ + creditLimit_;
-    if (amount > availableBalance) return false;
-    
-    balance_ -= amount;
-    addTransaction("WITHDRAW", -amount, description);
+    if (!adjustBalance(amount, false)) return false;
+    Transaction transaction = addTransaction("DEPOSIT", amount, description);
+    if (record) *record = std::move(transaction);
     return true;
 }
 
-bool Account::transfer(Account& target, double amount, const std::string& description) {
-    std::string transferDescription = description.empty() ? 
-        "Transfer to " + target.getNumber() : description;
-    
-    if (!withdraw(amount, transferDescription)) {
-        return false;
-    }
-    
-    std::string receiveDescription = "Transfer from " + number_;
-    if (!target.deposit(amount, receiveDescription)) {
-        // Откатываем операцию
-        balance_ += amount;
-        if (!transactions_.empty()) {
-            transactions_.pop_back();
-        }
-        return false;
-    }
+bool Account::withdraw(Money amount, const std::string& description, Transaction* record) {
+    if (amount <= Money()) return false;
     
+    // Проверка лимита и списание - одна атомарная операция
+    if (!adjustBalance(-amount, true)) return false;
+    Transaction transaction = addTransaction("WITHDRAW", -amount, description);
+    if (record) *record = std::move(transaction);
     return true;
 }
 
-void Account::setCreditLimit(double limit) {
-    creditLimit_ = limit;
+void Account::setCreditLimit(Money limit) {
+    creditLimit_.store(limit.cents(), std::memory_order_release);
 }
 
-void Account::addTransaction(const std::string& type, double amount, 
-                           const std::string& description, const std::string& targetAccount) {
+Transaction Account::addTransaction(const std::string& type, Money amount, 
+                                    const std::string& description, const std::string& targetAccount) {
+    Transaction transaction = prepareTransaction(type, amount, description, targetAccount);
+    transactions_.append(transaction);
+    return transaction;
+}
+
+Transaction Account::prepareTransaction(const std::string& type, Money amount,
+                                        const std::string& description, const std::string& targetAccount) {
     Transaction transaction;
     transaction.id = generateTransactionId();
     transaction.timestamp = std::time(nullptr);
@@ -61,21 +92,20 @@ void Account::addTransaction(const std::string& type, double amount,
     transaction.amount = amount;
     transaction.description = description;
     transaction.targetAccount = targetAccount;
-    
-    transactions_.push_back(transaction);
+    return transaction;
+}
+
+void Account::appendTransaction(const Transaction& transaction) {
+    transactions_.append(transaction);
+}
+
+void Account::applyTransaction(const Transaction& transaction) {
+    adjustBalance(transaction.amount, false);
+    transactions_.append(transaction);
 }
 
 std::string Account::generateTransactionId() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 15);
-    
-    std::stringstream ss;
-    ss << "TXN";
-    for (int i = 0; i < 12; i++) {
-        ss << std::hex << dis(gen);
-    }
-    return ss.str();
+    return IdGenerator::next("TXN");
 }
 
 std::string Account::getTypeString() const {
@@ -4,8 +4,10 @@
 #include <string>
 #include <ctime>
 #include <vector>
-#include <random>
 #include <memory>
+#include <atomic>
+#include "money.h"
+#include "transaction_log.h"
 
 enum class AccountType {
     SAVINGS,
@@ -20,49 +22,63 @@ enum class AccountStatus {
     CLOSED
 };
 
-struct Transaction {
-    std::string id;
-    std::time_t timestamp;
-    std::string type;
-    double amount;
-    std::string description;
-    std::string targetAccount;
-};
-
+// Баланс и кредитный лимит - атомарные копейки: пополнение и списание
+// по одному счёту идут CAS-циклом без блокировок и могут выполняться
+// из нескольких потоков одновременно. История пишется в TransactionLog.
+// Копировать счёт можно, только пока с ним никто не работает.
 class Account {
 public:
-    Account(const std::string& number, AccountType type, double balance = 0.0);
+    Account(const std::string& number, AccountType type, Money balance = Money());
+    Account(const Account& other);
+    Account& operator=(const Account& other);
+    Account(Account&& other) noexcept;
+    Account& operator=(Account&& other) noexcept;
+    
+    // record, если задан, получает копию добавленной в историю операции
+    bool deposit(Money amount, const std::string& description = "", Transaction* record = nullptr);
+    bool withdraw(Money amount, const std::string& description = "", Transaction* record = nullptr);
     
-    bool deposit(double amount, const std::string& description = "");
-    bool withdraw(double amount, const std::string& description = "");
-    bool transfer(Account& target, double amount, const std::string& description = "");
+    // Меняет только баланс, без записи в историю; с enforceLimit - только если
+    // баланс не уйдёт за кредитный лимит. Переводы (Database::transfer) сначала
+    // проводят обе суммы и лишь затем пишут историю обоих счетов
+    bool adjustBalance(Money delta, bool enforceLimit);
     
     // Геттеры
     std::string getNumber() const { return number_; }
     AccountType getType() const { return type_; }
-    double getBalance() const { return balance_; }
-    double getCreditLimit() const { return creditLimit_; }
-    const std::vector<Transaction>& getTransactionHistory() const { return transactions_; }
+    Money getBalance() const { return Money::fromCents(balance_.load(std::memory_order_acquire)); }
+    Money getCreditLimit() const { return Money::fromCents(creditLimit_.load(std::memory_order_acquire)); }
+    const TransactionLog& getTransactionHistory() const { return transactions_; }
     AccountStatus getStatus() const { return status_; }
     
     // Сеттеры
-    void setCreditLimit(double limit);
+    void setCreditLimit(Money limit);
     void setStatus(AccountStatus status) { status_ = status; }
     
     // Работа с транзакциями
-    void addTransaction(const std::string& type, double amount, 
-                       const std::string& description = "", 
-                       const std::string& targetAccount = "");
+    Transaction addTransaction(const std::string& type, Money amount, 
+                               const std::string& description = "", 
+                               const std::string& targetAccount = "");
+    // Операция с новым id и временем, но без добавления в историю: Database
+    // сначала пишет её в журнал и добавляет (appendTransaction), только если запись удалась
+    Transaction prepareTransaction(const std::string& type, Money amount,
+                                   const std::string& description = "",
+                                   const std::string& targetAccount = "");
+    // Восстановление истории при загрузке: запись добавляется как есть,
+    // applyTransaction дополнительно проводит сумму по балансу
+    void appendTransaction(const Transaction& transaction);
+    void applyTransaction(const Transaction& transaction);
+    void reserveHistory(size_t count) { transactions_.reserve(count); }
     
     std::string getTypeString() const;
     
 private:
     std::string number_;
     AccountType type_;
-    double balance_;
-    double creditLimit_;
+    std::atomic<int64_t> balance_;
+    std::atomic<int64_t> creditLimit_;
     AccountStatus status_;
-    std::vector<Transaction> transactions_;
+    TransactionLog transactions_;
     
     std::string generateTransactionId();
 };
@@ -0,0 +1,106 @@
+#include "account_id_allocator.h"
+#include "durable_file.h"
+#include <fstream>
+#include <iostream>
+
+AccountIdAllocator::AccountIdAllocator(const std::string& filename)
+    : filename_(filename), next_(1), reserved_(0) {
+    std::ifstream file(filename_);
+    uint64_t ceiling = 0;
+    if (file >> ceiling) {
+        // Выданное прошлым запуском лежит ниже границы; начинаем с неё
+        next_ = ceiling > 0 ? ceiling : 1;
+        reserved_ = ceiling;
+    }
+}
+
+std::string AccountIdAllocator::allocate() {
+    uint64_t sequence = next_.fetch_add(1);
+    if (sequence > kMaxSequence) {
+        // Десятая цифра не помещается: номер совпал бы с уже выданным
+        next_.store(kMaxSequence + 1);
+        std::cerr << "Error: Account id space exhausted" << std::endl;
+        return "";
+    }
+    if (sequence >= reserved_.load(std::memory_order_acquire)) {
+        // Номер из ещё не записанного блока выдаётся только после записи границы
+        std::lock_guard<std::mutex> lock(reserveMutex_);
+        if (sequence >= reserved_.load(std::memory_order_relaxed)) {
+            reserveUpTo((sequence / kBlockSize + 1) * kBlockSize);
+        }
+    }
+    return format(sequence);
+}
+
+void AccountIdAllocator::reserveUpTo(uint64_t ceiling) {
+    // Граница заменяется атомарно: сбой не оставит пустой файл и повтор номеров
+    if (!DurableFile::write(filename_, std::to_string(ceiling) + "\n")) {
+        std::cerr << "Error: Could not save account id high-water mark: " << filename_ << std::endl;
+        // Номер всё равно выдаётся: после перезапуска повтор исключит observe по базе
+    }
+    reserved_.store(ceiling, std::memory_order_release);
+}
+
+void AccountIdAllocator::observe(const std::string& accountId) {
+    uint64_t sequence = parseSequence(accountId);
+    if (sequence == 0) {
+        return;
+    }
+    uint64_t next = next_.load();
+    while (next <= sequence && !next_.compare_exchange_weak(next, sequence + 1)) {
+    }
+}
+
+int AccountIdAllocator::luhnDigit(const char* digits, size_t count) {
+    // Удваивается каждая вторая цифра справа, начиная с последней:
+    // контрольная цифра потом встанет справа от них
+    int sum = 0;
+    bool doubled = true;
+    for (size_t i = count; i-- > 0;) {
+        int digit = digits[i] - '0';
+        if (doubled) {
+            digit *= 2;
+            if (digit > 9) digit -= 9;
+        }
+        sum += digit;
+        doubled = !doubled;
+    }
+    return (10 - sum % 10) % 10;
+}
+
+std::string AccountIdAllocator::format(uint64_t sequence) {
+    char buffer[kLength];
+    buffer[0] = 'A';
+    buffer[1] = 'C';
+    buffer[2] = 'C';
+    for (size_t i = kLength - 2; i >= 3; i--) {
+        buffer[i] = static_cast<char>('0' + sequence % 10);
+        sequence /= 10;
+    }
+    buffer[kLength - 1] = static_cast<char>('0' + luhnDigit(buffer + 3, kLength - 4));
+    return std::string(buffer, kLength);
+}
+
+uint64_t AccountIdAllocator::parseSequence(const std::string& accountId, bool* checkDigitValid) {
+    if (accountId.size() != kLength || accountId.compare(0, 3, "ACC") != 0) {
+        return 0;
+    }
+    uint64_t sequence = 0;
+    for (size_t i = 3; i < kLength; i++) {
+        if (accountId[i] < '0' || accountId[i] > '9') {
+            return 0;
+        }
+        if (i < kLength - 1) {
+            sequence = sequence * 10 + (accountId[i] - '0');
+        }
+    }
+    bool valid = accountId[kLength - 1] - '0' == luhnDigit(accountId.data() + 3, kLength - 4);
+    if (checkDigitValid) *checkDigitValid = valid;
+    return valid ? sequence : 0;
+}
+
+bool AccountIdAllocator::isMistyped(const std::string& accountId) {
+    bool valid = true;
+    parseSequence(accountId, &valid);
+    return !valid;
+}
@@ -0,0 +1,50 @@
+#ifndef ACCOUNT_ID_ALLOCATOR_H
+#define ACCOUNT_ID_ALLOCATOR_H
+
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// Выдача номеров клиентов при регистрации: "ACC" + 9 цифр порядкового
+// номера + контрольная цифра Луна, например ACC0000012346.
+//
+// Номер берётся атомарным счётчиком - без повторных попыток и без поиска
+// по базе, стоимость не зависит от числа клиентов. На диске (<база>.ids)
+// хранится верхняя граница выданного блока номеров; файл переписывается
+// раз в kBlockSize регистраций. После перезапуска выдача продолжается с
+// этой границы, недоиспользованный остаток блока пропускается. Номера
+// загруженных клиентов (observe) дополнительно сдвигают счётчик - на случай
+// потери файла границы
+class AccountIdAllocator {
+public:
+    static const uint64_t kBlockSize = 1000;
+    static constexpr size_t kLength = 13;
+    static constexpr uint64_t kMaxSequence = 999999999;
+
+    explicit AccountIdAllocator(const std::string& filename);
+
+    // Пустая строка - номера кончились
+    std::string allocate();
+    // Учитывает уже существующий номер: следующие будут больше
+    void observe(const std::string& accountId);
+
+    // Номер нашего формата с неверной контрольной цифрой - опечатка при вводе.
+    // Номера старых форматов (ACC1234, SUPER001) сюда не попадают
+    static bool isMistyped(const std::string& accountId);
+    static std::string format(uint64_t sequence);
+
+private:
+    // Порядковый номер из id нашего формата, 0 - формат другой
+    static uint64_t parseSequence(const std::string& accountId, bool* checkDigitValid = nullptr);
+    static int luhnDigit(const char* digits, size_t count);
+    void reserveUpTo(uint64_t ceiling);
+
+    std::string filename_;
+    std::atomic<uint64_t> next_;
+    std::atomic<uint64_t> reserved_;    // номера ниже этой границы уже записаны на диск
+    std::mutex reserveMutex_;
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include "approval_rules.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <functional>
+#include <sys/stat.h>
+
+namespace {
+
+const int64_t kSecondsPerDay = 24 * 60 * 60;
+
+// Список через запятую: "TRANSFER,WITHDRAW"
+std::vector<std::string> splitList(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+}
+
+ApprovalRules::ApprovalRules() : rules_(std::make_shared<const RuleSet>()) {}
+
+unsigned ApprovalRules::operationBit(const std::string& operationType) {
+    if (operationType == "WITHDRAW") return kWithdraw;
+    if (operationType == "TRANSFER") return kTransfer;
+    if (operationType == "BATCH_TRANSFER") return kBatchTransfer;
+    return 0;
+}
+
+bool ApprovalRules::parseRule(const std::string& text, size_t line, Rule& rule) {
+    std::stringstream ss(text);
+    std::string action;
+    ss >> action;
+    if (action != "APPROVE" && action != "REVIEW") {
+        std::cerr << "Rules line " << line << ": unknown action '" << action << "'" << std::endl;
+        return false;
+    }
+    rule.line = line;
+    rule.approve = action == "APPROVE";
+
+    std::string condition;
+    while (ss >> condition) {
+        size_t eq = condition.find('=');
+        if (eq == std::string::npos || eq + 1 == condition.size()) {
+            std::cerr << "Rules line " << line << ": expected key=value, got '" << condition << "'" << std::endl;
+            return false;
+        }
+        std::string key = condition.substr(0, eq);
+        std::string value = condition.substr(eq + 1);
+
+        try {
+            if (key == "op") {
+                rule.operations = 0;
+                for (const auto& name : splitList(value)) {
+                    unsigned bit = operationBit(name);
+                    if (bit == 0) {
+                        std::cerr << "Rules line " << line << ": unknown operation '" << name << "'" << std::endl;
+                        return false;
+                    }
+                    rule.operations |= bit;
+                }
+            } else if (key == "min_amount") {
+                rule.minAmount = Money::parse(value);
+                rule.hasMinAmount = true;
+            } else if (key == "max_amount") {
+                rule.maxAmount = Money::parse(value);
+                rule.hasMaxAmount = true;
+            } else if (key == "trusted") {
+                rule.trusted = splitList(value);
+                std::sort(rule.trusted.begin(), rule.trusted.end());
+            } else if (key == "min_age_days") {
+                rule.minAge = static_cast<std::time_t>(std::stol(value)) * kSecondsPerDay;
+            } else if (key == "max_daily_amount") {
+                rule.maxDailyAmount = Money::parse(value);
+                rule.hasDailyAmount = true;
+            } else if (key == "max_daily_count") {
+                rule.maxDailyCount = static_cast<uint32_t>(std::stoul(value));
+            } else {
+                std::cerr << "Rules line " << line << ": unknown condition '" << key << "'" << std::endl;
+                return false;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Rules line " << line << ": invalid value in '" << condition << "'" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ApprovalRules::load(const std::string& filename) {
+    std::lock_guard<std::mutex> lock(reloadMutex_);
+    filename_ = filename;
+
+    struct stat info{};
+    if (stat(filename.c_str(), &info) != 0) {
+        // Файла нет - правил нет, всё решают сотрудники
+        std::atomic_store(&rules_, std::make_shared<const RuleSet>());
+        loadedMtime_ = 0;
+        loadedSize_ = 0;
+        return true;
+    }
+
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Error: Could not open rules file: " << filename << std::endl;
+        return false;
+    }
+
+    auto rules = std::make_shared<RuleSet>();
+    std::string text;
+    size_t line = 0;
+    while (std::getline(file, text)) {
+        line++;
+        size_t start = text.find_first_not_of(" \t\r");
+        if (start == std::string::npos || text[start] == '#') {
+            continue;
+        }
+
+        Rule rule;
+        if (!parseRule(text, line, rule)) {
+            std::cerr << "Rules file " << filename << " rejected, keeping previous rules" << std::endl;
+            loadedMtime_ = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+            loadedSize_ = info.st_size;
+            return false;
+        }
+        rules->push_back(std::move(rule));
+    }
+
+    std::atomic_store(&rules_, std::shared_ptr<const RuleSet>(std::move(rules)));
+    loadedMtime_ = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    loadedSize_ = info.st_size;
+    std::cout << "Loaded " << ruleCount() << " approval rules from " << filename << std::endl;
+    return true;
+}
+
+bool ApprovalRules::reloadIfChanged() {
+    std::string filename;
+    {
+        std::lock_guard<std::mutex> lock(reloadMutex_);
+        if (filename_.empty()) {
+            return false;
+        }
+
+        struct stat info{};
+        int64_t mtime = 0, size = 0;
+        if (stat(filename_.c_str(), &info) == 0) {
+            mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+            size = info.st_size;
+        }
+        if (mtime == loadedMtime_ && size == loadedSize_) {
+            return false;
+        }
+        filename = filename_;
+    }
+    return load(filename);
+}
+
+size_t ApprovalRules::ruleCount() const {
+    return std::atomic_load(&rules_)->size();
+}
+
+bool ApprovalRules::matches(const Rule& rule, const ApprovalRequest& request, unsigned operation,
+                            std::time_t accountOpenedAt, std::time_t now) const {
+    if (!(rule.operations & operation)) return false;
+    if (rule.hasMinAmount && request.amount < rule.minAmount) return false;
+    if (rule.hasMaxAmount && request.amount > rule.maxAmount) return false;
+    if (rule.minAge > 0 && now - accountOpenedAt < rule.minAge) return false;
+
+    if (!rule.trusted.empty()) {
+        // Снятие наличных получателя не имеет - под доверенных не подходит
+        if (request.items.empty()) return false;
+        for (const TransferItem& item : request.items) {
+            if (item.toNumber.empty() ||
+                !std::binary_search(rule.trusted.begin(), rule.trusted.end(), item.toNumber)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool ApprovalRules::tryApprove(const ApprovalRequest& request, std::time_t accountOpenedAt, std::time_t now,
+                               size_t* ruleLine) {
+    unsigned operation = operationBit(request.operationType);
+    if (operation == 0) {
+        return false;
+    }
+
+    std::shared_ptr<const RuleSet> rules = std::atomic_load(&rules_);
+    VelocityStripe& stripe = velocity_[std::hash<std::string>{}(request.clientAccountId) % kVelocityStripes];
+    int64_t day = now / kSecondsPerDay;
+
+    for (const Rule& rule : *rules) {
+        if (!matches(rule, request, operation, accountOpenedAt, now)) {
+            continue;
+        }
+        if (!rule.approve) {
+            return false;
+        }
+
+        // Проверка лимитов и учёт - под одной блокировкой: две параллельные
+        // операции не пройдут обе по последнему остатку суточного лимита
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        if (stripe.day != day) {
+            stripe.day = day;
+            stripe.clients.clear();
+        }
+        Velocity used;
+        auto it = stripe.clients.find(request.clientAccountId);
+        if (it != stripe.clients.end()) {
+            used = it->second;
+        }
+        Money dailyAmount;
+        if (!Money::add(used.amount, request.amount, dailyAmount) ||
+            (rule.hasDailyAmount && dailyAmount > rule.maxDailyAmount) ||
+            (rule.maxDailyCount > 0 && used.count + 1 > rule.maxDailyCount)) {
+            continue; // лимит исчерпан - решают следующие правила
+        }
+        Velocity& velocity = it != stripe.clients.end() ? it->second : stripe.clients[request.clientAccountId];
+        velocity.amount = dailyAmount;
+        velocity.count = used.count + 1;
+
+        if (ruleLine) *ruleLine = rule.line;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,104 @@
+#ifndef APPROVAL_RULES_H
+#define APPROVAL_RULES_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <ctime>
+#include <cstdint>
+#include <cstddef>
+#include "money.h"
+#include "approval_store.h"
+
+// Правила автоматического одобрения крупных операций.
+//
+// Файл правил - по одному правилу в строке, действие и условия через пробел:
+//
+//   # доверенные получатели - без ограничений по возрасту счёта
+//   APPROVE op=TRANSFER trusted=SAV_1001,CHK_2002 max_amount=500000
+//   APPROVE op=TRANSFER,WITHDRAW max_amount=300000 min_age_days=90 max_daily_amount=600000 max_daily_count=3
+//   REVIEW op=BATCH_TRANSFER
+//
+// Условия: op, min_amount, max_amount, trusted (все получатели операции из
+// списка), min_age_days (возраст счёта списания по первой операции),
+// max_daily_amount и max_daily_count (автоодобренное клиентом за текущие
+// сутки, включая эту операцию). Решает первое подходящее правило;
+// если не подошло ни одно - запрос идёт сотруднику.
+//
+// Правила разбираются один раз при загрузке; проверка блокирует только полосу
+// счётчиков своего клиента. Перезагрузка подменяет набор правил целиком, уже
+// идущие проверки дорабатывают на старом
+class ApprovalRules {
+public:
+    // Пустой набор: всё идёт сотруднику
+    ApprovalRules();
+
+    // Разбирает файл и подменяет правила. При ошибке разбора остаются прежние;
+    // отсутствующий файл - пустой набор
+    bool load(const std::string& filename);
+    // Перечитывает файл, если он изменился с прошлой загрузки
+    bool reloadIfChanged();
+
+    // true - операцию одобряет правило ruleLine (номер строки файла);
+    // при одобрении операция сразу учитывается в суточных счётчиках клиента
+    bool tryApprove(const ApprovalRequest& request, std::time_t accountOpenedAt, std::time_t now,
+                    size_t* ruleLine = nullptr);
+
+    size_t ruleCount() const;
+
+private:
+    enum OperationBits : unsigned {
+        kWithdraw = 1,
+        kTransfer = 2,
+        kBatchTransfer = 4
+    };
+
+    struct Rule {
+        size_t line;
+        bool approve;
+        unsigned operations = kWithdraw | kTransfer | kBatchTransfer;
+        bool hasMinAmount = false;
+        bool hasMaxAmount = false;
+        Money minAmount;
+        Money maxAmount;
+        std::vector<std::string> trusted;   // отсортирован; пустой - условия нет
+        std::time_t minAge = 0;
+        bool hasDailyAmount = false;
+        Money maxDailyAmount;
+        uint32_t maxDailyCount = 0;         // 0 - без ограничения
+    };
+    using RuleSet = std::vector<Rule>;
+
+    // Суточные счётчики автоодобрений - у каждого клиента свои. Клиенты
+    // разложены по полосам по хешу номера: полоса - блокировка и таблица
+    // счётчиков её клиентов. В таблице только клиенты, получившие автоодобрение
+    // за текущие сутки; со сменой суток полоса очищается при первом обращении
+    struct Velocity {
+        Money amount;
+        uint32_t count = 0;
+    };
+    struct VelocityStripe {
+        std::mutex mutex;
+        int64_t day = -1;
+        std::unordered_map<std::string, Velocity> clients;
+    };
+    static const size_t kVelocityStripes = 1024;
+
+    static unsigned operationBit(const std::string& operationType);
+    static bool parseRule(const std::string& text, size_t line, Rule& rule);
+    bool matches(const Rule& rule, const ApprovalRequest& request, unsigned operation,
+                 std::time_t accountOpenedAt, std::time_t now) const;
+
+    std::string filename_;
+    std::mutex reloadMutex_;
+    int64_t loadedMtime_ = -1;      // наносекунды; -1 - файл не загружался
+    int64_t loadedSize_ = -1;
+
+    std::shared_ptr<const RuleSet> rules_;  // читается через std::atomic_load
+    std::array<VelocityStripe, kVelocityStripes> velocity_;
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "approval_store.h"
+#include "journal.h"
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+bool ApprovalStore::add(const ApprovalRequest& request) {
+    if (index_.count(request.requestId)) {
+        return false;
+    }
+    requests_.push_back(request);
+    index_.emplace(request.requestId, std::prev(requests_.end()));
+    return true;
+}
+
+bool ApprovalStore::remove(const std::string& requestId) {
+    auto it = index_.find(requestId);
+    if (it == index_.end()) {
+        return false;
+    }
+    requests_.erase(it->second);
+    index_.erase(it);
+    return true;
+}
+
+void ApprovalStore::clear() {
+    requests_.clear();
+    index_.clear();
+}
+
+ApprovalRequest* ApprovalStore::find(const std::string& requestId) {
+    auto it = index_.find(requestId);
+    return it != index_.end() ? &*it->second : nullptr;
+}
+
+const ApprovalRequest* ApprovalStore::find(const std::string& requestId) const {
+    auto it = index_.find(requestId);
+    return it != index_.end() ? &*it->second : nullptr;
+}
+
+const ApprovalRequest* ApprovalStore::lookup(const std::string& key) const {
+    if (const ApprovalRequest* request = find(key)) {
+        return request;
+    }
+    
+    bool numeric = !key.empty() && key.size() < 10 &&
+                   std::all_of(key.begin(), key.end(), [](unsigned char c) { return std::isdigit(c); });
+    if (!numeric) {
+        return nullptr;
+    }
+    size_t index = std::stoul(key);
+    if (index >= requests_.size()) {
+        return nullptr;
+    }
+    return &*std::next(requests_.begin(), index);
+}
+
+void ApprovalStore::serialize(const ApprovalRequest& request, std::string& out) {
+    // Текстовые поля экранируются: описание приходит от клиента и не должно
+    // подменять счёт списания или строки операции при восстановлении
+    Journal::appendField(out, request.requestId);
+    Journal::appendField(out, request.clientAccountId);
+    Journal::appendField(out, request.operationType);
+    request.amount.appendTo(out);
+    out += '|';
+    Journal::appendField(out, request.targetAccount);
+    Journal::appendField(out, request.description);
+    out += std::to_string(request.timestamp);
+    out += '|';
+    Journal::appendField(out, request.status);
+    Journal::appendField(out, request.sourceAccount);
+    out += request.atomic ? '1' : '0';
+    out += '|';
+    // Строки операции - в конце: число, затем "получатель|сумма|описание|" на каждую
+    out += std::to_string(request.items.size());
+    out += '|';
+    for (const TransferItem& item : request.items) {
+        Journal::appendField(out, item.toNumber);
+        item.amount.appendTo(out);
+        out += '|';
+        Journal::appendField(out, item.description);
+    }
+}
+
+bool ApprovalStore::parse(std::istream& in, ApprovalRequest& request) {
+    std::string amountStr, timestampStr, atomicStr, countStr;
+    if (!Journal::readField(in, request.requestId) ||
+        !Journal::readField(in, request.clientAccountId) ||
+        !Journal::readField(in, request.operationType) ||
+        !Journal::readField(in, amountStr) ||
+        !Journal::readField(in, request.targetAccount) ||
+        !Journal::readField(in, request.description) ||
+        !Journal::readField(in, timestampStr) ||
+        !Journal::readField(in, request.status) ||
+        !Journal::readField(in, request.sourceAccount) ||
+        !Journal::readField(in, atomicStr) ||
+        !Journal::readField(in, countStr)) {
+        return false;
+    }
+    
+    try {
+        request.amount = Money::parse(amountStr);
+        request.timestamp = std::stol(timestampStr);
+        request.atomic = atomicStr == "1";
+        
+        size_t count = std::stoul(countStr);
+        request.items.clear();
+        for (size_t i = 0; i < count; i++) {
+            TransferItem item;
+            if (!Journal::readField(in, item.toNumber) ||
+                !Journal::readField(in, amountStr) ||
+                !Journal::readField(in, item.description)) {
+                return false;
+            }
+            item.amount = Money::parse(amountStr);
+            request.items.push_back(std::move(item));
+        }
+    } catch (const std::exception& e) {
+        return false;
+    }
+    return !request.items.empty();
+}
@@ -0,0 +1,60 @@
+#ifndef APPROVAL_STORE_H
+#define APPROVAL_STORE_H
+
+#include <string>
+#include <ctime>
+#include <list>
+#include <vector>
+#include <istream>
+#include <unordered_map>
+#include "money.h"
+#include "database.h"
+
+struct ApprovalRequest {
+    std::string requestId;
+    std::string clientAccountId;
+    std::string operationType;
+    Money amount;
+    std::string targetAccount;
+    std::string description;
+    std::time_t timestamp;
+    std::string status;
+    // Что выполнить после одобрения - достаточно, чтобы повторить операцию после перезапуска.
+    // WITHDRAW - одна строка без получателя, TRANSFER - одна строка, BATCH_TRANSFER - весь пакет
+    std::string sourceAccount;
+    std::vector<TransferItem> items;
+    bool atomic = true;
+};
+
+// Очередь запросов на одобрение (или верификацию): список в порядке поступления
+// и индекс по id. Поиск, смена статуса и удаление по id - O(1), без копирования
+// очереди. Сама по себе не потокобезопасна: сервер работает с ней под approvalMutex_
+class ApprovalStore {
+public:
+    using const_iterator = std::list<ApprovalRequest>::const_iterator;
+
+    // false, если запрос с таким id уже есть
+    bool add(const ApprovalRequest& request);
+    bool remove(const std::string& requestId);
+    void clear();
+
+    ApprovalRequest* find(const std::string& requestId);
+    const ApprovalRequest* find(const std::string& requestId) const;
+    // Запрос по id или по номеру в выводе PENDING_* (номер - для старых клиентов, O(n))
+    const ApprovalRequest* lookup(const std::string& key) const;
+
+    size_t size() const { return requests_.size(); }
+    bool empty() const { return requests_.empty(); }
+    const_iterator begin() const { return requests_.begin(); }
+    const_iterator end() const { return requests_.end(); }
+
+    // Запрос одной строкой через '|' (журнал одобрений) и обратно
+    static void serialize(const ApprovalRequest& request, std::string& out);
+    static bool parse(std::istream& in, ApprovalRequest& request);
+
+private:
+    std::list<ApprovalRequest> requests_;
+    std::unordered_map<std::string, std::list<ApprovalRequest>::iterator> index_;
+};
+
+#endif
@@ -6,6 +6,7 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
+#include <cerrno>
 #include <thread>
 
 BankClient::BankClient(const std::string& serverHost, int serverPort)
@@ -112,16 +113,27 @@ bool BankClient::sendCommand(const std::string& command) {
 std::string BankClient::receiveResponse() {
     if (!connected_) return "";
     
+    // Ответ сервера может прийти несколькими кусками или вместе со следующим
+    std::string response;
     char buffer[4096];
-    memset(buffer, 0, sizeof(buffer));
-    
-    int bytesRead = recv(sockfd_, buffer, sizeof(buffer) - 1, 0);
-    if (bytesRead <= 0) {
-        connected_ = false;
-        return "";
+    while (!inBuffer_.nextFrame(response)) {
+        if (inBuffer_.overflow()) {
+            connected_ = false;
+            return "";
+        }
+        
+        int bytesRead = recv(sockfd_, buffer, sizeof(buffer), 0);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            connected_ = false;
+            return "";
+        }
+        inBuffer_.append(buffer, bytesRead);
     }
     
-    return std::string(buffer);
+    return response;
 }
 
 void BankClient::clearInputBuffer() {
@@ -2,6 +2,7 @@
 #define CLIENT_H
 
 #include <string>
+#include "protocol.h"
 
 class BankClient {
 public:
@@ -15,6 +16,7 @@ private:
     int serverPort_;
     int sockfd_;
     bool connected_;
+    MessageBuffer inBuffer_;
     
     void displayMenu();
     void processUserInput();
@@ -0,0 +1,66 @@
+#include "crc32c.h"
+#include <cstring>
+
+namespace {
+
+// Отражённый полином 0x1EDC6F41
+const uint32_t kPolynomial = 0x82F63B78;
+
+struct Tables {
+    uint32_t t[8][256];
+
+    Tables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (kPolynomial & (0u - (crc & 1)));
+            }
+            t[0][i] = crc;
+        }
+        // t[k][i] - сумма байта i, за которым идут k нулевых байт
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+}
+
+uint32_t Crc32c::compute(const void* data, size_t size, uint32_t crc) {
+    // Таблицы строятся при первом вызове - порядок инициализации глобальных не важен
+    static const Tables tables;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const auto& t = tables.t;
+    crc = ~crc;
+
+    // Выравниваем начало, чтобы читать по 8 байт
+    while (size > 0 && reinterpret_cast<uintptr_t>(p) % 8 != 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+        size--;
+    }
+
+    while (size >= 8) {
+        uint32_t low, high;
+        std::memcpy(&low, p, 4);
+        std::memcpy(&high, p + 4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        low = __builtin_bswap32(low);
+        high = __builtin_bswap32(high);
+#endif
+        low ^= crc;
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^
+              t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^
+              t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+        p += 8;
+        size -= 8;
+    }
+
+    while (size > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+        size--;
+    }
+    return ~crc;
+}
@@ -0,0 +1,16 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstdint>
+#include <cstddef>
+
+// CRC-32C (полином Кастаньоли, как в iSCSI и ext4) методом slicing-by-8:
+// восемь таблиц по 256 значений, за шаг цикла обрабатывается 8 байт.
+// Без аппаратных инструкций, одинаково на любой платформе
+class Crc32c {
+public:
+    // crc - сумма предыдущих данных, чтобы считать по частям
+    static uint32_t compute(const void* data, size_t size, uint32_t crc = 0);
+};
+
+#endif
@@ -3,6 +3,7 @@
 #include <sstream>
 #include <iomanip>
 #include <vector>
+#include <array>
 
 std::string Crypto::encrypt(const std::string& plaintext, const std::string& key) {
     std::vector<unsigned char> data(plaintext.begin(), plaintext.end());
@@ -17,6 +18,44 @@ std::string Crypto::decrypt(const std::string& ciphertext, const std::string& ke
     return std::string(data.begin(), data.end());
 }
 
+bool Crypto::decryptChunk(const char* ciphertext, size_t length, size_t offset,
+                          const std::string& key, char* out) {
+    // Таблица значений символов base64; -1 - недопустимый символ
+    static const auto table = []() {
+        std::array<signed char, 256> values;
+        values.fill(-1);
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; i++) {
+            values[static_cast<unsigned char>(alphabet[i])] = static_cast<signed char>(i);
+        }
+        return values;
+    }();
+    
+    if (length % 4 != 0) return false;
+    
+    std::string derivedKey = deriveKey(key);
+    size_t keyIndex = offset % derivedKey.length();
+    
+    for (size_t i = 0; i < length; i += 4) {
+        int a = table[static_cast<unsigned char>(ciphertext[i])];
+        int b = table[static_cast<unsigned char>(ciphertext[i + 1])];
+        int c = table[static_cast<unsigned char>(ciphertext[i + 2])];
+        int d = table[static_cast<unsigned char>(ciphertext[i + 3])];
+        if ((a | b | c | d) < 0) return false;
+        
+        unsigned char bytes[3] = {
+            static_cast<unsigned char>((a << 2) | (b >> 4)),
+            static_cast<unsigned char>(((b & 0x0f) << 4) | (c >> 2)),
+            static_cast<unsigned char>(((c & 0x03) << 6) | d)
+        };
+        for (unsigned char byte : bytes) {
+            *out++ = static_cast<char>(byte ^ static_cast<unsigned char>(derivedKey[keyIndex]));
+            if (++keyIndex == derivedKey.length()) keyIndex = 0;
+        }
+    }
+    return true;
+}
+
 std::string Crypto::hashPassword(const std::string& password) {
     // Простой хэш для демонстрации
     unsigned long hash = 5381;
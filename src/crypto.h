@@ -8,6 +8,11 @@ class Crypto {
 public:
     static std::string encrypt(const std::string& plaintext, const std::string& key);
     static std::string decrypt(const std::string& ciphertext, const std::string& key);
+    // Расшифровка фрагмента base64 без '=' (длина кратна 4) в out.
+    // offset - позиция фрагмента в расшифрованных данных, от неё зависит байт ключа.
+    // Фрагменты независимы, поэтому большой файл можно расшифровывать параллельно
+    static bool decryptChunk(const char* ciphertext, size_t length, size_t offset,
+                             const std::string& key, char* out);
     static std::string hashPassword(const std::string& password);
     static bool verifyPassword(const std::string& password, const std::string& hash);
     
@@ -1,53 +1,464 @@
 #include "database.h"
 #include "crypto.h"
+#include "snapshot.h"
+#include "durable_file.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cctype>
+#include <cstring>
+#include <cstdio>
+#include <functional>
 
-Database::Database(const std::string& filename) : filename_(filename) {
+namespace {
+
+// Сколько записей журнала накапливается до записи изменённых сегментов
+const size_t kCheckpointInterval = 1000;
+
+// Первая строка снимка: LSN последней записи журнала, вошедшей в снимок
+const std::string kLsnHeader = "@LSN|";
+
+// Файл базы или сегмента целиком: с контрольными суммами, заменой через временный файл
+bool writeDatabaseFile(const std::string& path, std::string data) {
+    DurableFile::appendChecksums(data);
+    return DurableFile::write(path, data);
+}
+
+// Основной файл или копия прежних версий: снимок версии ниже 3 или текст
+bool isLegacyDatabaseFile(const char* data, size_t size) {
+    return Snapshot::isSnapshot(data, size) ? Snapshot::isLegacy(data, size)
+                                            : DurableFile::isLegacyText(data, size);
+}
+
+// Настройки прежних версий - зашифрованная строка в base64
+bool isLegacySettings(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        unsigned char c = data[i];
+        if (!std::isalnum(c) && c != '+' && c != '/' && c != '=' && !std::isspace(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Копия настроек с проверкой сумм; файл прежней версии при копировании получает суммы
+bool copySettingsFile(const std::string& from, const std::string& to) {
+    std::string data;
+    if (!DurableFile::read(from, data, isLegacySettings)) {
+        return false;
+    }
+    return writeDatabaseFile(to, std::move(data));
+}
+
+// Поля перевода после счёта списания: сумма и время общие,
+// у сторон свои идентификаторы и описания (текстовые поля экранируются)
+void appendTransferFields(std::string& body, const std::string& toNumber,
+                          const Transaction& debit, const Transaction& credit) {
+    Journal::appendField(body, toNumber);
+    credit.amount.appendTo(body);
+    body += '|';
+    body += std::to_string(debit.timestamp);
+    body += '|';
+    Journal::appendField(body, debit.id);
+    Journal::appendField(body, credit.id);
+    Journal::appendField(body, debit.description);
+    Journal::appendField(body, credit.description);
+}
+
+// Поля операции истории: id, время, тип, сумма, описание, получатель
+void appendTransactionFields(std::string& body, const Transaction& transaction) {
+    Journal::appendField(body, transaction.id);
+    body += std::to_string(transaction.timestamp);
+    body += '|';
+    Journal::appendField(body, transaction.type);
+    transaction.amount.appendTo(body);
+    body += '|';
+    // Описание задаёт клиент: '|' в нём не должен сдвинуть сумму и получателя
+    Journal::appendField(body, transaction.description);
+    Journal::appendField(body, transaction.targetAccount);
+}
+
+bool readTransactionFields(std::istream& fields, Transaction& transaction) {
+    std::string timestampStr, amountStr;
+    if (!Journal::readField(fields, transaction.id) ||
+        !Journal::readField(fields, timestampStr) ||
+        !Journal::readField(fields, transaction.type) ||
+        !Journal::readField(fields, amountStr) ||
+        !Journal::readField(fields, transaction.description) ||
+        !Journal::readField(fields, transaction.targetAccount)) {
+        return false;
+    }
+    try {
+        transaction.timestamp = std::stol(timestampStr);
+        transaction.amount = Money::parseLegacy(amountStr);
+    } catch (const std::exception& e) {
+        return false;
+    }
+    return true;
+}
+
+// Поля счёта: номер, тип, баланс, кредитный лимит, статус
+void appendAccountFields(std::string& body, const Account& account) {
+    Journal::appendField(body, account.getNumber());
+    body += std::to_string(static_cast<int>(account.getType()));
+    body += '|';
+    account.getBalance().appendTo(body);
+    body += '|';
+    account.getCreditLimit().appendTo(body);
+    body += '|';
+    body += std::to_string(static_cast<int>(account.getStatus()));
+    body += '|';
+}
+
+bool readAccountFields(std::istream& fields, std::vector<Account>& accounts) {
+    std::string number, typeStr, balanceStr, limitStr, statusStr;
+    if (!Journal::readField(fields, number) ||
+        !Journal::readField(fields, typeStr) ||
+        !Journal::readField(fields, balanceStr) ||
+        !Journal::readField(fields, limitStr) ||
+        !Journal::readField(fields, statusStr)) {
+        return false;
+    }
+    try {
+        Account account(number, static_cast<AccountType>(std::stoi(typeStr)), Money::parseLegacy(balanceStr));
+        account.setCreditLimit(Money::parseLegacy(limitStr));
+        account.setStatus(static_cast<AccountStatus>(std::stoi(statusStr)));
+        accounts.push_back(std::move(account));
+    } catch (const std::exception& e) {
+        return false;
+    }
+    return true;
+}
+
+// Число в отдельном поле записи (счётчики строк, статусы)
+bool readCountField(std::istream& fields, size_t& count) {
+    std::string text;
+    if (!Journal::readField(fields, text) || text.empty() ||
+        text.find_first_not_of("0123456789") != std::string::npos || text.size() > 9) {
+        return false;
+    }
+    count = std::stoul(text);
+    return true;
+}
+
+// Клиент целиком: анкета, счета и их истории. Разбирается полностью до того,
+// как что-то из записи попадёт в базу
+void appendClientFields(std::string& body, const ClientData& client) {
+    Journal::appendField(body, client.accountId);
+    Journal::appendField(body, client.fullName);
+    Journal::appendField(body, client.birthDate);
+    Journal::appendField(body, client.passportData);
+    Journal::appendField(body, client.passwordHash);
+    body += std::to_string(static_cast<int>(client.status));
+    body += '|';
+    body += std::to_string(client.accounts.size());
+    body += '|';
+    for (const Account& account : client.accounts) {
+        appendAccountFields(body, account);
+        const TransactionLog& history = account.getTransactionHistory();
+        body += std::to_string(history.size());
+        body += '|';
+        for (const Transaction& transaction : history) {
+            appendTransactionFields(body, transaction);
+        }
+    }
+}
+
+bool readClientFields(std::istream& fields, ClientData& client) {
+    size_t status = 0, accountCount = 0;
+    if (!Journal::readField(fields, client.accountId) ||
+        !Journal::readField(fields, client.fullName) ||
+        !Journal::readField(fields, client.birthDate) ||
+        !Journal::readField(fields, client.passportData) ||
+        !Journal::readField(fields, client.passwordHash) ||
+        !readCountField(fields, status) ||
+        !readCountField(fields, accountCount) ||
+        client.accountId.empty() || status > static_cast<size_t>(ClientStatus::BLOCKED)) {
+        return false;
+    }
+    client.status = static_cast<ClientStatus>(status);
+    for (size_t i = 0; i < accountCount; i++) {
+        size_t historySize = 0;
+        if (!readAccountFields(fields, client.accounts) || !readCountField(fields, historySize)) {
+            return false;
+        }
+        for (size_t t = 0; t < historySize; t++) {
+            Transaction transaction;
+            if (!readTransactionFields(fields, transaction)) {
+                return false;
+            }
+            client.accounts.back().appendTransaction(transaction);
+        }
+    }
+    return fields.peek() == std::char_traits<char>::eof();
+}
+
+}
+
+size_t Database::loadThreads_ = 0;
+
+void Database::setLoadThreads(size_t threads) {
+    loadThreads_ = threads;
+}
+
+size_t Database::loadThreads() {
+    if (loadThreads_ > 0) return loadThreads_;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+Database::Database(const std::string& filename) 
+    : filename_(filename), accountIds_(filename + ".ids"), journal_(filename + ".journal", encryptionKey_) {
     settings_.creditInterestRate = 12.0;
     settings_.depositInterestRate = 6.5;
-    settings_.largeOperationThreshold = 150000.0;
-    settings_.largeLoanThreshold = 50000.0;
+    settings_.largeOperationThreshold = Money::fromUnits(150000);
+    settings_.largeLoanThreshold = Money::fromUnits(50000);
+    for (auto& dirty : dirtySegments_) {
+        dirty = false;
+    }
     
     // Загружаем данные при создании
     loadFromFile();
 }
 
+Database::~Database() {
+    {
+        std::lock_guard<std::mutex> lock(checkpointMutex_);
+        stopping_ = true;
+    }
+    checkpointCV_.notify_all();
+    // Начатая контрольная точка дописывается; не начатая не нужна - всё есть в журнале
+    if (checkpointer_.joinable()) {
+        checkpointer_.join();
+    }
+}
+
 bool Database::loadFromFile() {
-    std::ifstream file(filename_, std::ios::binary);
-    if (!file) {
+    std::lock_guard<std::mutex> persist(persistMutex_);
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+    return loadFromFileLocked();
+}
+
+bool Database::loadFromFileLocked() {
+    // Снимок и сегменты разбираются по частям на всех ядрах
+    WorkerPool pool(loadThreads());
+    if (pool.size() > 1) {
+        pool.start();
+    }
+    
+    std::unordered_map<std::string, ClientData> newClients;
+    uint64_t baseLsn = 0;
+    bool baseFound = false;
+    MappedFile file;
+    if (file.open(filename_) && file.size() > 0) {
+        baseFound = true;
+        size_t size = 0;
+        bool loaded = DurableFile::verify(file.data(), file.size(), size, isLegacyDatabaseFile, &pool);
+        if (!loaded) {
+            std::cerr << "Error: Database file is damaged (checksum mismatch): " << filename_ << std::endl;
+        } else if (Snapshot::isSnapshot(file.data(), size)) {
+            loaded = Snapshot::load(file.data(), size, encryptionKey_, pool, newClients, baseLsn);
+        } else {
+            // Текстовый формат прежних версий: читается, но сохраняется уже бинарными сегментами
+            loaded = parseText(std::string(file.data(), size), pool, newClients, baseLsn);
+        }
+        file.close();
+        
+        if (!loaded) {
+            pool.stop();
+            clients_.clear();
+            rebuildIndexes();
+            return false;
+        }
+    }
+    
+    // Сегмент на диске заменяет всех клиентов своего сегмента из основного файла
+    // (они там остаются, если переход на сегменты прервался). Недостающий
+    // сегмент будет записан при следующем сохранении
+    std::array<bool, kSegments> present{};
+    std::unordered_map<std::string, ClientData> segmentClients;
+    size_t segmentsFound = 0;
+    for (size_t segment = 0; segment < kSegments; segment++) {
+        segmentLsn_[segment] = baseLsn;
+        if (!file.open(segmentFilename(segment))) {
+            continue;
+        }
+        
+        std::unordered_map<std::string, ClientData> loaded;
+        uint64_t lsn = 0;
+        size_t size = 0;
+        if (!DurableFile::verify(file.data(), file.size(), size, Snapshot::isLegacy, &pool) ||
+            !Snapshot::load(file.data(), size, encryptionKey_, pool, loaded, lsn)) {
+            std::cerr << "Error: Database segment is damaged: " << segmentFilename(segment) << std::endl;
+            pool.stop();
+            clients_.clear();
+            rebuildIndexes();
+            return false;
+        }
+        file.close();
+        
+        // Сегмент старше основного файла остался от базы до восстановления из
+        // копии (сбой между записью копии и удалением сегментов)
+        if (baseFound && lsn < baseLsn) {
+            continue;
+        }
+        
+        segmentLsn_[segment] = lsn;
+        present[segment] = true;
+        segmentsFound++;
+        segmentClients.merge(loaded);
+    }
+    pool.stop();
+    
+    segmented_ = segmentsFound == kSegments;
+    for (size_t segment = 0; segment < kSegments; segment++) {
+        dirtySegments_[segment] = !present[segment];
+    }
+    
+    if (!baseFound && segmentsFound == 0) {
         std::cout << "Database file not found, creating new one." << std::endl;
         clients_.clear();
+        rebuildIndexes();
+        // Клиенты могут жить пока только в журнале, а настройки - в своём файле
+        replayJournal();
+        loadSettings();
         return true;
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string encryptedData = buffer.str();
+    if (segmentsFound > 0) {
+        for (auto it = newClients.begin(); it != newClients.end();) {
+            if (present[segmentOf(it->first)]) {
+                it = newClients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        newClients.merge(segmentClients);
+    }
     
-    if (encryptedData.empty()) {
-        clients_.clear();
-        std::cout << "Database file is empty, starting fresh." << std::endl;
-        return true;
+    clients_ = std::move(newClients);
+    rebuildIndexes();
+    std::cout << "Loaded " << clients_.size() << " clients with " << totalAccountsLocked() << " accounts from database." << std::endl;
+    
+    // Доигрываем операции, совершённые после последней контрольной точки
+    replayJournal();
+    
+    // Загружаем настройки
+    loadSettings();
+    return true;
+}
+
+bool Database::parseText(const std::string& encryptedData, WorkerPool& pool,
+                         std::unordered_map<std::string, ClientData>& clients, uint64_t& lsn) {
+    std::string decryptedData;
+    if (!decryptText(encryptedData, pool, decryptedData)) {
+        // Нестандартный файл (например, с мусором в середине) - расшифровываем как раньше
+        try {
+            decryptedData = Crypto::decrypt(encryptedData, encryptionKey_);
+        } catch (const std::exception& e) {
+            std::cerr << "Error loading database: " << e.what() << std::endl;
+            return false;
+        }
     }
     
-    try {
-        std::string decryptedData = Crypto::decrypt(encryptedData, encryptionKey_);
+    // Режем текст по разделителям клиентов "===" на куски примерно равного размера
+    size_t chunkCount = pool.size() > 1 ? pool.size() * 4 : 1;
+    std::vector<size_t> bounds{0};
+    for (size_t i = 1; i < chunkCount; i++) {
+        size_t target = decryptedData.size() * i / chunkCount;
+        if (target < bounds.back()) continue;
         
-        if (decryptedData.empty()) {
-            clients_.clear();
-            return true;
+        size_t separator = decryptedData.find("\n===\n", target);
+        if (separator == std::string::npos) break;
+        if (separator + 5 > bounds.back()) {
+            bounds.push_back(separator + 5);
         }
-        
-        std::stringstream ss(decryptedData);
-        std::unordered_map<std::string, ClientData> newClients;
+    }
+    bounds.push_back(decryptedData.size());
+    
+    size_t parts = bounds.size() - 1;
+    std::vector<std::unordered_map<std::string, ClientData>> partClients(parts);
+    std::vector<uint64_t> partLsn(parts, 0);
+    std::vector<char> partOk(parts, 0);
+    pool.run(parts, [&](size_t i) {
+        partOk[i] = parseTextChunk(decryptedData, bounds[i], bounds[i + 1], partClients[i], partLsn[i]);
+    });
+    
+    size_t total = 0;
+    for (size_t i = 0; i < parts; i++) {
+        if (!partOk[i]) return false;
+        total += partClients[i].size();
+    }
+    
+    clients.reserve(clients.size() + total);
+    for (size_t i = 0; i < parts; i++) {
+        // merge переносит узлы без копирования данных клиентов
+        clients.merge(partClients[i]);
+        lsn = std::max(lsn, partLsn[i]);
+    }
+    return true;
+}
+
+bool Database::decryptText(const std::string& encryptedData, WorkerPool& pool, std::string& decryptedData) {
+    size_t length = encryptedData.size();
+    while (length > 0 && std::isspace(static_cast<unsigned char>(encryptedData[length - 1]))) {
+        length--;
+    }
+    if (length == 0 || length % 4 != 0) return false;
+    
+    size_t padding = 0;
+    if (encryptedData[length - 1] == '=') padding++;
+    if (encryptedData[length - 2] == '=') padding++;
+    
+    // Последняя четвёрка с '=' расшифровывается отдельно
+    size_t fullLength = padding ? length - 4 : length;
+    size_t quads = fullLength / 4;
+    decryptedData.assign(length / 4 * 3, '\0');
+    
+    size_t chunkCount = std::min(quads, pool.size() * 4);
+    std::vector<char> chunkOk(chunkCount, 0);
+    pool.run(chunkCount, [&](size_t i) {
+        size_t first = quads * i / chunkCount;
+        size_t last = quads * (i + 1) / chunkCount;
+        chunkOk[i] = Crypto::decryptChunk(encryptedData.data() + first * 4, (last - first) * 4,
+                                          first * 3, encryptionKey_, &decryptedData[first * 3]);
+    });
+    for (char ok : chunkOk) {
+        if (!ok) return false;
+    }
+    
+    if (padding) {
+        char tail[4];
+        std::memcpy(tail, encryptedData.data() + fullLength, 4);
+        for (char& c : tail) {
+            if (c == '=') c = 'A';
+        }
+        if (!Crypto::decryptChunk(tail, 4, quads * 3, encryptionKey_, &decryptedData[quads * 3])) {
+            return false;
+        }
+    }
+    
+    decryptedData.resize(length / 4 * 3 - padding);
+    return true;
+}
+
+bool Database::parseTextChunk(const std::string& text, size_t begin, size_t end,
+                              std::unordered_map<std::string, ClientData>& clients, uint64_t& lsn) {
+    try {
+        std::stringstream ss(text.substr(begin, end - begin));
         std::string line;
         
         while (std::getline(ss, line)) {
             if (line.empty() || line == "===") continue;
             
+            if (line.compare(0, kLsnHeader.size(), kLsnHeader) == 0) {
+                lsn = std::stoull(line.substr(kLsnHeader.size()));
+                continue;
+            }
+            
             std::stringstream lineStream(line);
             ClientData client;
             std::string accountCountStr, statusStr;
@@ -89,13 +500,14 @@ bool Database::loadFromFile() {
                     }
                     
                     AccountType type = static_cast<AccountType>(std::stoi(typeStr));
-                    Account account(accountNumber, type, std::stod(balanceStr));
-                    account.setCreditLimit(std::stod(limitStr));
+                    Account account(accountNumber, type, Money::parseLegacy(balanceStr));
+                    account.setCreditLimit(Money::parseLegacy(limitStr));
                     account.setStatus(static_cast<AccountStatus>(std::stoi(statusStr)));
                     
                     // Читаем транзакции
                     try {
                         int txnCount = std::stoi(txnCountStr);
+                        account.reserveHistory(std::max(txnCount, 0));
                         for (int j = 0; j < txnCount; j++) {
                             if (!std::getline(ss, line) || line.empty() || line == "===") break;
                             
@@ -109,14 +521,15 @@ bool Database::loadFromFile() {
                                 std::getline(txnStream, desc, '|') &&
                                 std::getline(txnStream, targetAcc, '|')) {
                                 
-                                // Добавляем транзакцию в счет
-                                account.addTransaction(txnType, std::stod(amountStr), desc, targetAcc);
-                                // Устанавливаем timestamp последней транзакции
-                                auto& transactions = const_cast<std::vector<Transaction>&>(account.getTransactionHistory());
-                                if (!transactions.empty()) {
-                                    transactions.back().timestamp = std::stol(timestampStr);
-                                    transactions.back().id = txnId;
-                                }
+                                // Добавляем транзакцию в счет без изменения баланса
+                                Transaction txn;
+                                txn.id = txnId;
+                                txn.timestamp = std::stol(timestampStr);
+                                txn.type = txnType;
+                                txn.amount = Money::parseLegacy(amountStr);
+                                txn.description = desc;
+                                txn.targetAccount = targetAcc;
+                                account.appendTransaction(txn);
                             }
                         }
                     } catch (const std::exception& e) {
@@ -124,10 +537,11 @@ bool Database::loadFromFile() {
                         // Продолжаем без транзакций
                     }
                     
-                    client.accounts.push_back(account);
+                    client.accounts.push_back(std::move(account));
                 }
                 
-                newClients[client.accountId] = client;
+                std::string id = client.accountId;
+                clients[id] = std::move(client);
                 
             } catch (const std::exception& e) {
                 std::cerr << "Warning: Error parsing client data: " << e.what() << std::endl;
@@ -136,22 +550,17 @@ bool Database::loadFromFile() {
             }
         }
         
-        clients_ = std::move(newClients);
-        std::cout << "Loaded " << clients_.size() << " clients with " << getTotalAccountsCount() << " accounts from database." << std::endl;
-        
-        // Загружаем настройки
-        loadSettings();
         return true;
         
     } catch (const std::exception& e) {
         std::cerr << "Error loading database: " << e.what() << std::endl;
-        clients_.clear();
         return false;
     }
 }
 
-bool Database::saveToFile() {
+std::string Database::formatText() const {
     std::stringstream ss;
+    ss << kLsnHeader << lastLsn_.load() << "|\n";
     
     for (const auto& pair : clients_) {
         const ClientData& client = pair.second;
@@ -181,60 +590,277 @@ bool Database::saveToFile() {
         }
         ss << "===\n"; // Разделитель между клиентами
     }
+    return ss.str();
+}
+
+bool Database::saveToFile() {
+    std::lock_guard<std::mutex> persist(persistMutex_);
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+    return saveToFileLocked();
+}
+
+bool Database::saveToFileLocked() {
+    SegmentBatch batch;
+    collectDirty(batch, false);
+    if (!writeSegments(batch)) {
+        return false;
+    }
     
-    std::string data = ss.str();
-    std::string encryptedData = Crypto::encrypt(data, encryptionKey_);
+    // Сегменты содержат все операции журнала - журнал можно начинать заново
+    journal_.reset();
+    
+    // Сохраняем настройки
+    saveSettings(getSettings());
+    
+    return true;
+}
+
+void Database::collectDirty(SegmentBatch& batch, bool freeze) {
+    batch.lsn = lastLsn_.load();
+    batch.frozen = freeze;
+    for (size_t segment = 0; segment < kSegments; segment++) {
+        batch.selected[segment] = dirtySegments_[segment].exchange(false, std::memory_order_relaxed);
+    }
+    
+    // Клиенты берутся из списков помеченных сегментов: чистые сегменты
+    // под исключительной блокировкой не просматриваются
+    for (size_t segment = 0; segment < kSegments; segment++) {
+        if (!batch.selected[segment]) {
+            continue;
+        }
+        batch.members[segment].assign(segmentMembers_[segment].begin(), segmentMembers_[segment].end());
+        if (freeze) {
+            for (const ClientData* client : segmentMembers_[segment]) {
+                for (const Account& account : client->accounts) {
+                    batch.states[segment].push_back({account.getBalance(), account.getTransactionHistory().size()});
+                }
+            }
+        }
+    }
+}
+
+bool Database::writeSegments(const SegmentBatch& batch) {
+    for (size_t segment = 0; segment < kSegments; segment++) {
+        if (!batch.selected[segment]) {
+            continue;
+        }
+        std::string data;
+        // При ошибке журнал не обнуляется: уже записанные сегменты при
+        // восстановлении пропустят свои записи по LSN, остальные их доиграют
+        if (!Snapshot::serialize(batch.members[segment], batch.lsn, encryptionKey_, data,
+                                 batch.frozen ? &batch.states[segment] : nullptr) ||
+            !writeDatabaseFile(segmentFilename(segment), data)) {
+            for (size_t rest = segment; rest < kSegments; rest++) {
+                if (batch.selected[rest]) {
+                    dirtySegments_[rest] = true;
+                }
+            }
+            return false;
+        }
+        segmentLsn_[segment] = batch.lsn;
+    }
+    
+    // Все сегменты на месте - клиенты из основного файла больше не нужны
+    if (!segmented_) {
+        std::string data;
+        if (!Snapshot::serialize(std::vector<const ClientData*>(), batch.lsn, encryptionKey_, data) ||
+            !writeDatabaseFile(filename_, data)) {
+            return false;
+        }
+        segmented_ = true;
+    }
+    return true;
+}
+
+void Database::checkpointIfDue() {
+    if (journal_.recordCount() < kCheckpointInterval) {
+        return;
+    }
     
-    // Создаем директорию если нужно
-    std::string dir = filename_.substr(0, filename_.find_last_of('/'));
-    if (!dir.empty()) {
-        system(("mkdir -p " + dir).c_str());
+    std::lock_guard<std::mutex> lock(checkpointMutex_);
+    if (stopping_) {
+        return;
+    }
+    if (!checkpointer_.joinable()) {
+        checkpointer_ = std::thread(&Database::checkpointLoop, this);
+    }
+    checkpointRequested_ = true;
+    checkpointCV_.notify_one();
+}
+
+void Database::checkpointLoop() {
+    std::unique_lock<std::mutex> lock(checkpointMutex_);
+    while (true) {
+        while (!checkpointRequested_ && !stopping_) {
+            checkpointCV_.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        if (stopping_) {
+            return;
+        }
+        checkpointRequested_ = false;
+        lock.unlock();
+        checkpointInBackground();
+        lock.lock();
+    }
+}
+
+bool Database::checkpointInBackground() {
+    std::lock_guard<std::mutex> persist(persistMutex_);
+    SegmentBatch batch;
+    {
+        // Исключительная блокировка - только на фиксацию состояния и перенос
+        // журнала в архив; сериализация и запись идут уже без неё
+        std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+        // Пока ждали блокировку, контрольную точку мог выполнить другой поток
+        if (journal_.recordCount() < kCheckpointInterval) {
+            return true;
+        }
+        collectDirty(batch, true);
+        if (!journal_.rotate()) {
+            for (size_t segment = 0; segment < kSegments; segment++) {
+                if (batch.selected[segment]) {
+                    dirtySegments_[segment] = true;
+                }
+            }
+            return false;
+        }
     }
     
-    std::ofstream file(filename_, std::ios::binary);
+    // Обработчики в это время лишь дописывают истории за зафиксированными
+    // длинами; счета и клиенты не пропадут - для этого нужен persistMutex_.
+    // При ошибке архив журнала остаётся и будет доигран при загрузке
+    if (!writeSegments(batch)) {
+        return false;
+    }
+    journal_.dropArchive();
+    saveSettings(getSettings());
+    return true;
+}
+
+std::string Database::segmentFilename(size_t segment) const {
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), ".seg.%02zu", segment);
+    return filename_ + suffix;
+}
+
+void Database::markDirty(const std::string& accountId) {
+    std::atomic<bool>& dirty = dirtySegments_[segmentOf(accountId)];
+    // Повторная запись в уже помеченный флаг лишь гоняла бы строку кэша между ядрами
+    if (!dirty.load(std::memory_order_relaxed)) {
+        dirty.store(true, std::memory_order_relaxed);
+    }
+}
+
+void Database::markAllDirty() {
+    for (auto& dirty : dirtySegments_) {
+        dirty.store(true, std::memory_order_relaxed);
+    }
+}
+
+bool Database::exportToText(const std::string& path) {
+    std::string text;
+    {
+        std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+        text = formatText();
+    }
+    
+    // Выгрузка - для людей и других программ, поэтому без контрольных сумм
+    if (!DurableFile::write(path, Crypto::encrypt(text, encryptionKey_))) {
+        std::cerr << "Error: Could not write export file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Database::importFromText(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
     if (!file) {
-        std::cerr << "Error: Could not open database file for writing: " << filename_ << std::endl;
+        std::cerr << "Error: Could not open import file: " << path << std::endl;
         return false;
     }
     
-    file << encryptedData;
-    file.close();
+    std::stringstream buffer;
+    buffer << file.rdbuf();
     
-    // Сохраняем настройки
-    saveSettings(settings_);
+    WorkerPool pool(loadThreads());
+    if (pool.size() > 1) {
+        pool.start();
+    }
     
-    return true;
+    std::unordered_map<std::string, ClientData> imported;
+    uint64_t lsn = 0;
+    if (!parseText(buffer.str(), pool, imported, lsn)) {
+        return false;
+    }
+    
+    // LSN выгрузки относится к чужому журналу; импорт сразу становится контрольной точкой
+    std::lock_guard<std::mutex> persist(persistMutex_);
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+    clients_ = std::move(imported);
+    rebuildIndexes();
+    markAllDirty();
+    std::cout << "Imported " << clients_.size() << " clients from " << path << std::endl;
+    return saveToFileLocked();
 }
 
 bool Database::addClient(const ClientData& client) {
-    if (clients_.find(client.accountId) != clients_.end()) {
-        std::cout << "Client " << client.accountId << " already exists." << std::endl;
+    if (client.accountId.empty()) {
+        std::cerr << "Error: Client without account ID rejected." << std::endl;
         return false;
     }
     
-    clients_[client.accountId] = client;
-    bool success = saveToFile();
+    // Новый клиент - одна запись журнала, сегмент перепишет контрольная точка.
+    // Вставка в таблицу не сдвигает других клиентов, поэтому persistMutex_
+    // не нужен: регистрация не ждёт записи сегментов
+    uint64_t seq;
+    {
+        std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+        if (clients_.find(client.accountId) != clients_.end()) {
+            std::cout << "Client " << client.accountId << " already exists." << std::endl;
+            return false;
+        }
+        
+        ClientData& added = clients_[client.accountId];
+        added = client;
+        indexClient(added);
+        markDirty(client.accountId);
+        // Запись встаёт в журнал под блокировкой - раньше любой операции с
+        // новым клиентом; fdatasync ждём уже без неё
+        seq = enqueueClient(added);
+    }
     
-    if (success) {
-        std::cout << "Client " << client.accountId << " added successfully." << std::endl;
-    } else {
+    if (seq == 0 || !journal_.wait(seq)) {
         std::cerr << "Failed to save client " << client.accountId << " to database." << std::endl;
-        // Откатываем изменения в памяти при ошибке сохранения
-        clients_.erase(client.accountId);
+        // Откатываем изменения в памяти; сегмент остаётся помеченным, и
+        // контрольная точка перепишет его без этого клиента
+        std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+        auto it = clients_.find(client.accountId);
+        if (it != clients_.end()) {
+            unindexClient(it->second);
+            clients_.erase(it);
+            markDirty(client.accountId);
+        }
+        return false;
     }
     
-    return success;
+    std::cout << "Client " << client.accountId << " added successfully." << std::endl;
+    checkpointIfDue();
+    return true;
 }
 
 bool Database::removeClient(const std::string& accountId) {
+    std::lock_guard<std::mutex> persist(persistMutex_);
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
     auto it = clients_.find(accountId);
     if (it == clients_.end()) {
         std::cout << "Client " << accountId << " not found." << std::endl;
         return false;
     }
     
+    markDirty(accountId);
+    unindexClient(it->second);
     clients_.erase(it);
-    bool success = saveToFile();
+    bool success = saveToFileLocked();
     
     if (success) {
         std::cout << "Client " << accountId << " removed successfully." << std::endl;
@@ -246,19 +872,22 @@ bool Database::removeClient(const std::string& accountId) {
 }
 
 ClientData* Database::findClient(const std::string& accountId) {
+    std::shared_lock<std::shared_mutex> lock(clientsMutex_);
     auto it = clients_.find(accountId);
     return it != clients_.end() ? &it->second : nullptr;
 }
 
 ClientData* Database::authenticateClient(const std::string& accountId, const std::string& password) {
-    ClientData* client = findClient(accountId);
-    if (client && Crypto::verifyPassword(password, client->passwordHash)) {
-        return client;
+    ClientLock lock = lockClient(accountId);
+    auto it = clients_.find(accountId);
+    if (it != clients_.end() && Crypto::verifyPassword(password, it->second.passwordHash)) {
+        return &it->second;
     }
     return nullptr;
 }
 
 std::vector<std::string> Database::getAllAccountIds() {
+    std::shared_lock<std::shared_mutex> lock(clientsMutex_);
     std::vector<std::string> ids;
     for (const auto& pair : clients_) {
         ids.push_back(pair.first);
@@ -267,35 +896,51 @@ std::vector<std::string> Database::getAllAccountIds() {
 }
 
 bool Database::isPassportExists(const std::string& passportData) {
-    for (const auto& pair : clients_) {
-        if (pair.second.passportData == passportData) {
-            return true;
-        }
-    }
-    return false;
+    std::shared_lock<std::shared_mutex> lock(clientsMutex_);
+    return passports_.count(passportData) > 0;
 }
 
 bool Database::verifyClient(const std::string& accountId) {
-    ClientData* client = findClient(accountId);
-    if (client) {
-        client->status = ClientStatus::VERIFIED;
-        return saveToFile();
+    uint64_t seq;
+    ClientStatus previous;
+    {
+        // Статус читает и контрольная точка, пишущая сегменты без clientsMutex_
+        std::lock_guard<std::mutex> persist(persistMutex_);
+        std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+        auto it = clients_.find(accountId);
+        if (it == clients_.end()) {
+            return false;
+        }
+        
+        previous = it->second.status;
+        it->second.status = ClientStatus::VERIFIED;
+        markDirty(accountId);
+        seq = enqueueStatus(accountId, ClientStatus::VERIFIED);
     }
-    return false;
+    
+    if (seq == 0 || !journal_.wait(seq)) {
+        std::lock_guard<std::mutex> persist(persistMutex_);
+        std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+        auto it = clients_.find(accountId);
+        if (it != clients_.end()) {
+            it->second.status = previous;
+        }
+        return false;
+    }
+    checkpointIfDue();
+    return true;
 }
 
 bool Database::loadSettings() {
-    std::string settingsFile = settingsFilename();
-    std::ifstream file(settingsFile, std::ios::binary);
-    if (!file) {
-        std::cout << "Settings file not found, using default settings." << std::endl;
+    std::string encryptedData;
+    bool found = false;
+    if (!DurableFile::read(settingsFilename(), encryptedData, isLegacySettings, &found)) {
+        if (!found) {
+            std::cout << "Settings file not found, using default settings." << std::endl;
+        }
         return false;
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string encryptedData = buffer.str();
-    
     if (encryptedData.empty()) {
         return false;
     }
@@ -314,10 +959,11 @@ bool Database::loadSettings() {
                 std::getline(settingsStream, operationThreshold, '|') &&
                 std::getline(settingsStream, loanThreshold, '|')) {
                 
+                std::lock_guard<std::mutex> lock(settingsMutex_);
                 settings_.creditInterestRate = std::stod(creditRate);
                 settings_.depositInterestRate = std::stod(depositRate);
-                settings_.largeOperationThreshold = std::stod(operationThreshold);
-                settings_.largeLoanThreshold = std::stod(loanThreshold);
+                settings_.largeOperationThreshold = Money::parseLegacy(operationThreshold);
+                settings_.largeLoanThreshold = Money::parseLegacy(loanThreshold);
                 
                 std::cout << "Settings loaded successfully." << std::endl;
                 return true;
@@ -330,7 +976,13 @@ bool Database::loadSettings() {
     }
 }
 
+BankSettings Database::getSettings() const {
+    std::lock_guard<std::mutex> lock(settingsMutex_);
+    return settings_;
+}
+
 bool Database::saveSettings(const BankSettings& settings) {
+    std::lock_guard<std::mutex> lock(settingsMutex_);
     settings_ = settings;
     
     std::stringstream ss;
@@ -340,79 +992,671 @@ bool Database::saveSettings(const BankSettings& settings) {
        << settings.largeLoanThreshold << "|\n";
     
     std::string data = ss.str();
-    std::string encryptedData = Crypto::encrypt(data, encryptionKey_);
-    
-    // Создаем директорию если нужно
-    std::string dir = filename_.substr(0, filename_.find_last_of('/'));
-    if (!dir.empty()) {
-        system(("mkdir -p " + dir).c_str());
-    }
-    
-    std::ofstream file(settingsFilename(), std::ios::binary);
-    if (!file) {
-        std::cerr << "Error: Could not open settings file for writing." << std::endl;
+    if (!writeDatabaseFile(settingsFilename(), Crypto::encrypt(data, encryptionKey_))) {
+        std::cerr << "Error: Could not save settings file." << std::endl;
         return false;
     }
-    
-    file << encryptedData;
-    file.close();
-    
     return true;
 }
 
 // Дополнительные методы
 
 bool Database::updateClient(const ClientData& client) {
+    std::lock_guard<std::mutex> persist(persistMutex_);
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
     auto it = clients_.find(client.accountId);
     if (it == clients_.end()) {
         return false;
     }
     
+    unindexClient(it->second);
     it->second = client;
-    return saveToFile();
+    indexClient(it->second);
+    markDirty(client.accountId);
+    return saveToFileLocked();
 }
 
 bool Database::updateClientAccounts(const std::string& accountId, const std::vector<Account>& accounts) {
-    ClientData* client = findClient(accountId);
-    if (!client) {
+    std::lock_guard<std::mutex> persist(persistMutex_);
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+    auto it = clients_.find(accountId);
+    if (it == clients_.end()) {
         return false;
     }
     
-    client->accounts = accounts;
-    return saveToFile();
+    unindexClient(it->second);
+    it->second.accounts = accounts;
+    indexClient(it->second);
+    markDirty(accountId);
+    return saveToFileLocked();
 }
 
 bool Database::addAccountToClient(const std::string& accountId, const Account& account) {
-    ClientData* client = findClient(accountId);
-    if (!client) {
+    bool journaled;
+    {
+        // Вектор счетов может переехать - никто не должен держать ссылки на счета,
+        // в том числе фоновая контрольная точка, пишущая сегменты
+        std::lock_guard<std::mutex> persist(persistMutex_);
+        std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+        auto it = clients_.find(accountId);
+        if (it == clients_.end()) {
+            return false;
+        }
+        
+        // Номер счёта должен быть уникален во всей базе
+        if (accountIndex_.count(account.getNumber())) {
+            return false;
+        }
+        
+        ClientData* client = &it->second;
+        client->accounts.push_back(account);
+        accountIndex_[account.getNumber()] = {client, client->accounts.size() - 1};
+        markDirty(accountId);
+        journaled = journalAccount(accountId, account);
+    }
+    checkpointIfDue();
+    return journaled;
+}
+
+bool Database::findAccount(const std::string& accountNumber, ClientData** owner, Account** account) {
+    std::shared_lock<std::shared_mutex> lock(clientsMutex_);
+    const AccountLocation* location = locateAccount(accountNumber);
+    if (!location) {
         return false;
     }
     
-    // Проверяем, нет ли уже счета с таким номером
-    for (const auto& acc : client->accounts) {
-        if (acc.getNumber() == account.getNumber()) {
+    if (owner) *owner = location->owner;
+    if (account) *account = &location->owner->accounts[location->slot];
+    return true;
+}
+
+const AccountLocation* Database::locateAccount(const std::string& accountNumber) const {
+    auto it = accountIndex_.find(accountNumber);
+    return it != accountIndex_.end() ? &it->second : nullptr;
+}
+
+bool Database::getAccountNumber(const std::string& accountId, size_t index, std::string& accountNumber) {
+    ClientLock lock = lockClient(accountId);
+    auto it = clients_.find(accountId);
+    if (it == clients_.end() || index >= it->second.accounts.size()) {
+        return false;
+    }
+    accountNumber = it->second.accounts[index].getNumber();
+    return true;
+}
+
+bool Database::getAccountOpenedAt(const std::string& accountId, size_t index, std::time_t now, std::time_t& openedAt) {
+    ClientLock lock = lockClient(accountId);
+    auto it = clients_.find(accountId);
+    if (it == clients_.end() || index >= it->second.accounts.size()) {
+        return false;
+    }
+    const TransactionLog& history = it->second.accounts[index].getTransactionHistory();
+    openedAt = history.empty() ? now : history[0].timestamp;
+    return true;
+}
+
+size_t Database::stripeOf(const std::string& accountId) const {
+    return std::hash<std::string>{}(accountId) % kLockStripes;
+}
+
+void Database::lockStripes(const std::string& firstId, const std::string& secondId,
+                           std::unique_lock<std::mutex>& first, std::unique_lock<std::mutex>& second) const {
+    size_t a = stripeOf(firstId);
+    size_t b = stripeOf(secondId);
+    
+    // Единый порядок захвата исключает взаимную блокировку встречных переводов
+    if (a > b) std::swap(a, b);
+    first = std::unique_lock<std::mutex>(stripes_[a]);
+    if (b != a) {
+        second = std::unique_lock<std::mutex>(stripes_[b]);
+    }
+}
+
+Database::ClientLock Database::lockClient(const std::string& accountId) const {
+    return lockClients(accountId, accountId);
+}
+
+Database::ClientLock Database::lockClients(const std::string& firstId, const std::string& secondId) const {
+    ClientLock lock;
+    lock.clients_ = std::shared_lock<std::shared_mutex>(clientsMutex_);
+    lockStripes(firstId, secondId, lock.first_, lock.second_);
+    return lock;
+}
+
+void Database::indexClient(ClientData& client) {
+    segmentMembers_[segmentOf(client.accountId)].push_back(&client);
+    passports_.insert(client.passportData);
+    accountIds_.observe(client.accountId);
+    for (size_t slot = 0; slot < client.accounts.size(); slot++) {
+        accountIndex_.emplace(client.accounts[slot].getNumber(), AccountLocation{&client, slot});
+    }
+}
+
+void Database::unindexClient(const ClientData& client) {
+    // Удаление клиента редкое: линейный поиск только по его сегменту
+    std::vector<const ClientData*>& members = segmentMembers_[segmentOf(client.accountId)];
+    auto member = std::find(members.begin(), members.end(), &client);
+    if (member != members.end()) {
+        *member = members.back();
+        members.pop_back();
+    }
+    
+    auto passport = passports_.find(client.passportData);
+    if (passport != passports_.end()) {
+        passports_.erase(passport);
+    }
+    
+    for (const auto& account : client.accounts) {
+        auto it = accountIndex_.find(account.getNumber());
+        if (it != accountIndex_.end() && it->second.owner == &client) {
+            accountIndex_.erase(it);
+        }
+    }
+}
+
+void Database::rebuildIndexes() {
+    accountIndex_.clear();
+    accountIndex_.reserve(totalAccountsLocked());
+    passports_.clear();
+    passports_.reserve(clients_.size());
+    for (auto& members : segmentMembers_) {
+        members.clear();
+    }
+    for (auto& pair : clients_) {
+        indexClient(pair.second);
+    }
+}
+
+bool Database::deposit(const std::string& accountNumber, Money amount, const std::string& description) {
+    bool journaled;
+    {
+        // Разделяемая блокировка держит на месте лишь вектор счетов; сам баланс
+        // меняется атомарно, и операции по одному счёту друг друга не ждут
+        std::shared_lock<std::shared_mutex> lock(clientsMutex_);
+        const AccountLocation* location = locateAccount(accountNumber);
+        if (!location) {
             return false;
         }
+        
+        Account& account = location->owner->accounts[location->slot];
+        if (amount <= Money() || !account.adjustBalance(amount, false)) {
+            return false;
+        }
+        // Журнал - раньше истории: если запись не удалась, сумма возвращается
+        // и false значит, что операции не было
+        Transaction record = account.prepareTransaction("DEPOSIT", amount, description);
+        journaled = journalTransaction(accountNumber, record);
+        if (!journaled) {
+            account.adjustBalance(-amount, false);
+            return false;
+        }
+        account.appendTransaction(record);
+        markDirty(location->owner->accountId);
+    }
+    checkpointIfDue();
+    return journaled;
+}
+
+bool Database::withdraw(const std::string& accountNumber, Money amount, const std::string& description) {
+    bool journaled;
+    {
+        std::shared_lock<std::shared_mutex> lock(clientsMutex_);
+        const AccountLocation* location = locateAccount(accountNumber);
+        if (!location) {
+            return false;
+        }
+        
+        // Проверка лимита и списание - одна атомарная операция
+        Account& account = location->owner->accounts[location->slot];
+        if (amount <= Money() || !account.adjustBalance(-amount, true)) {
+            return false;
+        }
+        Transaction record = account.prepareTransaction("WITHDRAW", -amount, description);
+        journaled = journalTransaction(accountNumber, record);
+        if (!journaled) {
+            account.adjustBalance(amount, false);
+            return false;
+        }
+        account.appendTransaction(record);
+        markDirty(location->owner->accountId);
+    }
+    checkpointIfDue();
+    return journaled;
+}
+
+bool Database::transfer(const std::string& fromNumber, const std::string& toNumber, Money amount,
+                        const std::string& description) {
+    if (amount <= Money()) {
+        return false;
     }
     
-    client->accounts.push_back(account);
-    return saveToFile();
+    bool journaled;
+    {
+        std::shared_lock<std::shared_mutex> lock(clientsMutex_);
+        const AccountLocation* fromLocation = locateAccount(fromNumber);
+        const AccountLocation* toLocation = locateAccount(toNumber);
+        if (!fromLocation || !toLocation) {
+            return false;
+        }
+        
+        // Полосы обоих владельцев берутся по возрастанию номера - встречные
+        // переводы и переводы по пересекающимся наборам счетов не блокируют друг друга
+        std::unique_lock<std::mutex> first, second;
+        lockStripes(fromLocation->owner->accountId, toLocation->owner->accountId, first, second);
+        
+        // Сначала обе суммы по балансам: списание атомарно проверяет лимит,
+        // зачисление может отказать только при переполнении - тогда списание возвращается
+        Account& from = fromLocation->owner->accounts[fromLocation->slot];
+        Account& to = toLocation->owner->accounts[toLocation->slot];
+        if (!from.adjustBalance(-amount, true)) {
+            return false;
+        }
+        if (!to.adjustBalance(amount, false)) {
+            from.adjustBalance(amount, false);
+            return false;
+        }
+        
+        // История пишется, только когда перевод уже состоялся целиком и лежит
+        // в журнале; если запись не удалась, обе суммы возвращаются
+        Transaction debit = from.prepareTransaction("WITHDRAW", -amount,
+                                                    description.empty() ? "Transfer to " + toNumber : description,
+                                                    toNumber);
+        Transaction credit = to.prepareTransaction("DEPOSIT", amount, "Transfer from " + fromNumber, fromNumber);
+        journaled = journalTransfer(fromNumber, toNumber, debit, credit);
+        if (!journaled) {
+            to.adjustBalance(-amount, false);
+            from.adjustBalance(amount, false);
+            return false;
+        }
+        from.appendTransaction(debit);
+        to.appendTransaction(credit);
+        markDirty(fromLocation->owner->accountId);
+        markDirty(toLocation->owner->accountId);
+    }
+    checkpointIfDue();
+    return journaled;
 }
 
-bool Database::findAccount(const std::string& accountNumber, ClientData** owner, Account** account) {
-    for (auto& pair : clients_) {
-        for (auto& acc : pair.second.accounts) {
-            if (acc.getNumber() == accountNumber) {
-                if (owner) *owner = &pair.second;
-                if (account) *account = &acc;
-                return true;
+bool Database::transferBatch(const std::string& fromNumber, const std::vector<TransferItem>& items,
+                             bool atomic, std::vector<bool>* applied) {
+    std::vector<bool> done(items.size(), false);
+    bool journaled = false;
+    {
+        std::shared_lock<std::shared_mutex> lock(clientsMutex_);
+        const AccountLocation* fromLocation = locateAccount(fromNumber);
+        if (!fromLocation) {
+            if (applied) *applied = done;
+            return false;
+        }
+        
+        // Проверка всех строк за один проход: получатели ищутся по индексу один раз
+        std::vector<const AccountLocation*> targets(items.size(), nullptr);
+        std::vector<size_t> stripes{stripeOf(fromLocation->owner->accountId)};
+        Money total;
+        bool valid = true;
+        for (size_t i = 0; i < items.size(); i++) {
+            const AccountLocation* target = locateAccount(items[i].toNumber);
+            if (!target || target == fromLocation || items[i].amount <= Money() ||
+                (atomic && !Money::add(total, items[i].amount, total))) {
+                valid = false;
+                continue;
+            }
+            targets[i] = target;
+            stripes.push_back(stripeOf(target->owner->accountId));
+        }
+        if (atomic && (!valid || items.empty())) {
+            if (applied) *applied = done;
+            return false;
+        }
+        
+        // Полосы всех участников - по возрастанию номера, каждая один раз,
+        // как у одиночного перевода
+        std::sort(stripes.begin(), stripes.end());
+        stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+        std::vector<std::unique_lock<std::mutex>> stripeLocks;
+        stripeLocks.reserve(stripes.size());
+        for (size_t stripe : stripes) {
+            stripeLocks.emplace_back(stripes_[stripe]);
+        }
+        
+        Account& from = fromLocation->owner->accounts[fromLocation->slot];
+        if (atomic) {
+            // Вся сумма списывается одной проверкой лимита; если какое-то
+            // зачисление переполнится, пакет откатывается целиком
+            if (!from.adjustBalance(-total, true)) {
+                if (applied) *applied = done;
+                return false;
+            }
+            size_t credited = 0;
+            while (credited < items.size() &&
+                   targets[credited]->owner->accounts[targets[credited]->slot].adjustBalance(items[credited].amount, false)) {
+                credited++;
+            }
+            if (credited < items.size()) {
+                for (size_t i = 0; i < credited; i++) {
+                    targets[i]->owner->accounts[targets[i]->slot].adjustBalance(-items[i].amount, false);
+                }
+                from.adjustBalance(total, false);
+                if (applied) *applied = done;
+                return false;
+            }
+            done.assign(items.size(), true);
+        } else {
+            for (size_t i = 0; i < items.size(); i++) {
+                if (!targets[i] || !from.adjustBalance(-items[i].amount, true)) {
+                    continue;
+                }
+                if (!targets[i]->owner->accounts[targets[i]->slot].adjustBalance(items[i].amount, false)) {
+                    from.adjustBalance(items[i].amount, false);
+                    continue;
+                }
+                done[i] = true;
+            }
+        }
+        
+        // Журнал и история - только по проведённым строкам
+        std::vector<std::string> toNumbers;
+        std::vector<Transaction> debits, credits;
+        for (size_t i = 0; i < items.size(); i++) {
+            if (!done[i]) {
+                continue;
+            }
+            const TransferItem& item = items[i];
+            Account& to = targets[i]->owner->accounts[targets[i]->slot];
+            toNumbers.push_back(item.toNumber);
+            debits.push_back(from.prepareTransaction("WITHDRAW", -item.amount,
+                                                     item.description.empty() ? "Transfer to " + item.toNumber : item.description,
+                                                     item.toNumber));
+            credits.push_back(to.prepareTransaction("DEPOSIT", item.amount, "Transfer from " + fromNumber, fromNumber));
+        }
+        journaled = toNumbers.empty() || journalBatch(fromNumber, toNumbers, debits, credits);
+        
+        // Запись не удалась - проведённые строки возвращаются, пакета как не было
+        size_t row = 0;
+        for (size_t i = 0; i < items.size(); i++) {
+            if (!done[i]) {
+                continue;
+            }
+            Account& to = targets[i]->owner->accounts[targets[i]->slot];
+            if (!journaled) {
+                to.adjustBalance(-items[i].amount, false);
+                from.adjustBalance(items[i].amount, false);
+                done[i] = false;
+                continue;
+            }
+            from.appendTransaction(debits[row]);
+            to.appendTransaction(credits[row]);
+            markDirty(targets[i]->owner->accountId);
+            row++;
+        }
+        if (journaled && !toNumbers.empty()) {
+            markDirty(fromLocation->owner->accountId);
+        }
+    }
+    checkpointIfDue();
+    
+    if (applied) *applied = done;
+    return journaled && std::find(done.begin(), done.end(), false) == done.end();
+}
+
+bool Database::deposit(Account& account, Money amount, const std::string& description) {
+    return deposit(account.getNumber(), amount, description);
+}
+
+bool Database::withdraw(Account& account, Money amount, const std::string& description) {
+    return withdraw(account.getNumber(), amount, description);
+}
+
+bool Database::transfer(Account& from, Account& to, Money amount, const std::string& description) {
+    return transfer(from.getNumber(), to.getNumber(), amount, description);
+}
+
+bool Database::appendJournal(const std::string& type, const std::string& body) {
+    // Периодическую контрольную точку выполняет checkpointIfDue, когда блокировки отпущены
+    uint64_t seq = enqueueJournal(type, body);
+    return seq != 0 && journal_.wait(seq);
+}
+
+uint64_t Database::enqueueJournal(const std::string& type, const std::string& body) {
+    uint64_t lsn = ++lastLsn_;
+    
+    std::stringstream record;
+    record << type << "|" << lsn << "|" << body;
+    return journal_.enqueue(record.str());
+}
+
+bool Database::journalTransaction(const std::string& accountNumber, const Transaction& transaction) {
+    // Запись собирается без iostream: суммы форматирует Money
+    std::string body;
+    body.reserve(128);
+    Journal::appendField(body, accountNumber);
+    appendTransactionFields(body, transaction);
+    return appendJournal("TXN", body);
+}
+
+bool Database::journalTransfer(const std::string& fromNumber, const std::string& toNumber,
+                               const Transaction& debit, const Transaction& credit) {
+    std::string body;
+    body.reserve(192);
+    Journal::appendField(body, fromNumber);
+    appendTransferFields(body, toNumber, debit, credit);
+    return appendJournal("XFER", body);
+}
+
+bool Database::journalBatch(const std::string& fromNumber, const std::vector<std::string>& toNumbers,
+                            const std::vector<Transaction>& debits, const std::vector<Transaction>& credits) {
+    // Счёт списания и число строк, затем строки в формате XFER без счёта списания
+    std::string body;
+    body.reserve(32 + toNumbers.size() * 160);
+    Journal::appendField(body, fromNumber);
+    body += std::to_string(toNumbers.size());
+    body += '|';
+    for (size_t i = 0; i < toNumbers.size(); i++) {
+        appendTransferFields(body, toNumbers[i], debits[i], credits[i]);
+    }
+    return appendJournal("BATCH", body);
+}
+
+bool Database::journalAccount(const std::string& accountId, const Account& account) {
+    std::string body;
+    Journal::appendField(body, accountId);
+    appendAccountFields(body, account);
+    return appendJournal("ACCOUNT", body);
+}
+
+uint64_t Database::enqueueClient(const ClientData& client) {
+    std::string body;
+    appendClientFields(body, client);
+    return enqueueJournal("CLIENT", body);
+}
+
+uint64_t Database::enqueueStatus(const std::string& accountId, ClientStatus status) {
+    std::string body;
+    Journal::appendField(body, accountId);
+    body += std::to_string(static_cast<int>(status));
+    body += '|';
+    return enqueueJournal("STATUS", body);
+}
+
+void Database::replayJournal() {
+    lastLsn_ = *std::max_element(segmentLsn_.begin(), segmentLsn_.end());
+    // Записи не новее самого старого сегмента учтены во всех сегментах
+    uint64_t snapshotLsn = *std::min_element(segmentLsn_.begin(), segmentLsn_.end());
+    // Сбой при переносе журнала в архив может оставить запись в обоих файлах
+    std::unordered_set<uint64_t> replayed;
+    journal_.replay([this, snapshotLsn, &replayed](const std::string& record) {
+        applyJournalRecord(record, snapshotLsn, replayed);
+    });
+}
+
+void Database::applyJournalRecord(const std::string& record, uint64_t snapshotLsn,
+                                  std::unordered_set<uint64_t>& replayed) {
+    std::stringstream ss(record);
+    std::string type, lsnStr;
+    if (!std::getline(ss, type, '|') || !std::getline(ss, lsnStr, '|')) {
+        return;
+    }
+    
+    uint64_t lsn = std::stoull(lsnStr);
+    if (lsn > lastLsn_) {
+        lastLsn_ = lsn;
+    }
+    // Запись уже учтена во всех сегментах или уже доиграна из архива
+    if (lsn <= snapshotLsn || !replayed.insert(lsn).second) {
+        return;
+    }
+    
+    if (type == "TXN") {
+        std::string accountNumber;
+        Transaction txn;
+        if (!Journal::readField(ss, accountNumber) || !readTransactionFields(ss, txn)) {
+            return;
+        }
+        
+        const AccountLocation* location = locateAccount(accountNumber);
+        if (location && replayFor(*location->owner, lsn)) {
+            location->owner->accounts[location->slot].applyTransaction(txn);
+        }
+    } else if (type == "XFER") {
+        std::string fromNumber;
+        JournalTransfer transfer;
+        if (Journal::readField(ss, fromNumber) && parseTransferFields(ss, fromNumber, transfer)) {
+            applyTransfer(fromNumber, transfer, lsn);
+        }
+    } else if (type == "BATCH") {
+        std::string fromNumber, countStr;
+        if (!Journal::readField(ss, fromNumber) || !Journal::readField(ss, countStr) ||
+            countStr.empty() || countStr.find_first_not_of("0123456789") != std::string::npos) {
+            return;
+        }
+        // Пакет атомарен и при восстановлении: строки сначала разбираются все,
+        // и если хоть одна обрезана или неверна, не применяется ни одна
+        size_t count = std::stoull(countStr);
+        std::vector<JournalTransfer> rows;
+        for (size_t i = 0; i < count; i++) {
+            JournalTransfer transfer;
+            if (!parseTransferFields(ss, fromNumber, transfer)) {
+                std::cerr << "Warning: Skipping incomplete batch journal record " << lsn << std::endl;
+                return;
+            }
+            rows.push_back(std::move(transfer));
+        }
+        if (rows.empty() || ss.peek() != std::char_traits<char>::eof()) {
+            std::cerr << "Warning: Skipping malformed batch journal record " << lsn << std::endl;
+            return;
+        }
+        for (const JournalTransfer& transfer : rows) {
+            applyTransfer(fromNumber, transfer, lsn);
+        }
+    } else if (type == "ACCOUNT") {
+        std::string accountId;
+        std::vector<Account> parsed;
+        if (!Journal::readField(ss, accountId) || !readAccountFields(ss, parsed)) {
+            return;
+        }
+        
+        const std::string accountNumber = parsed[0].getNumber();
+        auto it = clients_.find(accountId);
+        if (it == clients_.end() || locateAccount(accountNumber) || !replayFor(it->second, lsn)) {
+            return;
+        }
+        ClientData* client = &it->second;
+        client->accounts.push_back(std::move(parsed[0]));
+        accountIndex_[accountNumber] = {client, client->accounts.size() - 1};
+    } else if (type == "CLIENT") {
+        ClientData client;
+        if (!readClientFields(ss, client)) {
+            std::cerr << "Warning: Skipping malformed client journal record " << lsn << std::endl;
+            return;
+        }
+        // Клиент уже есть в сегменте или его номер счёта занят - запись учтена
+        if (clients_.count(client.accountId)) {
+            return;
+        }
+        for (const Account& account : client.accounts) {
+            if (locateAccount(account.getNumber())) {
+                return;
             }
         }
+        if (!replayFor(client, lsn)) {
+            return;
+        }
+        ClientData& added = clients_[client.accountId];
+        added = std::move(client);
+        indexClient(added);
+    } else if (type == "STATUS") {
+        std::string accountId;
+        size_t status = 0;
+        if (!Journal::readField(ss, accountId) || !readCountField(ss, status) ||
+            status > static_cast<size_t>(ClientStatus::BLOCKED)) {
+            return;
+        }
+        auto it = clients_.find(accountId);
+        if (it != clients_.end() && replayFor(it->second, lsn)) {
+            it->second.status = static_cast<ClientStatus>(status);
+        }
+    }
+}
+
+bool Database::replayFor(const ClientData& owner, uint64_t lsn) {
+    size_t segment = segmentOf(owner.accountId);
+    if (lsn <= segmentLsn_[segment]) {
+        return false;
+    }
+    // Сегмент на диске теперь отстаёт от памяти, а журнал обнулится на контрольной точке
+    dirtySegments_[segment] = true;
+    return true;
+}
+
+bool Database::parseTransferFields(std::istream& fields, const std::string& fromNumber, JournalTransfer& transfer) {
+    std::string amountStr, timestampStr;
+    Transaction& debit = transfer.debit;
+    Transaction& credit = transfer.credit;
+    if (fromNumber.empty() ||
+        !Journal::readField(fields, transfer.toNumber) ||
+        !Journal::readField(fields, amountStr) ||
+        !Journal::readField(fields, timestampStr) ||
+        !Journal::readField(fields, debit.id) ||
+        !Journal::readField(fields, credit.id) ||
+        !Journal::readField(fields, debit.description) ||
+        !Journal::readField(fields, credit.description) ||
+        transfer.toNumber.empty()) {
+        return false;
+    }
+    
+    Money amount;
+    if (!Money::parse(amountStr, amount) || amount <= Money()) {
+        return false;
+    }
+    try {
+        debit.timestamp = credit.timestamp = std::stol(timestampStr);
+    } catch (const std::exception& e) {
+        return false;
+    }
+    debit.type = "WITHDRAW";
+    debit.amount = -amount;
+    debit.targetAccount = transfer.toNumber;
+    credit.type = "DEPOSIT";
+    credit.amount = amount;
+    credit.targetAccount = fromNumber;
+    return true;
+}
+
+void Database::applyTransfer(const std::string& fromNumber, const JournalTransfer& transfer, uint64_t lsn) {
+    const AccountLocation* from = locateAccount(fromNumber);
+    const AccountLocation* to = locateAccount(transfer.toNumber);
+    // Стороны перевода могут лежать в сегментах, сохранённых в разное время
+    if (from && replayFor(*from->owner, lsn)) {
+        from->owner->accounts[from->slot].applyTransaction(transfer.debit);
+    }
+    if (to && replayFor(*to->owner, lsn)) {
+        to->owner->accounts[to->slot].applyTransaction(transfer.credit);
     }
-    return false;
 }
 
 std::vector<ClientData*> Database::getAllClients() {
+    std::shared_lock<std::shared_mutex> lock(clientsMutex_);
     std::vector<ClientData*> result;
     for (auto& pair : clients_) {
         result.push_back(&pair.second);
@@ -421,6 +1665,7 @@ std::vector<ClientData*> Database::getAllClients() {
 }
 
 std::vector<ClientData*> Database::getClientsByStatus(ClientStatus status) {
+    std::shared_lock<std::shared_mutex> lock(clientsMutex_);
     std::vector<ClientData*> result;
     for (auto& pair : clients_) {
         if (pair.second.status == status) {
@@ -431,10 +1676,16 @@ std::vector<ClientData*> Database::getClientsByStatus(ClientStatus status) {
 }
 
 size_t Database::getClientCount() const {
+    std::shared_lock<std::shared_mutex> lock(clientsMutex_);
     return clients_.size();
 }
 
 size_t Database::getTotalAccountsCount() const {
+    std::shared_lock<std::shared_mutex> lock(clientsMutex_);
+    return totalAccountsLocked();
+}
+
+size_t Database::totalAccountsLocked() const {
     size_t count = 0;
     for (const auto& pair : clients_) {
         count += pair.second.accounts.size();
@@ -442,8 +1693,10 @@ size_t Database::getTotalAccountsCount() const {
     return count;
 }
 
-double Database::getTotalBalance() const {
-    double total = 0;
+Money Database::getTotalBalance() const {
+    // Исключительная блокировка: балансы не меняются, пока идёт подсчёт
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+    Money total;
     for (const auto& pair : clients_) {
         for (const auto& account : pair.second.accounts) {
             total += account.getBalance();
@@ -453,41 +1706,34 @@ double Database::getTotalBalance() const {
 }
 
 void Database::clearDatabase() {
+    std::lock_guard<std::mutex> persist(persistMutex_);
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
     clients_.clear();
-    saveToFile();
+    rebuildIndexes();
+    markAllDirty();
+    saveToFileLocked();
     std::cout << "Database cleared." << std::endl;
 }
 
 bool Database::backupDatabase(const std::string& backupPath) {
-    // Создаем резервную копию основного файла
-    std::ifstream src(filename_, std::ios::binary);
-    if (!src) {
-        std::cerr << "Cannot open source database for backup." << std::endl;
+    // Переносим журнал в сегменты, чтобы копия была полной
+    std::lock_guard<std::mutex> persist(persistMutex_);
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+    if (!saveToFileLocked()) {
         return false;
     }
     
-    // Создаем директорию для бэкапа если нужно
-    std::string dir = backupPath.substr(0, backupPath.find_last_of('/'));
-    if (!dir.empty()) {
-        system(("mkdir -p " + dir).c_str());
-    }
-    
-    std::ofstream dst(backupPath, std::ios::binary);
-    if (!dst) {
+    // Резервная копия - единый снимок всех сегментов: восстанавливается одним файлом
+    std::string data;
+    if (!Snapshot::serialize(clients_, lastLsn_.load(), encryptionKey_, data) ||
+        !writeDatabaseFile(backupPath, data)) {
         std::cerr << "Cannot create backup file." << std::endl;
         return false;
     }
     
-    dst << src.rdbuf();
-    
     // Создаем резервную копию настроек
-    std::string settingsBackupPath = backupPath + ".settings";
-    std::ifstream srcSettings(settingsFilename(), std::ios::binary);
-    if (srcSettings) {
-        std::ofstream dstSettings(settingsBackupPath, std::ios::binary);
-        if (dstSettings) {
-            dstSettings << srcSettings.rdbuf();
-        }
+    if (std::filesystem::exists(settingsFilename())) {
+        copySettingsFile(settingsFilename(), backupPath + ".settings");
     }
     
     std::cout << "Database backup created: " << backupPath << std::endl;
@@ -495,39 +1741,55 @@ bool Database::backupDatabase(const std::string& backupPath) {
 }
 
 bool Database::restoreFromBackup(const std::string& backupPath) {
-    // Восстанавливаем из резервной копии
-    std::ifstream src(backupPath, std::ios::binary);
-    if (!src) {
-        std::cerr << "Cannot open backup file." << std::endl;
+    std::lock_guard<std::mutex> persist(persistMutex_);
+    std::unique_lock<std::shared_mutex> lock(clientsMutex_);
+    
+    // Копия проверяется и разбирается до того, как что-либо на диске изменится
+    bool found = false;
+    std::string backup;
+    if (!DurableFile::read(backupPath, backup, isLegacyDatabaseFile, &found)) {
+        std::cerr << (found ? "Backup file is damaged." : "Cannot open backup file.") << std::endl;
         return false;
     }
     
-    // Создаем директорию если нужно
-    std::string dir = filename_.substr(0, filename_.find_last_of('/'));
-    if (!dir.empty()) {
-        system(("mkdir -p " + dir).c_str());
+    WorkerPool pool(loadThreads());
+    if (pool.size() > 1) {
+        pool.start();
     }
-    
-    std::ofstream dst(filename_, std::ios::binary);
-    if (!dst) {
+    std::unordered_map<std::string, ClientData> restored;
+    uint64_t backupLsn = 0;
+    bool parsed = Snapshot::isSnapshot(backup.data(), backup.size())
+        ? Snapshot::load(backup.data(), backup.size(), encryptionKey_, pool, restored, backupLsn)
+        : parseText(backup, pool, restored, backupLsn);
+    pool.stop();
+    if (!parsed) {
         std::cerr << "Cannot restore database." << std::endl;
         return false;
     }
     
-    dst << src.rdbuf();
+    // Копия получает LSN новее всех сегментов: если сбой случится до их удаления,
+    // при загрузке они окажутся старше основного файла и будут пропущены
+    std::string data;
+    if (!Snapshot::serialize(restored, lastLsn_.load() + 1, encryptionKey_, data) ||
+        !writeDatabaseFile(filename_, data)) {
+        std::cerr << "Cannot restore database." << std::endl;
+        return false;
+    }
     
     // Восстанавливаем настройки
     std::string settingsBackupPath = backupPath + ".settings";
-    std::ifstream srcSettings(settingsBackupPath, std::ios::binary);
-    if (srcSettings) {
-        std::ofstream dstSettings(settingsFilename(), std::ios::binary);
-        if (dstSettings) {
-            dstSettings << srcSettings.rdbuf();
-        }
+    if (std::filesystem::exists(settingsBackupPath)) {
+        copySettingsFile(settingsBackupPath, settingsFilename());
+    }
+    
+    // Журнал и сегменты относятся к прежнему состоянию базы
+    journal_.reset();
+    for (size_t segment = 0; segment < kSegments; segment++) {
+        std::remove(segmentFilename(segment).c_str());
     }
     
     // Перезагружаем данные
-    loadFromFile();
+    loadFromFileLocked();
     
     std::cout << "Database restored from backup: " << backupPath << std::endl;
     return true;
@@ -4,7 +4,18 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <atomic>
+#include <array>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <condition_variable>
 #include "account.h"
+#include "journal.h"
+#include "account_id_allocator.h"
+#include "worker_pool.h"
 
 #include <iostream>
 
@@ -24,16 +35,80 @@ struct ClientData {
     std::vector<Account> accounts;
 };
 
+// Положение счёта в базе: владелец и индекс счёта в его списке
+struct AccountLocation {
+    ClientData* owner;
+    size_t slot;
+};
+
+// Одна строка пакетного перевода: счёт получателя, сумма и описание
+struct TransferItem {
+    std::string toNumber;
+    Money amount;
+    std::string description;
+};
+
+// Счёт, зафиксированный для фоновой контрольной точки: баланс и длина истории
+struct AccountState {
+    Money balance;
+    size_t transactions;
+};
+
 struct BankSettings {
     double creditInterestRate = 12.0;
     double depositInterestRate = 6.5;
-    double largeOperationThreshold = 150000.0;
-    double largeLoanThreshold = 50000.0;
+    Money largeOperationThreshold = Money::fromUnits(150000);
+    Money largeLoanThreshold = Money::fromUnits(50000);
 };
 
+// Потокобезопасность: карта клиентов и индексы защищены clientsMutex_
+// (исключительно - при изменении состава клиентов и на контрольной точке),
+// а данные отдельных клиентов - мьютексами полос, выбираемыми по хешу accountId.
+// Операции двух клиентов захватывают полосы по возрастанию номера.
+//
+// На диске клиенты разложены по kSegments сегментам (<база>.seg.NN) по тому же
+// хешу; каждый сегмент - отдельный снимок со своим LSN. Изменение клиента
+// помечает его сегмент, и сохранение переписывает только помеченные сегменты -
+// но каждый целиком: одно изменение стоит записи 1/kSegments базы, а не одного
+// клиента. Учёт изменений по клиентам потребовал бы дописываемого формата
+// с уплотнением; пока единица записи - сегмент. Добавление, удаление,
+// верификация и правка клиента по-прежнему сохраняются сразу, не через журнал.
+// Основной файл после перехода на сегменты - снимок без клиентов; снимок
+// прежних версий в нём читается, а при первом сохранении раскладывается по сегментам.
+//
+// Периодическую контрольную точку выполняет фоновый поток: под исключительной
+// блокировкой он лишь фиксирует балансы и длины историй изменённых счетов и
+// переносит журнал в архив, а сериализует и пишет сегменты уже без неё.
+// Истории только дописываются, так что обработчики продолжают проводить
+// операции. Всё, что меняет состав клиентов и счетов, и любая запись файлов
+// базы идут под persistMutex_ - он берётся раньше clientsMutex_
 class Database {
 public:
+    static constexpr size_t kSegments = 16;
+    
+    // Блокировка записей одного или двух клиентов для чтения их полей
+    // (счета, история, статус). Пока она жива, методы Database, меняющие
+    // этих клиентов, из того же потока вызывать нельзя
+    class ClientLock {
+    public:
+        ClientLock() = default;
+        ClientLock(ClientLock&&) = default;
+        ClientLock& operator=(ClientLock&&) = default;
+        
+    private:
+        friend class Database;
+        std::shared_lock<std::shared_mutex> clients_;
+        std::unique_lock<std::mutex> first_;
+        std::unique_lock<std::mutex> second_;
+    };
+    
     Database(const std::string& filename);
+    ~Database();
+    
+    // Число потоков загрузки снимка; по умолчанию - по числу ядер
+    static void setLoadThreads(size_t threads);
+    static size_t loadThreads();
+    
     bool loadFromFile();
     bool saveToFile();
     bool addClient(const ClientData& client);
@@ -43,12 +118,40 @@ public:
     ClientData* authenticateClient(const std::string& accountId, const std::string& password);
     std::vector<std::string> getAllAccountIds();
     bool isPassportExists(const std::string& passportData);
+    // Номер для нового клиента: без поиска по базе и без повторов после перезапуска.
+    // Пустая строка - номера кончились
+    std::string allocateAccountId() { return accountIds_.allocate(); }
     bool verifyClient(const std::string& accountId);
     
     // Работа со счетами
     bool updateClientAccounts(const std::string& accountId, const std::vector<Account>& accounts);
     bool addAccountToClient(const std::string& accountId, const Account& account);
     bool findAccount(const std::string& accountNumber, ClientData** owner = nullptr, Account** account = nullptr);
+    // Номер счёта клиента по его порядковому индексу
+    bool getAccountNumber(const std::string& accountId, size_t index, std::string& accountNumber);
+    // Время открытия счёта - по первой операции в истории; у счёта без истории - now
+    bool getAccountOpenedAt(const std::string& accountId, size_t index, std::time_t now, std::time_t& openedAt);
+    
+    ClientLock lockClient(const std::string& accountId) const;
+    ClientLock lockClients(const std::string& firstId, const std::string& secondId) const;
+    
+    // Операции с балансом: проводятся в памяти и дописываются в журнал,
+    // изменённые сегменты базы перезаписываются только на контрольной точке.
+    // Счёт ищется по номеру под блокировкой, поэтому ссылки не устаревают
+    bool deposit(const std::string& accountNumber, Money amount, const std::string& description = "");
+    bool withdraw(const std::string& accountNumber, Money amount, const std::string& description = "");
+    bool transfer(const std::string& fromNumber, const std::string& toNumber, Money amount,
+                  const std::string& description = "");
+    // Пакетный перевод с одного счёта (зарплатная ведомость): строки проверяются
+    // за один проход, полосы всех получателей берутся один раз, в журнал уходит
+    // одна запись BATCH. atomic - проводятся все строки или ни одной; иначе
+    // каждая строка отдельно. В applied - итог по каждой строке.
+    // true, только если проведены все строки
+    bool transferBatch(const std::string& fromNumber, const std::vector<TransferItem>& items,
+                       bool atomic, std::vector<bool>* applied = nullptr);
+    bool deposit(Account& account, Money amount, const std::string& description = "");
+    bool withdraw(Account& account, Money amount, const std::string& description = "");
+    bool transfer(Account& from, Account& to, Money amount, const std::string& description = "");
     
     // Получение списков клиентов
     std::vector<ClientData*> getAllClients();
@@ -57,12 +160,16 @@ public:
     // Статистика
     size_t getClientCount() const;
     size_t getTotalAccountsCount() const;
-    double getTotalBalance() const;
+    Money getTotalBalance() const;
     
     // Настройки
     bool loadSettings();
     bool saveSettings(const BankSettings& settings);
-    BankSettings getSettings() const { return settings_; }
+    BankSettings getSettings() const;
+    
+    // Текстовый формат прежних версий: выгрузка и загрузка
+    bool exportToText(const std::string& path);
+    bool importFromText(const std::string& path);
     
     // Резервное копирование
     bool backupDatabase(const std::string& backupPath);
@@ -70,6 +177,9 @@ public:
     
     // Утилиты
     void clearDatabase();
+    const std::string& getFilename() const { return filename_; }
+    // Ключ файлов базы - им же шифруются журналы сервера рядом с ней
+    const std::string& getEncryptionKey() const { return encryptionKey_; }
     // Метод для отладки - вывод информации о клиентах
     void debugPrintClients() {
         std::cout << "=== DEBUG: Database Contents ===" << std::endl;
@@ -89,12 +199,132 @@ public:
     }
 
 private:
+    static const size_t kLockStripes = 64;
+    static_assert(kLockStripes % kSegments == 0, "segment must cover whole stripes");
+    
     std::string filename_;
     std::unordered_map<std::string, ClientData> clients_;
     BankSettings settings_;
+    mutable std::mutex settingsMutex_;
+    
+    mutable std::shared_mutex clientsMutex_;
+    mutable std::array<std::mutex, kLockStripes> stripes_;
     std::string encryptionKey_ = "bank-system-key-2024";
     
+    // Индекс номеров счетов. Указатели на клиентов устойчивы: узлы
+    // unordered_map не перемещаются, а счета клиента только дописываются
+    std::unordered_map<std::string, AccountLocation> accountIndex_;
+    
+    // Паспорта всех клиентов для проверки уникальности при регистрации.
+    // Мультимножество: в старых базах паспорт мог повторяться
+    std::unordered_multiset<std::string> passports_;
+    
+    // Номера новых клиентов; загруженные клиенты учитываются в indexClient
+    AccountIdAllocator accountIds_;
+    
+    // Журнал операций и номер последней записи (LSN)
+    Journal journal_;
+    std::atomic<uint64_t> lastLsn_{0};
+    
+    // Клиенты каждого сегмента - чтобы сохранение не обходило всю карту
+    std::array<std::vector<const ClientData*>, kSegments> segmentMembers_;
+    
+    // Сегменты с изменениями после прошлого сохранения. Помечаются под
+    // разделяемой блокировкой, сбрасываются под исключительной
+    std::array<std::atomic<bool>, kSegments> dirtySegments_;
+    // По какую запись журнала учтена каждая копия сегмента на диске
+    std::array<uint64_t, kSegments> segmentLsn_{};
+    // На диске есть все сегменты, основной файл клиентов не содержит
+    bool segmented_ = false;
+    // Запись файлов базы; защищает segmentLsn_ и segmented_
+    std::mutex persistMutex_;
+    
+    // Фоновая контрольная точка; поток запускается при первом запросе
+    std::thread checkpointer_;
+    std::mutex checkpointMutex_;
+    std::condition_variable checkpointCV_;
+    bool checkpointRequested_ = false;
+    bool stopping_ = false;
+    
+    // Клиенты помеченных сегментов, разложенные для записи. Для фоновой
+    // контрольной точки к ним прилагаются зафиксированные состояния счетов
+    struct SegmentBatch {
+        uint64_t lsn = 0;
+        bool frozen = false;
+        std::array<bool, kSegments> selected{};
+        std::array<std::vector<const ClientData*>, kSegments> members;
+        std::array<std::vector<AccountState>, kSegments> states;
+    };
+    
     std::string settingsFilename() const { return filename_ + ".settings"; }
+    std::string journalFilename() const { return filename_ + ".journal"; }
+    std::string segmentFilename(size_t segment) const;
+    
+    // Сколько потоков разбирают снимок при загрузке (0 - по числу ядер)
+    static size_t loadThreads_;
+    
+    bool parseText(const std::string& encryptedData, WorkerPool& pool,
+                   std::unordered_map<std::string, ClientData>& clients, uint64_t& lsn);
+    bool decryptText(const std::string& encryptedData, WorkerPool& pool, std::string& decryptedData);
+    bool parseTextChunk(const std::string& text, size_t begin, size_t end,
+                        std::unordered_map<std::string, ClientData>& clients, uint64_t& lsn);
+    std::string formatText() const;
+    
+    // Версии без захвата блокировок: вызывающий уже держит persistMutex_ и clientsMutex_
+    bool loadFromFileLocked();
+    bool saveToFileLocked();
+    size_t totalAccountsLocked() const;
+    const AccountLocation* locateAccount(const std::string& accountNumber) const;
+    
+    size_t stripeOf(const std::string& accountId) const;
+    size_t segmentOf(const std::string& accountId) const { return stripeOf(accountId) % kSegments; }
+    void markDirty(const std::string& accountId);
+    void markAllDirty();
+    void lockStripes(const std::string& firstId, const std::string& secondId,
+                     std::unique_lock<std::mutex>& first, std::unique_lock<std::mutex>& second) const;
+    // Будит фоновую контрольную точку, когда журнал дорос до kCheckpointInterval
+    void checkpointIfDue();
+    void checkpointLoop();
+    bool checkpointInBackground();
+    // Раскладывает клиентов помеченных сегментов и снимает пометки; под clientsMutex_
+    void collectDirty(SegmentBatch& batch, bool freeze);
+    // Сериализует и пишет сегменты пакета; при ошибке пометки возвращаются. Под persistMutex_
+    bool writeSegments(const SegmentBatch& batch);
+    
+    void indexClient(ClientData& client);
+    void unindexClient(const ClientData& client);
+    void rebuildIndexes();
+    
+    bool appendJournal(const std::string& type, const std::string& body);
+    // Ставит запись в журнал и возвращает её номер для Journal::wait (0 - ошибка)
+    uint64_t enqueueJournal(const std::string& type, const std::string& body);
+    bool journalTransaction(const std::string& accountNumber, const Transaction& transaction);
+    // Обе стороны перевода - одна запись XFER: при восстановлении применяются вместе или никак
+    bool journalTransfer(const std::string& fromNumber, const std::string& toNumber,
+                         const Transaction& debit, const Transaction& credit);
+    bool journalBatch(const std::string& fromNumber, const std::vector<std::string>& toNumbers,
+                      const std::vector<Transaction>& debits, const std::vector<Transaction>& credits);
+    bool journalAccount(const std::string& accountId, const Account& account);
+    // Регистрация и смена статуса клиента: место в журнале занимается под
+    // clientsMutex_, сброса на диск вызывающий ждёт уже без блокировки
+    uint64_t enqueueClient(const ClientData& client);
+    uint64_t enqueueStatus(const std::string& accountId, ClientStatus status);
+    // Доигрывает журнал поверх сегментов, каждому - записи после его LSN
+    void replayJournal();
+    void applyJournalRecord(const std::string& record, uint64_t snapshotLsn,
+                            std::unordered_set<uint64_t>& replayed);
+    // Нужна ли клиенту запись журнала; если да - его сегмент помечается изменённым
+    bool replayFor(const ClientData& owner, uint64_t lsn);
+    // Перевод из записи XFER или строка BATCH: получатель и проводки обеих сторон
+    struct JournalTransfer {
+        std::string toNumber;
+        Transaction debit;
+        Transaction credit;
+    };
+    // Разбор полей одного перевода после номера счёта списания; false, если
+    // поля обрезаны или сумма не положительна
+    bool parseTransferFields(std::istream& fields, const std::string& fromNumber, JournalTransfer& transfer);
+    void applyTransfer(const std::string& fromNumber, const JournalTransfer& transfer, uint64_t lsn);
 };
 
 #endif
@@ -0,0 +1,208 @@
+#include "durable_file.h"
+#include "crc32c.h"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const char kMagic[8] = {'B', 'A', 'N', 'K', 'C', 'R', 'C', '1'};
+
+struct Footer {
+    char magic[8];
+    uint64_t payloadSize;
+    uint32_t blockSize;
+    uint32_t tableCrc;      // сумма таблицы и полей хвоста до этого
+};
+
+static_assert(sizeof(Footer) == 24, "checksum footer layout changed");
+
+// Временные файлы различаются, даже если один путь пишут два потока сразу
+std::atomic<uint64_t> tempCounter{0};
+
+uint32_t tableChecksum(const char* table, size_t tableSize, const Footer& footer) {
+    uint32_t crc = Crc32c::compute(table, tableSize);
+    return Crc32c::compute(&footer, offsetof(Footer, tableCrc), crc);
+}
+
+bool writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+}
+
+bool DurableFile::syncParentDirectory(const std::string& path) {
+    std::string dir = std::filesystem::path(path).parent_path().string();
+    int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+bool DurableFile::createParentDirectories(const std::string& path) {
+    std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    if (dir.empty()) {
+        return true;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        std::cerr << "Error: Could not create directory " << dir.string() << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool DurableFile::write(const std::string& path, const std::string& data) {
+    if (!createParentDirectories(path)) {
+        return false;
+    }
+
+    std::string temp = path + ".tmp." + std::to_string(getpid()) + "." + std::to_string(++tempCounter);
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open file for writing: " << temp
+                  << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+
+    bool ok = writeAll(fd, data) && fsync(fd) == 0;
+    int error = errno;
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+        if (ok) error = errno;
+        std::cerr << "Error: Could not write file: " << path << " (" << strerror(error) << ")" << std::endl;
+        std::remove(temp.c_str());
+        return false;
+    }
+
+    // Без этого после сбоя питания каталог может всё ещё указывать на прежний файл
+    if (!syncParentDirectory(path)) {
+        std::cerr << "Warning: Could not sync directory of " << path << std::endl;
+    }
+    return true;
+}
+
+void DurableFile::appendChecksums(std::string& data) {
+    size_t payloadSize = data.size();
+    size_t blocks = (payloadSize + kBlockSize - 1) / kBlockSize;
+    data.reserve(payloadSize + blocks * sizeof(uint32_t) + sizeof(Footer));
+
+    for (size_t block = 0; block < blocks; block++) {
+        size_t offset = block * kBlockSize;
+        uint32_t crc = Crc32c::compute(data.data() + offset, std::min<size_t>(kBlockSize, payloadSize - offset));
+        data.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+    }
+
+    Footer footer{};
+    std::memcpy(footer.magic, kMagic, sizeof(kMagic));
+    footer.payloadSize = payloadSize;
+    footer.blockSize = kBlockSize;
+    footer.tableCrc = tableChecksum(data.data() + payloadSize, blocks * sizeof(uint32_t), footer);
+    data.append(reinterpret_cast<const char*>(&footer), sizeof(footer));
+}
+
+bool DurableFile::verify(const char* data, size_t size, size_t& payloadSize,
+                         const LegacyCheck& legacy, WorkerPool* pool) {
+    Footer footer;
+    if (size < sizeof(Footer) ||
+        std::memcmp(data + size - sizeof(Footer), kMagic, sizeof(kMagic)) != 0) {
+        // Без хвоста - только файл прежней версии; новый формат без хвоста
+        // значит оборванную запись или испорченный хвост
+        if (!legacy(data, size)) {
+            return false;
+        }
+        payloadSize = size;
+        return true;
+    }
+    std::memcpy(&footer, data + size - sizeof(Footer), sizeof(Footer));
+
+    if (footer.blockSize == 0 || footer.payloadSize > size - sizeof(Footer)) {
+        return false;
+    }
+    uint64_t blocks = (footer.payloadSize + footer.blockSize - 1) / footer.blockSize;
+    if (blocks > (size - sizeof(Footer) - footer.payloadSize) / sizeof(uint32_t) ||
+        footer.payloadSize + blocks * sizeof(uint32_t) + sizeof(Footer) != size) {
+        return false;
+    }
+
+    const char* table = data + footer.payloadSize;
+    if (tableChecksum(table, blocks * sizeof(uint32_t), footer) != footer.tableCrc) {
+        return false;
+    }
+
+    size_t parts = pool && pool->size() > 1 ? std::min<uint64_t>(blocks, pool->size() * 4) : 1;
+    std::vector<char> partOk(parts, 0);
+    auto check = [&](size_t part) {
+        for (uint64_t block = blocks * part / parts; block < blocks * (part + 1) / parts; block++) {
+            uint64_t offset = block * footer.blockSize;
+            uint32_t expected;
+            std::memcpy(&expected, table + block * sizeof(uint32_t), sizeof(expected));
+            size_t length = std::min<uint64_t>(footer.blockSize, footer.payloadSize - offset);
+            if (Crc32c::compute(data + offset, length) != expected) {
+                return;
+            }
+        }
+        partOk[part] = 1;
+    };
+    if (parts > 1) {
+        pool->run(parts, check);
+    } else if (parts == 1) {
+        check(0);
+    }
+    if (std::find(partOk.begin(), partOk.end(), 0) != partOk.end()) {
+        return false;
+    }
+
+    payloadSize = footer.payloadSize;
+    return true;
+}
+
+bool DurableFile::isLegacyText(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        unsigned char c = data[i];
+        if ((c < 0x20 && c != '\t' && c != '\n' && c != '\r') || c == 0x7F) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DurableFile::read(const std::string& path, std::string& payload, const LegacyCheck& legacy, bool* found) {
+    std::ifstream file(path, std::ios::binary);
+    if (found) *found = static_cast<bool>(file);
+    if (!file) {
+        return false;
+    }
+
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    size_t payloadSize = 0;
+    if (!verify(data.data(), data.size(), payloadSize, legacy)) {
+        std::cerr << "Error: Checksum mismatch, file is damaged: " << path << std::endl;
+        return false;
+    }
+    data.resize(payloadSize);
+    payload = std::move(data);
+    return true;
+}
@@ -0,0 +1,52 @@
+#ifndef DURABLE_FILE_H
+#define DURABLE_FILE_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "worker_pool.h"
+
+// Запись файлов базы без окна, в котором на диске лежит полуфайл: данные
+// пишутся во временный файл рядом, сбрасываются fsync и переименовываются
+// поверх прежнего, затем fsync каталога закрепляет само переименование.
+// Сбой в любой момент оставляет либо старый файл, либо новый целиком.
+//
+// Контрольные суммы дописываются в конец файла, данные остаются на месте
+// (снимок по-прежнему отображается в память и читается без копирования):
+//
+//   [данные] [CRC32C каждого блока kBlockSize] [хвост: магия, размер данных,
+//   размер блока, CRC32C таблицы сумм и хвоста]
+//
+// Файлы прежних версий хвоста не имеют. Файл без хвоста принимается, только
+// если его содержимое - в прежнем формате (снимок версии ниже 3, текст без
+// двоичных байтов); это решает проверка, которую передаёт читающий
+class DurableFile {
+public:
+    static constexpr uint32_t kBlockSize = 64 * 1024;
+    
+    using LegacyCheck = std::function<bool(const char* data, size_t size)>;
+
+    static bool write(const std::string& path, const std::string& data);
+    // Каталог, в котором лежит path, со всеми родительскими
+    static bool createParentDirectories(const std::string& path);
+    // fsync каталога, в котором лежит path: закрепляет создание, переименование
+    // и удаление файлов в нём
+    static bool syncParentDirectory(const std::string& path);
+
+    static void appendChecksums(std::string& data);
+    // Проверяет суммы; payloadSize - размер данных без сумм. Файл без хвоста
+    // допускается, если legacy признаёт его формат прежним. Блоки проверяются
+    // параллельно на потоках pool, если он передан
+    static bool verify(const char* data, size_t size, size_t& payloadSize,
+                       const LegacyCheck& legacy, WorkerPool* pool = nullptr);
+    // Читает файл целиком, проверяет и отрезает суммы. found - удалось ли открыть файл
+    static bool read(const std::string& path, std::string& payload,
+                     const LegacyCheck& legacy, bool* found = nullptr);
+    
+    // Текст прежних версий (очередь, выгрузка): без нулевых и управляющих
+    // байтов, кроме табуляции и переводов строки. В хвосте сумм они есть всегда
+    static bool isLegacyText(const char* data, size_t size);
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "id_generator.h"
+#include "durable_file.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+const int kSequenceBits = 9;
+const int kShardBits = 6;
+const int kNodeBits = 4;
+const int kTimeBits = 41;
+
+const uint64_t kShardCount = uint64_t(1) << kShardBits;
+const uint64_t kMaxSequence = (uint64_t(1) << kSequenceBits) - 1;
+const uint64_t kTimeMask = (uint64_t(1) << kTimeBits) - 1;
+
+// 2024-01-01 00:00:00 UTC в миллисекундах
+const int64_t kEpochMs = 1704067200000;
+
+// Крокфорд: без I, L, O, U; порядок символов совпадает с порядком значений,
+// поэтому id одного потока сравниваются как строки
+const char kAlphabet[] = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
+
+// Состояние шарда живёт дольше потока-владельца: следующий владелец
+// продолжает с последней выданной миллисекунды и не повторит id
+struct alignas(64) Shard {
+    uint64_t lastMs = 0;
+    uint64_t sequence = 0;
+};
+
+Shard shards[kShardCount];
+// Свободные шарды - единичные биты; шард 0 общий, его не раздаём
+std::atomic<uint64_t> freeShards{~uint64_t(1)};
+std::mutex sharedMutex;
+std::atomic<unsigned> nodeId{0};
+std::atomic<IdGenerator::Clock> clockSource{nullptr};
+
+// Отметка времени на диске переписывается заранее, на столько вперёд
+const uint64_t kReserveMs = 1000;
+
+std::mutex reserveMutex;
+std::string stateFile;                  // под reserveMutex; пустой - отметка не ведётся
+std::atomic<bool> persisted{false};
+std::atomic<uint64_t> reservedMs{0};    // время id до этой отметки уже записано на диск
+
+struct ShardLease {
+    uint64_t shard = 0;
+
+    ShardLease() {
+        uint64_t free = freeShards.load(std::memory_order_relaxed);
+        while (free != 0) {
+            uint64_t bit = free & (~free + 1);
+            if (freeShards.compare_exchange_weak(free, free & ~bit, std::memory_order_acquire)) {
+                shard = __builtin_ctzll(bit);
+                return;
+            }
+        }
+    }
+
+    ~ShardLease() {
+        if (shard != 0) {
+            freeShards.fetch_or(uint64_t(1) << shard, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ShardLease lease;
+
+uint64_t currentMs() {
+    IdGenerator::Clock clock = clockSource.load(std::memory_order_relaxed);
+    if (clock) {
+        return clock();
+    }
+    int64_t sinceEpoch = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count() - kEpochMs;
+    return sinceEpoch > 0 ? static_cast<uint64_t>(sinceEpoch) : 0;
+}
+
+void reserveUpTo(uint64_t ms) {
+    std::lock_guard<std::mutex> lock(reserveMutex);
+    if (stateFile.empty() || ms <= reservedMs.load(std::memory_order_relaxed)) {
+        return;
+    }
+    // Отметка заменяется атомарно; id с этим временем выдаётся, когда она на диске
+    uint64_t mark = ms + kReserveMs;
+    if (!DurableFile::write(stateFile, std::to_string(mark) + "\n")) {
+        std::cerr << "Error: Could not save id clock high-water mark: " << stateFile << std::endl;
+    }
+    reservedMs.store(mark, std::memory_order_release);
+}
+
+uint64_t advance(Shard& state, uint64_t shard) {
+    uint64_t now = currentMs();
+
+    if (now > state.lastMs) {
+        state.lastMs = now;
+        state.sequence = 0;
+    } else if (state.sequence < kMaxSequence) {
+        // Та же миллисекунда или часы ушли назад - время не уменьшаем
+        state.sequence++;
+    } else {
+        // Счётчик миллисекунды исчерпан. Без отметки на диске забегать вперёд
+        // часов нельзя - перезапущенный процесс повторил бы id, - поэтому ждём
+        // следующую миллисекунду, но не дольше: если часы ушли назад, ожидание
+        // длилось бы столько, на сколько их перевели. Тогда, как и с отметкой,
+        // время id сдвигается на миллисекунду вперёд
+        bool marked = persisted.load(std::memory_order_relaxed);
+        while (!marked && now == state.lastMs) {
+            std::this_thread::yield();
+            now = currentMs();
+        }
+        state.lastMs = now > state.lastMs ? now : state.lastMs + 1;
+        state.sequence = 0;
+    }
+    if (persisted.load(std::memory_order_relaxed) && state.lastMs > reservedMs.load(std::memory_order_acquire)) {
+        reserveUpTo(state.lastMs);
+    }
+
+    return (state.lastMs & kTimeMask) << (kNodeBits + kShardBits + kSequenceBits) |
+           uint64_t(nodeId.load(std::memory_order_relaxed)) << (kShardBits + kSequenceBits) |
+           shard << kSequenceBits |
+           state.sequence;
+}
+
+}
+
+uint64_t IdGenerator::nextValue() {
+    uint64_t shard = lease.shard;
+    if (shard != 0) {
+        return advance(shards[shard], shard);
+    }
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    return advance(shards[0], 0);
+}
+
+void IdGenerator::format(const char* prefix, uint64_t value, char* out) {
+    out[0] = prefix[0];
+    out[1] = prefix[1];
+    out[2] = prefix[2];
+    for (size_t i = kLength - 1; i >= 3; i--) {
+        out[i] = kAlphabet[value & 31];
+        value >>= 5;
+    }
+}
+
+std::string IdGenerator::next(const char* prefix) {
+    char buffer[kLength];
+    format(prefix, nextValue(), buffer);
+    return std::string(buffer, kLength);
+}
+
+void IdGenerator::setNode(unsigned node) {
+    nodeId.store(node & ((1u << kNodeBits) - 1), std::memory_order_relaxed);
+}
+
+void IdGenerator::setClock(Clock clock) {
+    clockSource.store(clock, std::memory_order_relaxed);
+}
+
+void IdGenerator::setStateFile(const std::string& path) {
+    std::lock_guard<std::mutex> lock(reserveMutex);
+    stateFile = path;
+    reservedMs.store(0, std::memory_order_relaxed);
+    persisted.store(!path.empty(), std::memory_order_relaxed);
+
+    std::ifstream file(path);
+    uint64_t mark = 0;
+    if (path.empty() || !(file >> mark)) {
+        return;
+    }
+    // Всё выданное прошлым запуском не новее отметки: шарды продолжают выше неё,
+    // даже если часы с тех пор перевели назад
+    for (Shard& shard : shards) {
+        if (shard.lastMs <= mark) {
+            shard.lastMs = mark;
+            shard.sequence = kMaxSequence;
+        }
+    }
+    reservedMs.store(mark, std::memory_order_release);
+}
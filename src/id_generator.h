@@ -0,0 +1,50 @@
+#ifndef ID_GENERATOR_H
+#define ID_GENERATOR_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Идентификаторы операций и запросов: 60 бит в духе Snowflake -
+// миллисекунды от 2024-01-01 (41 бит), номер узла (4), шард потока (6),
+// счётчик в пределах миллисекунды (9). Записываются префиксом из трёх
+// букв и 12 знаками base32 Крокфорда: "TXN01HV3K2M9QZ7", всегда 15 символов,
+// строка умещается во внутренний буфер std::string.
+//
+// Каждый поток получает свой шард при первом обращении и возвращает его
+// при завершении, поэтому генерация не берёт блокировок, не делает
+// системных вызовов (часы читаются через vDSO; отметка ниже пишется раз
+// в секунду) и не выделяет память.
+// Если шардов не хватило, поток пользуется общим шардом под мьютексом.
+// Уникальность между перезапусками даёт время. Сервер ведёт отметку на
+// диске (setStateFile): время выданных id не превышает её, а после
+// перезапуска шарды начинают выше неё, даже если часы перевели назад.
+// Отметка переписывается заранее, раз в секунду времени id, поэтому
+// исчерпанный счётчик миллисекунды просто берёт следующую. Без отметки
+// (утилиты) время в id не забегает вперёд часов - исчерпанный счётчик ждёт
+// следующую миллисекунду, - и id нового процесса больше прежних, если часы
+// не переводили назад. Внутри процесса время в id не откатывается, а после
+// перевода часов назад выдача не ждёт, пока они догонят выданное.
+// Процессы, одновременно пишущие в одну базу, должны иметь разные номера узлов
+class IdGenerator {
+public:
+    static constexpr size_t kLength = 15;
+
+    // prefix - ровно три символа
+    static std::string next(const char* prefix);
+    static uint64_t nextValue();
+    // Записывает kLength символов в out, без завершающего нуля
+    static void format(const char* prefix, uint64_t value, char* out);
+
+    // Номер узла 0..15; задаётся до первой генерации
+    static void setNode(unsigned node);
+
+    // Файл отметки времени; задаётся до начала генерации, пустой путь - без отметки
+    static void setStateFile(const std::string& path);
+
+    // Источник времени для тестов: миллисекунды от эпохи id; nullptr - системные часы
+    using Clock = uint64_t (*)();
+    static void setClock(Clock clock);
+};
+
+#endif
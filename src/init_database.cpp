@@ -1,40 +1,22 @@
 #include <iostream>
 #include "database.h"
 #include "crypto.h"
+#include "id_generator.h"
+#include "durable_file.h"
 #include <filesystem>
-#include <fstream>
 #include <sstream>
-#include <random>
-
-// Функция для генерации ID запроса
-std::string generateRequestId() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 9999);
-    
-    std::stringstream ss;
-    ss << "REQ" << std::time(nullptr) << dis(gen);
-    return ss.str();
-}
 
 // Функция для создания файла с запросами верификации
 void createVerificationRequests() {
     std::cout << "Creating verification requests for test users..." << std::endl;
     
-    // Создаем директорию для данных если нужно
-    std::filesystem::create_directories("data");
-    
-    std::ofstream verificationFile("data/verification_queue.dat");
-    if (!verificationFile) {
-        std::cerr << "Warning: Could not create verification queue file" << std::endl;
-        return;
-    }
+    std::stringstream verificationFile;
     
     // Текущее время для всех запросов
     std::time_t currentTime = std::time(nullptr);
     
     // Запрос верификации для ACC1003
-    std::string requestId1 = generateRequestId();
+    std::string requestId1 = IdGenerator::next("REQ");
     verificationFile << requestId1 << "|"
                     << "ACC1003" << "|"
                     << "VERIFICATION" << "|"
@@ -44,9 +26,15 @@ void createVerificationRequests() {
                     << currentTime << "|"
                     << "PENDING" << "|\n";
     
-    std::cout << "✅ Created verification request for ACC1003: " << requestId1 << std::endl;
+    // Формат тот же, что пишет сервер: с контрольными суммами
+    std::string data = verificationFile.str();
+    DurableFile::appendChecksums(data);
+    if (!DurableFile::write("data/verification_queue.dat", data)) {
+        std::cerr << "Warning: Could not create verification queue file" << std::endl;
+        return;
+    }
     
-    verificationFile.close();
+    std::cout << "✅ Created verification request for ACC1003: " << requestId1 << std::endl;
 }
 
 void createTestUsers(Database& db) {
@@ -64,14 +52,14 @@ void createTestUsers(Database& db) {
     client1.passwordHash = Crypto::hashPassword("password123");
     client1.status = ClientStatus::VERIFIED;
     
-    Account acc1("ACC1001_SAV_1", AccountType::SAVINGS, 50000.0);
-    Account acc2("ACC1001_CHK_2", AccountType::CHECKING, 25000.0);
-    Account acc3("ACC1001_CRD_3", AccountType::CREDIT, 0.0);
-    acc3.setCreditLimit(50000.0);
+    Account acc1("ACC1001_SAV_1", AccountType::SAVINGS, Money::fromUnits(50000));
+    Account acc2("ACC1001_CHK_2", AccountType::CHECKING, Money::fromUnits(25000));
+    Account acc3("ACC1001_CRD_3", AccountType::CREDIT, Money());
+    acc3.setCreditLimit(Money::fromUnits(50000));
     
     // Добавляем тестовые транзакции для проверки
-    acc1.deposit(50000.0, "Initial deposit");
-    acc2.deposit(25000.0, "Initial deposit");
+    acc1.deposit(Money::fromUnits(50000), "Initial deposit");
+    acc2.deposit(Money::fromUnits(25000), "Initial deposit");
     
     client1.accounts.push_back(acc1);
     client1.accounts.push_back(acc2);
@@ -86,11 +74,11 @@ void createTestUsers(Database& db) {
     client2.passwordHash = Crypto::hashPassword("qwerty456");
     client2.status = ClientStatus::VERIFIED;
     
-    Account acc4("ACC1002_SAV_1", AccountType::SAVINGS, 75000.0);
-    Account acc5("ACC1002_DEP_2", AccountType::DEPOSIT, 50000.0);
+    Account acc4("ACC1002_SAV_1", AccountType::SAVINGS, Money::fromUnits(75000));
+    Account acc5("ACC1002_DEP_2", AccountType::DEPOSIT, Money::fromUnits(50000));
     
-    acc4.deposit(75000.0, "Initial deposit");
-    acc5.deposit(50000.0, "Initial deposit");
+    acc4.deposit(Money::fromUnits(75000), "Initial deposit");
+    acc5.deposit(Money::fromUnits(50000), "Initial deposit");
     
     client2.accounts.push_back(acc4);
     client2.accounts.push_back(acc5);
@@ -104,8 +92,8 @@ void createTestUsers(Database& db) {
     client3.passwordHash = Crypto::hashPassword("test789");
     client3.status = ClientStatus::PENDING_VERIFICATION;
     
-    Account acc6("ACC1003_SAV_1", AccountType::SAVINGS, 5000.0);
-    acc6.deposit(5000.0, "Initial deposit");
+    Account acc6("ACC1003_SAV_1", AccountType::SAVINGS, Money::fromUnits(5000));
+    acc6.deposit(Money::fromUnits(5000), "Initial deposit");
     client3.accounts.push_back(acc6);
     
     // Супер-пользователь
@@ -117,7 +105,7 @@ void createTestUsers(Database& db) {
     superUser.passwordHash = Crypto::hashPassword("superpass123");
     superUser.status = ClientStatus::VERIFIED;
     
-    Account superAcc("SUPER001_CHK_1", AccountType::CHECKING, 0.0);
+    Account superAcc("SUPER001_CHK_1", AccountType::CHECKING, Money());
     superUser.accounts.push_back(superAcc);
     
     // Добавляем всех клиентов
@@ -0,0 +1,419 @@
+#include "journal.h"
+#include "crypto.h"
+#include "crc32c.h"
+#include "durable_file.h"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Окно группировки: сколько писатель ждёт попутные записи перед сбросом
+const std::chrono::microseconds kGroupCommitWindow(200);
+
+// Группа сбрасывается сразу, как только набралось столько записей
+const size_t kMaxGroupRecords = 256;
+
+// Кадр записи на диске: "<длина>:<crc32c>:<шифротекст>\n". Длина и сумма
+// считаются по шифротексту: оборванная или испорченная запись отбрасывается
+// целиком, а не разбирается наполовину
+std::string frameRecord(const std::string& payload) {
+    char header[32];
+    int headerSize = std::snprintf(header, sizeof(header), "%zu:%08x:", payload.size(),
+                                   static_cast<unsigned>(Crc32c::compute(payload.data(), payload.size())));
+    std::string line;
+    line.reserve(headerSize + payload.size() + 1);
+    line.append(header, headerSize);
+    line += payload;
+    line += '\n';
+    return line;
+}
+
+// Строка журнала без '\n'; false, если длина или сумма не сходятся
+bool unframeRecord(const std::string& line, std::string& payload) {
+    size_t lengthEnd = line.find(':');
+    if (lengthEnd == 0 || lengthEnd > 19 || lengthEnd + 10 > line.size() || line[lengthEnd + 9] != ':') {
+        return false;
+    }
+    size_t length = 0;
+    for (size_t i = 0; i < lengthEnd; i++) {
+        if (line[i] < '0' || line[i] > '9') return false;
+        length = length * 10 + (line[i] - '0');
+    }
+    uint32_t crc = 0;
+    for (size_t i = lengthEnd + 1; i < lengthEnd + 9; i++) {
+        char c = line[i];
+        int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (digit < 0) return false;
+        crc = (crc << 4) | static_cast<uint32_t>(digit);
+    }
+
+    size_t payloadStart = lengthEnd + 10;
+    if (line.size() - payloadStart != length ||
+        Crc32c::compute(line.data() + payloadStart, length) != crc) {
+        return false;
+    }
+    payload.assign(line, payloadStart, length);
+    return true;
+}
+
+// Отрезает хвост файла после последней целой записи и закрепляет усечение
+bool truncateFile(const std::string& filename, uint64_t size) {
+    int fd = open(filename.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = ftruncate(fd, static_cast<off_t>(size)) == 0 && fdatasync(fd) == 0;
+    return close(fd) == 0 && ok;
+}
+
+}
+
+Journal::Journal(const std::string& filename, const std::string& key)
+    : filename_(filename), key_(key), fd_(-1), recordCount_(0),
+      enqueuedSeq_(0), durableSeq_(0), stopping_(false) {}
+
+Journal::~Journal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    pendingCV_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool Journal::openFile() {
+    if (fd_ >= 0) return true;
+
+    std::filesystem::path dir = std::filesystem::path(filename_).parent_path();
+    if (!dir.empty()) {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+    }
+
+    fd_ = open(filename_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd_ < 0) {
+        std::cerr << "Error: Could not open journal for writing: " << filename_
+                  << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Journal::append(const std::string& record) {
+    uint64_t seq = enqueue(record);
+    return seq != 0 && wait(seq);
+}
+
+uint64_t Journal::enqueue(const std::string& record) {
+    // Шифруем и считаем сумму вне блокировки; base64 не содержит '\n',
+    // поэтому запись - ровно одна строка
+    std::string line = frameRecord(Crypto::encrypt(record, key_));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) return 0;
+
+    if (!writer_.joinable()) {
+        writer_ = std::thread(&Journal::writerLoop, this);
+    }
+
+    pending_.push_back(std::move(line));
+    pendingCV_.notify_one();
+    return ++enqueuedSeq_;
+}
+
+bool Journal::wait(uint64_t seq) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (durableSeq_ < seq) {
+        durableCV_.wait_for(lock, std::chrono::milliseconds(100));
+    }
+
+    if (isFailed(seq)) {
+        std::cerr << "Error: Could not append to journal: " << filename_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Journal::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::vector<std::string> group;
+
+    while (true) {
+        while (!stopping_ && pending_.empty()) {
+            pendingCV_.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        if (pending_.empty()) {
+            return; // остановка и всё уже записано
+        }
+
+        // Даём параллельным обработчикам присоединиться к группе
+        auto deadline = std::chrono::steady_clock::now() + kGroupCommitWindow;
+        while (!stopping_ && pending_.size() < kMaxGroupRecords &&
+               std::chrono::steady_clock::now() < deadline) {
+            pendingCV_.wait_until(lock, deadline);
+        }
+
+        group.clear();
+        group.swap(pending_);
+        uint64_t firstSeq = durableSeq_ + 1;
+        uint64_t lastSeq = enqueuedSeq_;
+        lock.unlock();
+
+        std::string data;
+        for (const auto& line : group) {
+            data += line;
+        }
+        bool ok = writeGroup(data);
+
+        lock.lock();
+        if (ok) {
+            recordCount_ += group.size();
+        } else {
+            failedRanges_.emplace_back(firstSeq, lastSeq);
+        }
+        durableSeq_ = lastSeq;
+        durableCV_.notify_all();
+    }
+}
+
+bool Journal::writeGroup(const std::string& data) {
+    if (!openFile()) return false;
+
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd_, data.data() + written, data.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: Journal write failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+        written += n;
+    }
+
+    if (fdatasync(fd_) != 0) {
+        std::cerr << "Error: Journal fdatasync failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Journal::isFailed(uint64_t seq) const {
+    for (const auto& range : failedRanges_) {
+        if (seq >= range.first && seq <= range.second) return true;
+    }
+    return false;
+}
+
+size_t Journal::replayFile(const std::string& filename, const std::function<void(const std::string&)>& apply) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        return 0; // файла нет - нечего воспроизводить
+    }
+
+    size_t replayed = 0;
+    uint64_t offset = 0;
+    uint64_t validEnd = 0; // конец последней целой записи
+    std::string line, payload;
+    while (std::getline(file, line)) {
+        if (file.eof()) {
+            break; // нет '\n': сбой посреди дописывания
+        }
+        offset += line.size() + 1;
+        if (line.empty()) continue;
+
+        if (!unframeRecord(line, payload)) {
+            std::cerr << "Warning: Skipping damaged journal record in " << filename << std::endl;
+            continue;
+        }
+        validEnd = offset;
+        try {
+            apply(Crypto::decrypt(payload, key_));
+            replayed++;
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: Skipping damaged journal record: " << e.what() << std::endl;
+        }
+    }
+    file.close();
+
+    // Оборванный хвост отрезается до того, как журнал откроется на дописывание:
+    // иначе следующая подтверждённая запись склеилась бы с ним в одну строку
+    // и пропала бы при следующем восстановлении
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(filename, ec);
+    if (!ec && size > validEnd) {
+        std::cerr << "Warning: Cutting off " << (size - validEnd) << " bytes of incomplete records from "
+                  << filename << std::endl;
+        if (!truncateFile(filename, validEnd)) {
+            std::cerr << "Error: Could not truncate journal: " << filename
+                      << " (" << strerror(errno) << ")" << std::endl;
+        }
+    }
+    return replayed;
+}
+
+bool Journal::replay(const std::function<void(const std::string&)>& apply) {
+    // Архив старше основного файла: записи идут по возрастанию LSN
+    size_t replayed = replayFile(archiveFilename(), apply);
+    replayed += replayFile(filename_, apply);
+
+    recordCount_ = replayed;
+    if (replayed > 0) {
+        std::cout << "Replayed " << replayed << " journal records." << std::endl;
+    }
+    return true;
+}
+
+void Journal::drain(std::unique_lock<std::mutex>& lock) {
+    // Дожидаемся, пока писатель сбросит всё, что уже поставлено в очередь
+    while (durableSeq_ < enqueuedSeq_) {
+        durableCV_.wait_for(lock, std::chrono::milliseconds(100));
+    }
+    // Неудачные диапазоны остаются: автор записи мог ещё не вызвать wait
+    recordCount_ = 0;
+}
+
+void Journal::appendField(std::string& record, const std::string& field) {
+    for (char c : field) {
+        switch (c) {
+            case '\\': record += "\\\\"; break;
+            case '|': record += "\\|"; break;
+            case '\n': record += "\\n"; break;
+            default: record += c;
+        }
+    }
+    record += '|';
+}
+
+bool Journal::readField(std::istream& in, std::string& field) {
+    field.clear();
+    char c;
+    while (in.get(c)) {
+        if (c == '|') {
+            return true;
+        }
+        if (c == '\\' && in.get(c)) {
+            c = c == 'n' ? '\n' : c;
+        }
+        field += c;
+    }
+    // Поле без завершающего '|' - обрезанная запись
+    return false;
+}
+
+bool Journal::reset() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    drain(lock);
+    std::remove(archiveFilename().c_str());
+
+    if (fd_ >= 0) {
+        // O_APPEND: после усечения запись продолжится с начала файла
+        if (ftruncate(fd_, 0) != 0) {
+            std::cerr << "Error: Could not reset journal: " << filename_ << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    std::ofstream truncate(filename_, std::ios::binary | std::ios::trunc);
+    if (!truncate) {
+        std::cerr << "Error: Could not reset journal: " << filename_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Journal::rotate() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    drain(lock);
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+
+    std::string archive = archiveFilename();
+    if (access(archive.c_str(), F_OK) != 0) {
+        // Следующая запись создаст журнал заново
+        if (std::rename(filename_.c_str(), archive.c_str()) != 0) {
+            if (errno == ENOENT) return true;
+            std::cerr << "Error: Could not archive journal: " << filename_
+                      << " (" << strerror(errno) << ")" << std::endl;
+            return false;
+        }
+        if (!DurableFile::syncParentDirectory(filename_)) {
+            std::cerr << "Error: Could not sync journal directory: " << filename_ << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Прошлая контрольная точка не удалась: её архив ещё нужен. Записи
+    // дописываются к нему и сбрасываются на диск до усечения журнала -
+    // иначе сбой между ними потерял бы подтверждённые операции
+    std::string records;
+    {
+        std::ifstream src(filename_, std::ios::binary);
+        if (src) {
+            records.assign(std::istreambuf_iterator<char>(src), std::istreambuf_iterator<char>());
+            if (src.bad()) {
+                std::cerr << "Error: Could not read journal: " << filename_ << std::endl;
+                return false;
+            }
+        }
+    }
+    if (records.empty()) {
+        return true;
+    }
+
+    int archiveFd = open(archive.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (archiveFd < 0) {
+        std::cerr << "Error: Could not open journal archive: " << archive
+                  << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+    bool ok = true;
+    for (size_t written = 0; ok && written < records.size();) {
+        ssize_t n = write(archiveFd, records.data() + written, records.size() - written);
+        if (n < 0 && errno != EINTR) {
+            ok = false;
+        } else if (n > 0) {
+            written += n;
+        }
+    }
+    ok = ok && fdatasync(archiveFd) == 0;
+    ok = close(archiveFd) == 0 && ok;
+    if (!ok || !DurableFile::syncParentDirectory(archive)) {
+        std::cerr << "Error: Could not archive journal: " << filename_
+                  << " (" << strerror(errno) << ")" << std::endl;
+        return false;
+    }
+
+    // Усечение тоже закрепляется на диске; если оно не удалось, записи остаются
+    // в обоих файлах, и повтор при загрузке отсекается по LSN
+    int journalFd = open(filename_.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (journalFd < 0 || fdatasync(journalFd) != 0) {
+        std::cerr << "Error: Could not truncate journal: " << filename_
+                  << " (" << strerror(errno) << ")" << std::endl;
+        if (journalFd >= 0) close(journalFd);
+        return false;
+    }
+    if (close(journalFd) != 0) {
+        std::cerr << "Error: Could not truncate journal: " << filename_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Journal::dropArchive() {
+    std::remove(archiveFilename().c_str());
+}
@@ -0,0 +1,90 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <string>
+#include <istream>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+
+// Журнал операций (write-ahead log) рядом с файлом базы.
+// Каждая запись - одна зашифрованная строка с длиной и CRC32C впереди; файл
+// только дописывается и обнуляется после контрольной точки, когда база
+// сохранена целиком. При восстановлении запись с неверной суммой пропускается,
+// а оборванный сбоем хвост файла отрезается.
+// Фоновая контрольная точка вместо обнуления откладывает записи в архив
+// (<журнал>.checkpoint) и удаляет его, когда снимок лежит на диске.
+//
+// Запись выполняется групповой фиксацией: обработчики ставят записи в
+// очередь, отдельный поток сбрасывает накопившуюся группу одним write
+// и одним fdatasync, после чего отпускает всех её авторов.
+class Journal {
+public:
+    Journal(const std::string& filename, const std::string& key);
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Возвращает управление, когда запись надёжно лежит на диске
+    bool append(const std::string& record);
+    // append по частям: enqueue сразу занимает место записи в журнале и
+    // возвращает её номер (0 - журнал закрывается), wait ждёт сброса на диск.
+    // Так порядок записей задаётся под блокировкой вызывающего, а fdatasync
+    // ждут уже без неё
+    uint64_t enqueue(const std::string& record);
+    bool wait(uint64_t seq);
+    // Сначала записи архива, затем основного файла; хвост после последней
+    // целой записи отрезается
+    bool replay(const std::function<void(const std::string&)>& apply);
+    // Обнуляет журнал и удаляет архив
+    bool reset();
+    // Переносит записи в архив (дописывает, если архив остался от неудачной
+    // контрольной точки); новые записи идут в пустой журнал
+    bool rotate();
+    void dropArchive();
+
+    // Сколько записей добавлено с последней контрольной точки
+    size_t recordCount() const { return recordCount_; }
+    const std::string& filename() const { return filename_; }
+    std::string archiveFilename() const { return filename_ + ".checkpoint"; }
+
+    // Поле записи, завершённое '|'. Пользовательский текст экранируется
+    // ('\\', '\|', '\n'), поэтому '|' в описании не сдвигает следующие поля
+    static void appendField(std::string& record, const std::string& field);
+    // Читает поле до неэкранированного '|'; false, если полей больше нет
+    // или последнее поле не завершено
+    static bool readField(std::istream& in, std::string& field);
+
+private:
+    std::string filename_;
+    std::string key_;
+    int fd_;
+    std::atomic<size_t> recordCount_;
+
+    // Состояние групповой фиксации, защищено mutex_
+    std::mutex mutex_;
+    std::condition_variable pendingCV_;   // писатель ждёт новых записей
+    std::condition_variable durableCV_;   // авторы ждут сброса на диск
+    std::vector<std::string> pending_;
+    uint64_t enqueuedSeq_;
+    uint64_t durableSeq_;
+    std::vector<std::pair<uint64_t, uint64_t>> failedRanges_;
+    bool stopping_;
+    std::thread writer_;
+
+    bool openFile();
+    // Дожидается сброса очереди; вызывается под mutex_
+    void drain(std::unique_lock<std::mutex>& lock);
+    size_t replayFile(const std::string& filename, const std::function<void(const std::string&)>& apply);
+    bool writeGroup(const std::string& data);
+    void writerLoop();
+    bool isFailed(uint64_t seq) const;
+};
+
+#endif
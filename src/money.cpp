@@ -0,0 +1,158 @@
+#include "money.h"
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// Целая часть не длиннее 16 цифр: 10^16 * 100 заведомо помещается в int64
+const size_t kMaxUnitDigits = 16;
+
+inline bool isDigit(char c) {
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+}
+
+Money Money::fromUnits(int64_t units) {
+    int64_t cents;
+    if (__builtin_mul_overflow(units, kScale, &cents)) {
+        throw std::overflow_error("Money amount out of range");
+    }
+    return Money(cents);
+}
+
+Money Money::fromDouble(double value) {
+    double cents = std::round(value * kScale);
+    // 2^63 точно представимо в double; всё, что не меньше, в int64 не влезает
+    if (!std::isfinite(cents) || cents >= 9223372036854775808.0 || cents < -9223372036854775808.0) {
+        throw std::overflow_error("Money amount out of range");
+    }
+    return Money(static_cast<int64_t>(cents));
+}
+
+bool Money::parse(const char* text, size_t length, Money& result) {
+    size_t pos = 0;
+    bool negative = length > 0 && text[0] == '-';
+    pos += negative;
+
+    size_t unitsStart = pos;
+    int64_t units = 0;
+    while (pos < length && isDigit(text[pos])) {
+        units = units * 10 + (text[pos] - '0');
+        pos++;
+    }
+    size_t unitDigits = pos - unitsStart;
+    if (unitDigits == 0 || unitDigits > kMaxUnitDigits) {
+        return false;
+    }
+
+    // Дробная часть: одна или две цифры, "12." без цифр не принимается
+    int64_t fraction = 0;
+    if (pos < length && text[pos] == '.') {
+        pos++;
+        size_t fractionStart = pos;
+        while (pos < length && isDigit(text[pos]) && pos - fractionStart < 2) {
+            fraction = fraction * 10 + (text[pos] - '0');
+            pos++;
+        }
+        size_t fractionDigits = pos - fractionStart;
+        if (fractionDigits == 0) {
+            return false;
+        }
+        fraction *= fractionDigits == 1 ? 10 : 1;
+    }
+    if (pos != length) {
+        return false;
+    }
+
+    int64_t cents = units * kScale + fraction;
+    result = Money(negative ? -cents : cents);
+    return true;
+}
+
+Money Money::parse(const std::string& text) {
+    Money result;
+    if (!parse(text, result)) {
+        throw std::invalid_argument("Invalid money amount: " + text);
+    }
+    return result;
+}
+
+Money Money::parseLegacy(const std::string& text) {
+    Money result;
+    if (parse(text, result)) {
+        return result;
+    }
+    return fromDouble(std::stod(text));
+}
+
+void Money::appendTo(std::string& out) const {
+    // Модуль в uint64: у INT64_MIN нет положительной пары в int64
+    uint64_t magnitude = cents_ < 0 ? 0 - static_cast<uint64_t>(cents_) : static_cast<uint64_t>(cents_);
+
+    char buffer[24];
+    char* end = buffer + sizeof(buffer);
+    char* p = end;
+    *--p = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+    *--p = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+    *--p = '.';
+    do {
+        *--p = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (cents_ < 0) {
+        *--p = '-';
+    }
+    out.append(p, end - p);
+}
+
+std::string Money::toString() const {
+    std::string out;
+    appendTo(out);
+    return out;
+}
+
+bool Money::add(Money a, Money b, Money& result) {
+    int64_t cents;
+    if (__builtin_add_overflow(a.cents_, b.cents_, &cents)) {
+        return false;
+    }
+    result = Money(cents);
+    return true;
+}
+
+bool Money::subtract(Money a, Money b, Money& result) {
+    int64_t cents;
+    if (__builtin_sub_overflow(a.cents_, b.cents_, &cents)) {
+        return false;
+    }
+    result = Money(cents);
+    return true;
+}
+
+Money Money::operator+(Money other) const {
+    Money result;
+    if (!add(*this, other, result)) {
+        throw std::overflow_error("Money amount out of range");
+    }
+    return result;
+}
+
+Money Money::operator-(Money other) const {
+    Money result;
+    if (!subtract(*this, other, result)) {
+        throw std::overflow_error("Money amount out of range");
+    }
+    return result;
+}
+
+Money Money::operator-() const {
+    return Money() - *this;
+}
+
+std::ostream& operator<<(std::ostream& out, Money money) {
+    return out << money.toString();
+}
@@ -0,0 +1,66 @@
+#ifndef MONEY_H
+#define MONEY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <ostream>
+
+// Денежная сумма в минимальных единицах (копейках), 64-битное целое.
+// Сложение и вычитание точные; выход за пределы int64 - std::overflow_error.
+class Money {
+public:
+    static const int64_t kScale = 100;
+
+    constexpr Money() : cents_(0) {}
+
+    static constexpr Money fromCents(int64_t cents) { return Money(cents); }
+    static Money fromUnits(int64_t units);
+    // Суммы из старых форматов, где они хранились в double: округление до копейки
+    static Money fromDouble(double value);
+
+    // Строгий разбор "[-]123[.4[5]]": без экспоненты, пробелов и лишних знаков
+    static bool parse(const char* text, size_t length, Money& result);
+    static bool parse(const std::string& text, Money& result) {
+        return parse(text.data(), text.size(), result);
+    }
+    // Замена std::stod для команд: при ошибке std::invalid_argument
+    static Money parse(const std::string& text);
+    // Суммы, записанные старыми версиями через double ("1234.5600000000001", "1.5e+06")
+    static Money parseLegacy(const std::string& text);
+
+    int64_t cents() const { return cents_; }
+    double toDouble() const { return static_cast<double>(cents_) / kScale; }
+
+    // Всегда две цифры после точки: "1234.50", "-0.05"
+    std::string toString() const;
+    void appendTo(std::string& out) const;
+
+    // Проверенные операции без исключений: false при переполнении, result не меняется
+    static bool add(Money a, Money b, Money& result);
+    static bool subtract(Money a, Money b, Money& result);
+
+    Money operator+(Money other) const;
+    Money operator-(Money other) const;
+    Money operator-() const;
+    // Доля суммы (порог / 10 и т.п.), округление к нулю
+    Money operator/(int64_t divisor) const { return Money(cents_ / divisor); }
+    Money& operator+=(Money other) { return *this = *this + other; }
+    Money& operator-=(Money other) { return *this = *this - other; }
+
+    constexpr bool operator==(Money other) const { return cents_ == other.cents_; }
+    constexpr bool operator!=(Money other) const { return cents_ != other.cents_; }
+    constexpr bool operator<(Money other) const { return cents_ < other.cents_; }
+    constexpr bool operator<=(Money other) const { return cents_ <= other.cents_; }
+    constexpr bool operator>(Money other) const { return cents_ > other.cents_; }
+    constexpr bool operator>=(Money other) const { return cents_ >= other.cents_; }
+
+private:
+    explicit constexpr Money(int64_t cents) : cents_(cents) {}
+
+    int64_t cents_;
+};
+
+std::ostream& operator<<(std::ostream& out, Money money);
+
+#endif
@@ -0,0 +1,68 @@
+#include "protocol.h"
+
+std::string Protocol::frame(const std::string& payload) {
+    uint32_t length = static_cast<uint32_t>(payload.size());
+
+    std::string framed;
+    framed.reserve(kHeaderSize + payload.size());
+    framed += static_cast<char>((length >> 24) & 0xFF);
+    framed += static_cast<char>((length >> 16) & 0xFF);
+    framed += static_cast<char>((length >> 8) & 0xFF);
+    framed += static_cast<char>(length & 0xFF);
+    framed += payload;
+    return framed;
+}
+
+void MessageBuffer::append(const char* data, size_t length) {
+    buffer_.append(data, length);
+}
+
+bool MessageBuffer::nextLine(std::string& line) {
+    size_t end = buffer_.find('\n', offset_);
+    if (end == std::string::npos) {
+        if (size() > Protocol::kMaxCommandLength) {
+            overflow_ = true;
+        }
+        return false;
+    }
+
+    line.assign(buffer_, offset_, end - offset_);
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    consume(end - offset_ + 1);
+    return true;
+}
+
+bool MessageBuffer::nextFrame(std::string& payload) {
+    if (size() < Protocol::kHeaderSize) return false;
+
+    const unsigned char* header = reinterpret_cast<const unsigned char*>(buffer_.data() + offset_);
+    uint32_t length = (static_cast<uint32_t>(header[0]) << 24) |
+                      (static_cast<uint32_t>(header[1]) << 16) |
+                      (static_cast<uint32_t>(header[2]) << 8) |
+                      static_cast<uint32_t>(header[3]);
+
+    if (length > Protocol::kMaxFrameLength) {
+        overflow_ = true;
+        return false;
+    }
+    if (size() < Protocol::kHeaderSize + length) return false;
+
+    payload.assign(buffer_, offset_ + Protocol::kHeaderSize, length);
+    consume(Protocol::kHeaderSize + length);
+    return true;
+}
+
+void MessageBuffer::consume(size_t length) {
+    offset_ += length;
+    // Сдвигаем данные только когда прочитанная часть стала заметной,
+    // чтобы разбор пачки сообщений не был квадратичным
+    if (offset_ == buffer_.size()) {
+        buffer_.clear();
+        offset_ = 0;
+    } else if (offset_ > 4096 && offset_ * 2 > buffer_.size()) {
+        buffer_.erase(0, offset_);
+        offset_ = 0;
+    }
+}
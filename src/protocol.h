@@ -0,0 +1,40 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Формат обмена:
+//   клиент -> сервер: текстовые команды, каждая завершается '\n';
+//   сервер -> клиент: кадры "4 байта длины (big-endian) + текст ответа".
+class Protocol {
+public:
+    static const size_t kHeaderSize = 4;
+    static const size_t kMaxCommandLength = 64 * 1024;
+    static const size_t kMaxFrameLength = 64 * 1024 * 1024;
+
+    static std::string frame(const std::string& payload);
+};
+
+// Буфер сборки сообщений: копит байты из recv и отдаёт целые сообщения,
+// даже если они разбиты на несколько чтений или склеены в одно.
+class MessageBuffer {
+public:
+    void append(const char* data, size_t length);
+    bool nextLine(std::string& line);
+    bool nextFrame(std::string& payload);
+
+    // Незавершённое сообщение превысило допустимый размер
+    bool overflow() const { return overflow_; }
+    size_t size() const { return buffer_.size() - offset_; }
+
+private:
+    std::string buffer_;
+    size_t offset_ = 0;
+    bool overflow_ = false;
+
+    void consume(size_t length);
+};
+
+#endif
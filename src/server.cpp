@@ -1,5 +1,7 @@
 #include "server.h"
 #include "crypto.h"
+#include "id_generator.h"
+#include "durable_file.h"
 #include <iostream>
 #include <sstream>
 #include <vector>
@@ -8,13 +10,72 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <arpa/inet.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <cerrno>
 #include <chrono>
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+
+// Максимум событий, забираемых реактором за один вызов epoll_wait
+const int kMaxEpollEvents = 256;
+
+// Сколько команд конвейера выполняется одной задачей пула
+const size_t kMaxCommandBatch = 256;
+
+// Сколько ответов может накопиться до принудительной отправки
+const size_t kMaxCorkedBytes = 256 * 1024;
+
+// Простой соединения, после которого сервер его закрывает
+const std::chrono::milliseconds kIdleTimeout = std::chrono::minutes(30);
+
+// Срок решения по запросу, восстановленному после перезапуска: клиент его
+// уже не ждёт, сотруднику даётся больше времени, чем живому соединению
+const int kRecoveredApprovalTimeoutSeconds = 3600;
+
+// Как часто проверяется, не изменился ли файл правил автоодобрения
+const std::chrono::milliseconds kRulesReloadInterval = std::chrono::seconds(2);
+
+// Запрос на одобрение крупной операции; строки операции заполняет обработчик
+ApprovalRequest makeApprovalRequest(const std::string& clientAccountId, const std::string& operationType,
+                                    const std::string& sourceAccount, Money amount,
+                                    const std::string& targetAccount, const std::string& description) {
+    ApprovalRequest request;
+    request.clientAccountId = clientAccountId;
+    request.operationType = operationType;
+    request.sourceAccount = sourceAccount;
+    request.amount = amount;
+    request.targetAccount = targetAccount;
+    request.description = description;
+    return request;
+}
+
+size_t defaultWorkerCount() {
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 4 ? cores : 4;
+}
+
+void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) {
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+}
+
+}
 
 BankServer::BankServer(int port, const std::string& dbFilename) 
-    : port_(port), running_(false), database_(dbFilename) {
+    : port_(port), running_(false), database_(dbFilename), 
+      epollFd_(-1), workers_(defaultWorkerCount()), idleTimeout_(kIdleTimeout),
+      approvalJournal_(dbFilename + ".approvals", database_.getEncryptionKey()) {
+    
+    // Отметка времени id рядом с базой: после перезапуска id не повторятся,
+    // даже если часы перевели назад
+    IdGenerator::setStateFile(dbFilename + ".idclock");
     
     // Создаем директорию для данных если нужно
     std::filesystem::create_directories("data");
@@ -24,10 +85,15 @@ BankServer::BankServer(int port, const std::string& dbFilename)
     
     // Загружаем состояние сервера (очереди запросов)
     loadServerState();
+    
+    // Правила автоодобрения рядом с базой; изменения файла подхватываются на ходу
+    approvalRules_.load(dbFilename + ".rules");
+    scheduleRulesReload();
 }
 
 bool BankServer::start() {
     running_ = true;
+    workers_.start();
     serverThread_ = std::thread(&BankServer::run, this);
     std::cout << "Bank server started on port " << port_ << std::endl;
     return true;
@@ -42,6 +108,7 @@ void BankServer::stop() {
     if (serverThread_.joinable()) {
         serverThread_.join();
     }
+    workers_.stop();
     saveServerState();
 }
 
@@ -59,36 +126,39 @@ void BankServer::saveServerState() {
 void BankServer::loadServerState() {
     std::cout << "Loading server state..." << std::endl;
     loadQueuesFromFile();
+    recoverApprovals();
     std::cout << "Server state loaded successfully" << std::endl;
 }
 
 void BankServer::saveQueuesToFile() {
-    // Сохраняем очередь верификации
-    std::ofstream verificationFile("data/verification_queue.dat");
-    if (verificationFile) {
-        std::queue<ApprovalRequest> tempQueue = verificationQueue_;
-        while (!tempQueue.empty()) {
-            const auto& request = tempQueue.front();
-            verificationFile << request.requestId << "|"
-                           << request.clientAccountId << "|"
-                           << request.operationType << "|"
-                           << request.amount << "|"
-                           << request.targetAccount << "|"
-                           << request.description << "|"
-                           << request.timestamp << "|"
-                           << request.status << "\n";
-            tempQueue.pop();
-        }
+    // Сохраняем очередь верификации: файл заменяется целиком, с контрольными суммами
+    std::stringstream verificationFile;
+    for (const auto& request : verificationQueue_) {
+        verificationFile << request.requestId << "|"
+                       << request.clientAccountId << "|"
+                       << request.operationType << "|"
+                       << request.amount << "|"
+                       << request.targetAccount << "|"
+                       << request.description << "|"
+                       << request.timestamp << "|"
+                       << request.status << "\n";
+    }
+    
+    std::string data = verificationFile.str();
+    DurableFile::appendChecksums(data);
+    if (!DurableFile::write("data/verification_queue.dat", data)) {
+        std::cerr << "Error: Could not save verification queue" << std::endl;
     }
 }
 
 void BankServer::loadQueuesFromFile() {
     // Очищаем текущие очереди
-    while (!verificationQueue_.empty()) verificationQueue_.pop();
+    verificationQueue_.clear();
     
     // Загружаем очередь верификации
-    std::ifstream verificationFile("data/verification_queue.dat");
-    if (verificationFile) {
+    std::string data;
+    if (DurableFile::read("data/verification_queue.dat", data, DurableFile::isLegacyText)) {
+        std::stringstream verificationFile(data);
         std::string line;
         while (std::getline(verificationFile, line)) {
             if (line.empty()) continue;
@@ -106,10 +176,10 @@ void BankServer::loadQueuesFromFile() {
                 std::getline(ss, timestampStr, '|') &&
                 std::getline(ss, request.status, '|')) {
                 
-                try { request.amount = std::stod(amountStr); } catch (...) { request.amount = 0; }
+                try { request.amount = Money::parseLegacy(amountStr); } catch (...) { request.amount = Money(); }
                 try { request.timestamp = std::stol(timestampStr); } catch (...) { request.timestamp = std::time(nullptr); }
                 
-                verificationQueue_.push(request);
+                verificationQueue_.add(request);
             }
         }
         std::cout << "Loaded " << verificationQueue_.size() << " verification requests from disk." << std::endl;
@@ -119,18 +189,21 @@ void BankServer::loadQueuesFromFile() {
 void BankServer::cleanupVerificationQueue() {
     std::lock_guard<std::mutex> lock(approvalMutex_);
     
-    std::queue<ApprovalRequest> cleanedQueue;
-    while (!verificationQueue_.empty()) {
-        ApprovalRequest request = verificationQueue_.front();
-        verificationQueue_.pop();
-        
+    std::vector<std::string> stale;
+    for (const auto& request : verificationQueue_) {
         // Проверяем, существует ли клиент и нуждается ли он в верификации
         ClientData* client = database_.findClient(request.clientAccountId);
-        if (client && client->status == ClientStatus::PENDING_VERIFICATION) {
-            cleanedQueue.push(request);
+        if (client) {
+            Database::ClientLock clientLock = database_.lockClient(request.clientAccountId);
+            if (client->status == ClientStatus::PENDING_VERIFICATION) {
+                continue;
+            }
         }
+        stale.push_back(request.requestId);
+    }
+    for (const auto& requestId : stale) {
+        verificationQueue_.remove(requestId);
     }
-    verificationQueue_ = cleanedQueue;
 }
 
 void BankServer::run() {
@@ -154,47 +227,168 @@ void BankServer::run() {
         return;
     }
     
-    if (listen(serverSocket, 10) < 0) {
+    if (listen(serverSocket, SOMAXCONN) < 0) {
         std::cerr << "Error listening on socket" << std::endl;
         close(serverSocket);
         return;
     }
     
+    setNonBlocking(serverSocket);
+    
+    epollFd_ = epoll_create1(0);
+    if (epollFd_ < 0) {
+        std::cerr << "Error creating epoll instance" << std::endl;
+        close(serverSocket);
+        return;
+    }
+    
+    epoll_event listenEvent{};
+    listenEvent.events = EPOLLIN | EPOLLET;
+    listenEvent.data.fd = serverSocket;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, serverSocket, &listenEvent);
+    
     std::cout << "Server listening on port " << port_ << std::endl;
     
+    std::vector<epoll_event> events(kMaxEpollEvents);
+    
     while (running_) {
+        // Таймаут нужен, чтобы периодически проверять флаг running_
+        int ready = epoll_wait(epollFd_, events.data(), static_cast<int>(events.size()), 100);
+        timers_.advance(std::chrono::steady_clock::now());
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait failed: " << strerror(errno) << std::endl;
+            break;
+        }
+        
+        for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+            uint32_t flags = events[i].events;
+            
+            if (fd == serverSocket) {
+                acceptConnections(serverSocket);
+                continue;
+            }
+            
+            std::shared_ptr<Connection> conn = findConnection(fd);
+            if (!conn) continue;
+            
+            if (flags & EPOLLOUT) {
+                flushConnection(conn);
+            }
+            if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                readFromConnection(conn);
+            }
+        }
+    }
+    
+    // Ожидающие клиенты отпускаются; запросы ждут решения после перезапуска
+    releaseParkedApprovals();
+    
+    // Закрываем оставшиеся соединения
+    std::vector<std::shared_ptr<Connection>> remaining;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex_);
+        for (auto& pair : clients_) {
+            remaining.push_back(pair.second);
+        }
+    }
+    for (auto& conn : remaining) {
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            conn->closed = true;
+            if (conn->busy) continue; // закроет рабочий поток
+        }
+        closeConnection(conn);
+    }
+    
+    close(epollFd_);
+    epollFd_ = -1;
+    close(serverSocket);
+}
+
+void BankServer::acceptConnections(int serverSocket) {
+    // Edge-triggered: принимаем все ожидающие подключения за одно пробуждение
+    while (true) {
         sockaddr_in clientAddr{};
         socklen_t clientLen = sizeof(clientAddr);
         
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        FD_SET(serverSocket, &readfds);
+        int clientSocket = accept(serverSocket, (sockaddr*)&clientAddr, &clientLen);
+        if (clientSocket < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "accept failed: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+        
+        setNonBlocking(clientSocket);
         
-        timeval timeout{0, 100000};
+        auto conn = std::make_shared<Connection>();
+        conn->socket = clientSocket;
+        conn->session = ClientSession{"", nullptr, std::time(nullptr), false};
+        conn->lastActivity = std::chrono::steady_clock::now();
         
-        int activity = select(serverSocket + 1, &readfds, nullptr, nullptr, &timeout);
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            clients_[clientSocket] = conn;
+        }
         
-        if (activity > 0 && FD_ISSET(serverSocket, &readfds)) {
-            int clientSocket = accept(serverSocket, (sockaddr*)&clientAddr, &clientLen);
-            if (clientSocket >= 0) {
-                std::lock_guard<std::mutex> lock(clientsMutex_);
-                clients_[clientSocket] = ClientSession{"", nullptr, std::time(nullptr), false};
-                std::thread clientThread(&BankServer::handleClient, this, clientSocket);
-                clientThread.detach();
-                
-                char clientIP[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
-                std::cout << "New client connected from " << clientIP << std::endl;
-            }
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.fd = clientSocket;
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, clientSocket, &event) < 0) {
+            std::cerr << "epoll_ctl failed: " << strerror(errno) << std::endl;
+            conn->closed = true;
+            closeConnection(conn);
+            continue;
         }
+        
+        char clientIP[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
+        std::cout << "New client connected from " << clientIP << std::endl;
+        
+        sendWelcome(clientSocket);
+        scheduleIdleCheck(conn, idleTimeout_);
     }
-    
-    close(serverSocket);
 }
 
-void BankServer::handleClient(int clientSocket) {
-    char buffer[1024];
+void BankServer::scheduleIdleCheck(const std::shared_ptr<Connection>& conn, std::chrono::milliseconds delay) {
+    // Таймер не продлевает жизнь соединения
+    std::weak_ptr<Connection> weak = conn;
+    timers_.schedule(delay, [this, weak]() {
+        if (std::shared_ptr<Connection> conn = weak.lock()) {
+            checkIdle(conn);
+        }
+    });
+}
+
+void BankServer::checkIdle(const std::shared_ptr<Connection>& conn) {
+    // Таймер не переставляется на каждой команде: при срабатывании
+    // проверяем последнюю активность и при необходимости ждём остаток
+    auto idle = std::chrono::steady_clock::now() - conn->lastActivity;
+    if (idle < idleTimeout_) {
+        scheduleIdleCheck(conn, std::chrono::duration_cast<std::chrono::milliseconds>(idleTimeout_ - idle));
+        return;
+    }
     
+    std::lock_guard<std::mutex> lock(conn->mutex);
+    if (conn->released || conn->closed) {
+        return;
+    }
+    if (conn->busy) {
+        // Команда ещё выполняется или ждёт одобрения - не обрываем её
+        scheduleIdleCheck(conn, idleTimeout_);
+        return;
+    }
+    
+    conn->outBuffer += Protocol::frame("Session closed due to inactivity");
+    writeOutBuffer(*conn);
+    // Реактор увидит конец чтения и закроет соединение обычным путём
+    shutdown(conn->socket, SHUT_RD);
+}
+
+void BankServer::sendWelcome(int clientSocket) {
     sendResponse(clientSocket, 
         "Welcome to Secure Bank System!\n"
         "Available commands:\n"
@@ -203,45 +397,216 @@ void BankServer::handleClient(int clientSocket) {
         "LOGIN <account_id> <password> - login to existing account\n"
         "SUPERLOGIN <account_id> <password> - security officer login\n"
         "HELP - show all commands");
+}
+
+void BankServer::readFromConnection(const std::shared_ptr<Connection>& conn) {
+    char buffer[4096];
+    bool disconnected = false;
     
-    while (running_) {
-        memset(buffer, 0, sizeof(buffer));
-        int bytesRead = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-        
-        if (bytesRead <= 0) {
-            break;
+    conn->lastActivity = std::chrono::steady_clock::now();
+    
+    // Edge-triggered: читаем до EAGAIN, иначе событие больше не придёт
+    while (true) {
+        ssize_t bytesRead = recv(conn->socket, buffer, sizeof(buffer), 0);
+        if (bytesRead > 0) {
+            conn->inBuffer.append(buffer, bytesRead);
+            continue;
         }
-        
-        std::string command(buffer);
-        command.erase(command.find_last_not_of(" \n\r\t") + 1);
-        
-        ClientSession* session = nullptr;
-        {
-            std::lock_guard<std::mutex> lock(clientsMutex_);
-            auto it = clients_.find(clientSocket);
-            if (it != clients_.end()) {
-                session = &it->second;
-            }
+        if (bytesRead < 0 && errno == EINTR) continue;
+        if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        disconnected = true;
+        break;
+    }
+    
+    // Команды разделены '\n': одно чтение может содержать часть команды или несколько
+    std::vector<std::string> commands;
+    std::string command;
+    while (conn->inBuffer.nextLine(command)) {
+        command.erase(command.find_last_not_of(" \r\t") + 1);
+        commands.push_back(std::move(command));
+    }
+    
+    if (conn->inBuffer.overflow()) {
+        sendResponse(conn->socket, "ERROR: Command too long");
+        disconnected = true;
+    }
+    
+    bool closeNow = false;
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        for (auto& cmd : commands) {
+            conn->pendingCommands.push_back(std::move(cmd));
         }
-        
-        if (session) {
-            processCommand(clientSocket, *session, command);
+        if (disconnected) {
+            conn->closed = true;
+            closeNow = !conn->busy;
         }
     }
     
+    if (closeNow) {
+        closeConnection(conn);
+    } else {
+        scheduleConnection(conn);
+    }
+}
+
+void BankServer::flushConnection(const std::shared_ptr<Connection>& conn) {
+    std::lock_guard<std::mutex> lock(conn->mutex);
+    writeOutBuffer(*conn);
+}
+
+void BankServer::writeOutBuffer(Connection& conn) {
+    // Вызывается под conn.mutex
+    while (!conn.outBuffer.empty()) {
+        ssize_t sent = send(conn.socket, conn.outBuffer.data(), conn.outBuffer.size(), MSG_NOSIGNAL);
+        if (sent > 0) {
+            conn.outBuffer.erase(0, sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        // Клиент ушёл - остаток ответа больше не нужен
+        conn.outBuffer.clear();
+        break;
+    }
+}
+
+void BankServer::scheduleConnection(const std::shared_ptr<Connection>& conn) {
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        // Команды одного соединения выполняются строго по очереди
+        if (conn->busy || conn->closed || conn->pendingCommands.empty()) {
+            return;
+        }
+        conn->busy = true;
+    }
+    
+    if (!workers_.submit([this, conn]() { serviceConnection(conn); })) {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        conn->busy = false;
+    }
+}
+
+void BankServer::serviceConnection(const std::shared_ptr<Connection>& conn) {
+    // Забираем все накопившиеся команды разом: конвейер клиента
+    // обрабатывается одной задачей, а ответы уходят одной записью
+    std::vector<std::string> batch;
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        size_t count = std::min(conn->pendingCommands.size(), kMaxCommandBatch);
+        for (size_t i = 0; i < count; i++) {
+            batch.push_back(std::move(conn->pendingCommands.front()));
+            conn->pendingCommands.pop_front();
+        }
+        conn->corked = true;
+    }
+    
+    for (size_t i = 0; i < batch.size(); i++) {
+        processCommand(conn->socket, conn->session, batch[i]);
+        if (yieldIfParked(conn, batch, i + 1)) {
+            return;
+        }
+    }
+    
+    finishService(conn);
+}
+
+void BankServer::finishService(const std::shared_ptr<Connection>& conn) {
+    bool closeNow = false;
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        conn->corked = false;
+        writeOutBuffer(*conn);
+        conn->busy = false;
+        closeNow = conn->closed;
+    }
+    
+    if (closeNow) {
+        closeConnection(conn);
+    } else {
+        // Остаток конвейера идёт отдельной задачей, чтобы не задерживать другие соединения
+        scheduleConnection(conn);
+    }
+}
+
+bool BankServer::yieldIfParked(const std::shared_ptr<Connection>& conn, std::vector<std::string>& batch, size_t next) {
+    bool resumeNow;
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        if (!conn->parkedOperation) {
+            return false;
+        }
+        // Следующие команды клиента ждут отложенную операцию: порядок ответов сохраняется
+        for (size_t i = batch.size(); i > next; i--) {
+            conn->pendingCommands.push_front(std::move(batch[i - 1]));
+        }
+        conn->corked = false;
+        writeOutBuffer(*conn);
+        
+        // Решение могло прийти, пока команда ещё выполнялась; тогда продолжаем сразу.
+        // Иначе продолжит тот, кто примет решение - busy остаётся выставленным
+        resumeNow = conn->decided;
+        conn->parked = !resumeNow;
+    }
+    
+    if (resumeNow && (!running_ || !workers_.submit([this, conn]() { resumeConnection(conn); }))) {
+        resumeConnection(conn);
+    }
+    return true;
+}
+
+void BankServer::resumeConnection(const std::shared_ptr<Connection>& conn) {
+    std::function<void(bool)> operation;
+    bool approved;
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        operation = std::move(conn->parkedOperation);
+        conn->parkedOperation = nullptr;
+        approved = conn->approved;
+        conn->decided = false;
+        conn->corked = true;
+    }
+    
+    try {
+        operation(approved);
+    } catch (const std::exception& e) {
+        sendResponse(conn->socket, "ERROR: Operation failed");
+    }
+    
+    std::vector<std::string> noCommands;
+    if (!yieldIfParked(conn, noCommands, 0)) {
+        finishService(conn);
+    }
+}
+
+void BankServer::closeConnection(const std::shared_ptr<Connection>& conn) {
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        if (conn->released) return;
+        conn->released = true;
+    }
+    
     {
         std::lock_guard<std::mutex> lock(clientsMutex_);
-        if (clients_.find(clientSocket) != clients_.end()) {
-            if (isSuperUser(clients_[clientSocket].accountId)) {
-                superUsers_.erase(clients_[clientSocket].accountId);
-            }
+        if (isSuperUser(conn->session.accountId)) {
+            superUsers_.erase(conn->session.accountId);
         }
-        clients_.erase(clientSocket);
+        clients_.erase(conn->socket);
     }
-    close(clientSocket);
+    
+    if (epollFd_ >= 0) {
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, conn->socket, nullptr);
+    }
+    close(conn->socket);
     std::cout << "Client disconnected" << std::endl;
 }
 
+std::shared_ptr<Connection> BankServer::findConnection(int clientSocket) {
+    std::lock_guard<std::mutex> lock(clientsMutex_);
+    auto it = clients_.find(clientSocket);
+    return it != clients_.end() ? it->second : nullptr;
+}
+
 void BankServer::processCommand(int clientSocket, ClientSession& session, const std::string& command) {
     std::vector<std::string> args;
     std::string currentArg;
@@ -297,8 +662,9 @@ void BankServer::processCommand(int clientSocket, ClientSession& session, const
                        "DEPOSIT_TO <account_index> <amount> [description] - deposit to specific account\n"
                        "WITHDRAW <amount> [description] - withdraw from first account\n"
                        "WITHDRAW_FROM <account_index> <amount> [description] - withdraw from specific account\n"
-                       "TRANSFER <target_accountID> <amount> [description] - transfer from first account\n"
-                       "TRANSFER_FROM <account_index> <target_accountID> <amount> [description]\n"
+                       "TRANSFER <target_accountID|account_number> <amount> [description] - transfer from first account\n"
+                       "TRANSFER_FROM <account_index> <target_accountID|account_number> <amount> [description]\n"
+                       "BATCH_TRANSFER <account_index> <ATOMIC|EACH> <target> <amount> <description> [...] - batch transfer\n"
                        "HISTORY [account_index] - show transaction history\n"
                        "CREATE_ACCOUNT <type> - create new account (0=Savings, 1=Checking, 2=Credit, 3=Deposit)\n"
                        "INFO - show client information\n";
@@ -307,9 +673,9 @@ void BankServer::processCommand(int clientSocket, ClientSession& session, const
                 helpText += "SECURITY OFFICER COMMANDS:\n"
                            "PENDING_REQUESTS - show pending operation requests\n"
                            "PENDING_VERIFICATIONS - show pending verification requests\n"
-                           "APPROVE <request_index> - approve operation\n"
-                           "REJECT <request_index> - reject operation\n"
-                           "VERIFY <client_index> - verify client account\n"
+                           "APPROVE <request_id|request_index> - approve operation\n"
+                           "REJECT <request_id|request_index> - reject operation\n"
+                           "VERIFY <request_id|client_index> - verify client account\n"
                            "SET_RATES <credit_rate> <deposit_rate> - set interest rates\n"
                            "SETTINGS - show current bank settings\n";
             }
@@ -367,6 +733,8 @@ void BankServer::processCommand(int clientSocket, ClientSession& session, const
         handleTransfer(clientSocket, session, args);
     } else if (cmd == "TRANSFER_FROM") {
         handleTransferFromAccount(clientSocket, session, args);
+    } else if (cmd == "BATCH_TRANSFER") {
+        handleBatchTransfer(clientSocket, session, args);
     } else if (cmd == "HISTORY") {
         handleHistory(clientSocket, session, args);
     } else if (cmd == "ACCOUNTS") {
@@ -393,6 +761,7 @@ void BankServer::processCommand(int clientSocket, ClientSession& session, const
         session.isAuthenticated = false;
         session.clientData = nullptr;
         if (isSuperUser(session.accountId)) {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
             superUsers_.erase(session.accountId);
         }
         sendResponse(clientSocket, "Logged out successfully");
@@ -402,7 +771,17 @@ void BankServer::processCommand(int clientSocket, ClientSession& session, const
 }
 
 void BankServer::sendResponse(int clientSocket, const std::string& response) {
-    send(clientSocket, response.c_str(), response.length(), 0);
+    std::shared_ptr<Connection> conn = findConnection(clientSocket);
+    if (!conn) return;
+    
+    std::lock_guard<std::mutex> lock(conn->mutex);
+    conn->outBuffer += Protocol::frame(response);
+    
+    // Внутри пачки команд ответы копятся и уходят одной записью;
+    // что не влезло в сокет, допишет реактор по EPOLLOUT
+    if (!conn->corked || conn->outBuffer.size() >= kMaxCorkedBytes) {
+        writeOutBuffer(*conn);
+    }
 }
 
 void BankServer::handleRatesInfo(int clientSocket) {
@@ -426,7 +805,7 @@ void BankServer::handleRegister(int clientSocket, const std::vector<std::string>
         std::lock_guard<std::mutex> lock(clientsMutex_);
         auto it = clients_.find(clientSocket);
         if (it != clients_.end()) {
-            session = &it->second;
+            session = &it->second->session;
         }
     }
     
@@ -508,11 +887,11 @@ void BankServer::handleRegister(int clientSocket, const std::vector<std::string>
         return;
     }
     
-    // Генерация accountId
-    std::string accountId;
-    do {
-        accountId = "ACC" + std::to_string(1000 + (rand() % 9000));
-    } while (database_.findClient(accountId) != nullptr);
+    std::string accountId = database_.allocateAccountId();
+    if (accountId.empty()) {
+        sendResponse(clientSocket, "ERROR: Registration failed - no account IDs left");
+        return;
+    }
     
     ClientData newClient;
     newClient.accountId = accountId;
@@ -523,9 +902,6 @@ void BankServer::handleRegister(int clientSocket, const std::vector<std::string>
     newClient.status = ClientStatus::PENDING_VERIFICATION;
     
     if (database_.addClient(newClient)) {
-        // Сохраняем базу данных
-        saveDatabase();
-        
         // Создаем запрос на верификацию
         std::string requestId = createVerificationRequest(accountId, fullName);
         
@@ -552,12 +928,10 @@ std::string BankServer::createVerificationRequest(const std::string& clientAccou
     std::lock_guard<std::mutex> lock(approvalMutex_);
     
     // Проверяем, нет ли уже запроса на верификацию для этого клиента
-    std::queue<ApprovalRequest> tempQueue = verificationQueue_;
-    while (!tempQueue.empty()) {
-        if (tempQueue.front().clientAccountId == clientAccountId) {
-            return tempQueue.front().requestId; // Запрос уже существует
+    for (const auto& request : verificationQueue_) {
+        if (request.clientAccountId == clientAccountId) {
+            return request.requestId; // Запрос уже существует
         }
-        tempQueue.pop();
     }
     
     // Находим клиента для получения полной информации
@@ -567,13 +941,14 @@ std::string BankServer::createVerificationRequest(const std::string& clientAccou
     request.requestId = generateRequestId();
     request.clientAccountId = clientAccountId;
     request.operationType = "VERIFICATION";
-    request.amount = 0;
+    request.amount = Money();
     request.targetAccount = "";
     
     // Формируем описание
     std::stringstream desc;
     desc << "Name: " << clientName;
     if (client) {
+        Database::ClientLock clientLock = database_.lockClient(clientAccountId);
         desc << " | Birth: " << client->birthDate << " | Passport: " << client->passportData;
     }
     request.description = desc.str();
@@ -581,7 +956,7 @@ std::string BankServer::createVerificationRequest(const std::string& clientAccou
     request.timestamp = std::time(nullptr);
     request.status = "PENDING";
     
-    verificationQueue_.push(request);
+    verificationQueue_.add(request);
     
     // Сохраняем очередь
     saveQueuesToFile();
@@ -599,7 +974,7 @@ void BankServer::handleLogin(int clientSocket, const std::vector<std::string>& a
         std::lock_guard<std::mutex> lock(clientsMutex_);
         auto it = clients_.find(clientSocket);
         if (it != clients_.end()) {
-            session = &it->second;
+            session = &it->second->session;
         }
     }
     
@@ -614,15 +989,23 @@ void BankServer::handleLogin(int clientSocket, const std::vector<std::string>& a
         return;
     }
     
+    // Контрольная цифра ловит опечатку до проверки пароля
+    if (AccountIdAllocator::isMistyped(args[0])) {
+        sendResponse(clientSocket, "ERROR: Invalid account ID - please check the number");
+        return;
+    }
+    
     ClientData* client = database_.authenticateClient(args[0], args[1]);
     if (client) {
-        std::lock_guard<std::mutex> lock(clientsMutex_);
-        auto it = clients_.find(clientSocket);
-        if (it != clients_.end()) {
-            it->second.accountId = args[0];
-            it->second.clientData = client;
-            it->second.isAuthenticated = true;
-            it->second.loginTime = std::time(nullptr);
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            auto it = clients_.find(clientSocket);
+            if (it != clients_.end()) {
+                it->second->session.accountId = args[0];
+                it->second->session.clientData = client;
+                it->second->session.isAuthenticated = true;
+                it->second->session.loginTime = std::time(nullptr);
+            }
         }
         
         std::stringstream response;
@@ -650,7 +1033,7 @@ void BankServer::handleSuperLogin(int clientSocket, const std::vector<std::strin
         std::lock_guard<std::mutex> lock(clientsMutex_);
         auto it = clients_.find(clientSocket);
         if (it != clients_.end()) {
-            session = &it->second;
+            session = &it->second->session;
         }
     }
     
@@ -667,17 +1050,18 @@ void BankServer::handleSuperLogin(int clientSocket, const std::vector<std::strin
     
     ClientData* client = database_.authenticateClient(args[0], args[1]);
     if (client && isSuperUser(args[0])) {
-        std::lock_guard<std::mutex> lock(clientsMutex_);
-        auto it = clients_.find(clientSocket);
-        if (it != clients_.end()) {
-            it->second.accountId = args[0];
-            it->second.clientData = client;
-            it->second.isAuthenticated = true;
-            it->second.loginTime = std::time(nullptr);
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            auto it = clients_.find(clientSocket);
+            if (it != clients_.end()) {
+                it->second->session.accountId = args[0];
+                it->second->session.clientData = client;
+                it->second->session.isAuthenticated = true;
+                it->second->session.loginTime = std::time(nullptr);
+                superUsers_[args[0]] = it->second->session;
+            }
         }
         
-        superUsers_[args[0]] = it->second;
-        
         sendResponse(clientSocket, "SUCCESS: Security officer login successful");
         std::cout << "Security officer logged in: " << args[0] << std::endl;
     } else {
@@ -690,22 +1074,39 @@ bool BankServer::isSuperUser(const std::string& accountId) {
 }
 
 bool BankServer::isClientVerified(ClientSession& session) {
-    return session.clientData && session.clientData->status == ClientStatus::VERIFIED;
+    if (!session.clientData) return false;
+    
+    Database::ClientLock lock = database_.lockClient(session.accountId);
+    return session.clientData->status == ClientStatus::VERIFIED;
 }
 
-bool BankServer::canPerformOperation(ClientSession& session, const std::string& operationType, double amount) {
+bool BankServer::findTransferTarget(const std::string& target, std::string& accountNumber) {
+    // Идентификатор клиента - перевод на его первый счёт
+    if (database_.getAccountNumber(target, 0, accountNumber)) {
+        return true;
+    }
+    
+    // Иначе это номер конкретного счёта
+    if (database_.findAccount(target)) {
+        accountNumber = target;
+        return true;
+    }
+    return false;
+}
+
+bool BankServer::canPerformOperation(ClientSession& session, const std::string& operationType, Money amount) {
     if (!session.clientData) return false;
     
     BankSettings settings = database_.getSettings();
     
     // Неверифицированные пользователи ограничены
-    if (session.clientData->status != ClientStatus::VERIFIED) {
+    if (!isClientVerified(session)) {
         if (operationType == "CREATE_ACCOUNT") {
             return true;
         }
         else if (operationType == "TRANSFER" || operationType == "WITHDRAW") {
             // Лимит для неверифицированных
-            double unverifiedLimit = settings.largeOperationThreshold / 10;
+            Money unverifiedLimit = settings.largeOperationThreshold / 10;
             if (amount > unverifiedLimit) {
                 return false;
             }
@@ -725,10 +1126,11 @@ void BankServer::handleDeposit(int clientSocket, ClientSession& session, const s
     }
     
     try {
-        double amount = std::stod(args[0]);
+        Money amount = Money::parse(args[0]);
         std::string description = args.size() > 1 ? args[1] : "";
         
-        if (session.clientData->accounts.empty()) {
+        std::string accountNumber;
+        if (!database_.getAccountNumber(session.accountId, 0, accountNumber)) {
             sendResponse(clientSocket, "ERROR: No accounts available");
             return;
         }
@@ -738,8 +1140,7 @@ void BankServer::handleDeposit(int clientSocket, ClientSession& session, const s
             return;
         }
         
-        if (session.clientData->accounts[0].deposit(amount, description)) {
-            database_.saveToFile();
+        if (database_.deposit(accountNumber, amount, description)) {
             sendResponse(clientSocket, "DEPOSIT successful");
         } else {
             sendResponse(clientSocket, "ERROR: Deposit failed");
@@ -757,10 +1158,11 @@ void BankServer::handleDepositToAccount(int clientSocket, ClientSession& session
     
     try {
         int accountIndex = std::stoi(args[0]);
-        double amount = std::stod(args[1]);
+        Money amount = Money::parse(args[1]);
         std::string description = args.size() > 2 ? args[2] : "";
         
-        if (accountIndex < 0 || accountIndex >= static_cast<int>(session.clientData->accounts.size())) {
+        std::string accountNumber;
+        if (accountIndex < 0 || !database_.getAccountNumber(session.accountId, accountIndex, accountNumber)) {
             sendResponse(clientSocket, "ERROR: Invalid account index");
             return;
         }
@@ -770,10 +1172,8 @@ void BankServer::handleDepositToAccount(int clientSocket, ClientSession& session
             return;
         }
         
-        if (session.clientData->accounts[accountIndex].deposit(amount, description)) {
-            database_.saveToFile();
-            sendResponse(clientSocket, "DEPOSIT successful to account " + 
-                        session.clientData->accounts[accountIndex].getNumber());
+        if (database_.deposit(accountNumber, amount, description)) {
+            sendResponse(clientSocket, "DEPOSIT successful to account " + accountNumber);
         } else {
             sendResponse(clientSocket, "ERROR: Deposit failed");
         }
@@ -789,11 +1189,12 @@ void BankServer::handleWithdraw(int clientSocket, ClientSession& session, const
     }
     
     try {
-        double amount = std::stod(args[0]);
+        Money amount = Money::parse(args[0]);
         std::string description = args.size() > 1 ? args[1] : "";
         BankSettings settings = database_.getSettings();
         
-        if (session.clientData->accounts.empty()) {
+        std::string accountNumber;
+        if (!database_.getAccountNumber(session.accountId, 0, accountNumber)) {
             sendResponse(clientSocket, "ERROR: No accounts available");
             return;
         }
@@ -803,28 +1204,31 @@ void BankServer::handleWithdraw(int clientSocket, ClientSession& session, const
             return;
         }
         
-        // Проверка на крупную операцию для верифицированных пользователей
+        // Сама операция; крупную у верифицированного клиента выполнит решение сотрудника
+        auto execute = [this, clientSocket, accountNumber, amount, description]() {
+            if (database_.withdraw(accountNumber, amount, description)) {
+                sendResponse(clientSocket, "WITHDRAW successful");
+            } else {
+                sendResponse(clientSocket, "ERROR: Withdrawal failed - insufficient funds");
+            }
+        };
+        
         if (isClientVerified(session) && amount > settings.largeOperationThreshold) {
+            ApprovalRequest request = makeApprovalRequest(session.accountId, "WITHDRAW", accountNumber,
+                                                          amount, "", description);
+            request.items.push_back(TransferItem{"", amount, description});
+            // Низкорисковую операцию одобряют правила, без сотрудника
+            if (autoApprove(request, 0)) {
+                execute();
+                return;
+            }
             sendResponse(clientSocket, 
                 "NOTICE: Large withdrawal requires security approval.\n"
                 "Request sent to security department. Please wait...");
-            
-            std::string requestId = createApprovalRequest(
-                session.accountId, "WITHDRAW", amount, "", description
-            );
-            
-            if (!waitForApproval(requestId, 30)) {
-                sendResponse(clientSocket, "ERROR: Operation rejected by security or timeout exceeded");
-                return;
-            }
-        }
-        
-        if (session.clientData->accounts[0].withdraw(amount, description)) {
-            database_.saveToFile();
-            sendResponse(clientSocket, "WITHDRAW successful");
-        } else {
-            sendResponse(clientSocket, "ERROR: Withdrawal failed - insufficient funds");
+            requestApproval(clientSocket, request, execute);
+            return;
         }
+        execute();
     } catch (const std::exception& e) {
         sendResponse(clientSocket, "ERROR: Invalid amount");
     }
@@ -838,11 +1242,12 @@ void BankServer::handleWithdrawFromAccount(int clientSocket, ClientSession& sess
     
     try {
         int accountIndex = std::stoi(args[0]);
-        double amount = std::stod(args[1]);
+        Money amount = Money::parse(args[1]);
         std::string description = args.size() > 2 ? args[2] : "";
         BankSettings settings = database_.getSettings();
         
-        if (accountIndex < 0 || accountIndex >= static_cast<int>(session.clientData->accounts.size())) {
+        std::string accountNumber;
+        if (accountIndex < 0 || !database_.getAccountNumber(session.accountId, accountIndex, accountNumber)) {
             sendResponse(clientSocket, "ERROR: Invalid account index");
             return;
         }
@@ -852,29 +1257,31 @@ void BankServer::handleWithdrawFromAccount(int clientSocket, ClientSession& sess
             return;
         }
         
-        // Проверка на крупную операцию для верифицированных пользователей
+        // Сама операция; крупную у верифицированного клиента выполнит решение сотрудника
+        auto execute = [this, clientSocket, accountNumber, amount, description]() {
+            if (database_.withdraw(accountNumber, amount, description)) {
+                sendResponse(clientSocket, "WITHDRAW successful from account " + accountNumber);
+            } else {
+                sendResponse(clientSocket, "ERROR: Withdrawal failed - insufficient funds");
+            }
+        };
+        
         if (isClientVerified(session) && amount > settings.largeOperationThreshold) {
+            ApprovalRequest request = makeApprovalRequest(session.accountId, "WITHDRAW", accountNumber,
+                                                          amount, "", description);
+            request.items.push_back(TransferItem{"", amount, description});
+            // Низкорисковую операцию одобряют правила, без сотрудника
+            if (autoApprove(request, accountIndex)) {
+                execute();
+                return;
+            }
             sendResponse(clientSocket, 
                 "NOTICE: Large withdrawal requires security approval.\n"
                 "Request sent to security department. Please wait...");
-            
-            std::string requestId = createApprovalRequest(
-                session.accountId, "WITHDRAW", amount, "", description
-            );
-            
-            if (!waitForApproval(requestId, 30)) {
-                sendResponse(clientSocket, "ERROR: Operation rejected by security or timeout exceeded");
-                return;
-            }
-        }
-        
-        if (session.clientData->accounts[accountIndex].withdraw(amount, description)) {
-            database_.saveToFile();
-            sendResponse(clientSocket, "WITHDRAW successful from account " + 
-                        session.clientData->accounts[accountIndex].getNumber());
-        } else {
-            sendResponse(clientSocket, "ERROR: Withdrawal failed - insufficient funds");
+            requestApproval(clientSocket, request, execute);
+            return;
         }
+        execute();
     } catch (const std::exception& e) {
         sendResponse(clientSocket, "ERROR: Invalid amount or account index");
     }
@@ -882,17 +1289,18 @@ void BankServer::handleWithdrawFromAccount(int clientSocket, ClientSession& sess
 
 void BankServer::handleTransfer(int clientSocket, ClientSession& session, const std::vector<std::string>& args) {
     if (args.size() < 2) {
-        sendResponse(clientSocket, "ERROR: Usage: TRANSFER <target_accountID> <amount> [description]");
+        sendResponse(clientSocket, "ERROR: Usage: TRANSFER <target_accountID|account_number> <amount> [description]");
         return;
     }
     
     try {
         std::string targetAccount = args[0];
-        double amount = std::stod(args[1]);
+        Money amount = Money::parse(args[1]);
         std::string description = args.size() > 2 ? args[2] : "";
         BankSettings settings = database_.getSettings();
         
-        if (session.clientData->accounts.empty()) {
+        std::string accountNumber;
+        if (!database_.getAccountNumber(session.accountId, 0, accountNumber)) {
             sendResponse(clientSocket, "ERROR: No accounts available");
             return;
         }
@@ -902,34 +1310,37 @@ void BankServer::handleTransfer(int clientSocket, ClientSession& session, const
             return;
         }
         
-        ClientData* targetClient = database_.findClient(targetAccount);
-        if (!targetClient || targetClient->accounts.empty()) {
+        std::string targetNumber;
+        if (!findTransferTarget(targetAccount, targetNumber)) {
             sendResponse(clientSocket, "ERROR: Target account not found");
             return;
         }
         
-        // Проверка на крупную операцию для верифицированных пользователей
+        // Сама операция; крупную у верифицированного клиента выполнит решение сотрудника
+        auto execute = [this, clientSocket, accountNumber, targetNumber, amount, description]() {
+            if (database_.transfer(accountNumber, targetNumber, amount, description)) {
+                sendResponse(clientSocket, "TRANSFER successful");
+            } else {
+                sendResponse(clientSocket, "ERROR: Transfer failed - insufficient funds");
+            }
+        };
+        
         if (isClientVerified(session) && amount > settings.largeOperationThreshold) {
+            ApprovalRequest request = makeApprovalRequest(session.accountId, "TRANSFER", accountNumber,
+                                                          amount, targetAccount, description);
+            request.items.push_back(TransferItem{targetNumber, amount, description});
+            // Низкорисковую операцию одобряют правила, без сотрудника
+            if (autoApprove(request, 0)) {
+                execute();
+                return;
+            }
             sendResponse(clientSocket, 
                 "NOTICE: Large transfer requires security approval.\n"
                 "Request sent to security department. Please wait...");
-            
-            std::string requestId = createApprovalRequest(
-                session.accountId, "TRANSFER", amount, targetAccount, description
-            );
-            
-            if (!waitForApproval(requestId, 30)) {
-                sendResponse(clientSocket, "ERROR: Operation rejected by security or timeout exceeded");
-                return;
-            }
-        }
-        
-        if (session.clientData->accounts[0].transfer(targetClient->accounts[0], amount, description)) {
-            database_.saveToFile();
-            sendResponse(clientSocket, "TRANSFER successful");
-        } else {
-            sendResponse(clientSocket, "ERROR: Transfer failed - insufficient funds");
+            requestApproval(clientSocket, request, execute);
+            return;
         }
+        execute();
     } catch (const std::exception& e) {
         sendResponse(clientSocket, "ERROR: Invalid amount");
     }
@@ -937,18 +1348,19 @@ void BankServer::handleTransfer(int clientSocket, ClientSession& session, const
 
 void BankServer::handleTransferFromAccount(int clientSocket, ClientSession& session, const std::vector<std::string>& args) {
     if (args.size() < 3) {
-        sendResponse(clientSocket, "ERROR: Usage: TRANSFER_FROM <account_index> <target_accountID> <amount> [description]");
+        sendResponse(clientSocket, "ERROR: Usage: TRANSFER_FROM <account_index> <target_accountID|account_number> <amount> [description]");
         return;
     }
     
     try {
         int accountIndex = std::stoi(args[0]);
         std::string targetAccount = args[1];
-        double amount = std::stod(args[2]);
+        Money amount = Money::parse(args[2]);
         std::string description = args.size() > 3 ? args[3] : "";
         BankSettings settings = database_.getSettings();
         
-        if (accountIndex < 0 || accountIndex >= static_cast<int>(session.clientData->accounts.size())) {
+        std::string accountNumber;
+        if (accountIndex < 0 || !database_.getAccountNumber(session.accountId, accountIndex, accountNumber)) {
             sendResponse(clientSocket, "ERROR: Invalid account index");
             return;
         }
@@ -958,35 +1370,128 @@ void BankServer::handleTransferFromAccount(int clientSocket, ClientSession& sess
             return;
         }
         
-        ClientData* targetClient = database_.findClient(targetAccount);
-        if (!targetClient || targetClient->accounts.empty()) {
+        std::string targetNumber;
+        if (!findTransferTarget(targetAccount, targetNumber)) {
             sendResponse(clientSocket, "ERROR: Target account not found");
             return;
         }
         
-        // Проверка на крупную операцию для верифицированных пользователей
+        // Сама операция; крупную у верифицированного клиента выполнит решение сотрудника
+        auto execute = [this, clientSocket, accountNumber, targetNumber, amount, description]() {
+            if (database_.transfer(accountNumber, targetNumber, amount, description)) {
+                sendResponse(clientSocket, "TRANSFER successful from account " + accountNumber);
+            } else {
+                sendResponse(clientSocket, "ERROR: Transfer failed - insufficient funds");
+            }
+        };
+        
         if (isClientVerified(session) && amount > settings.largeOperationThreshold) {
+            ApprovalRequest request = makeApprovalRequest(session.accountId, "TRANSFER", accountNumber,
+                                                          amount, targetAccount, description);
+            request.items.push_back(TransferItem{targetNumber, amount, description});
+            // Низкорисковую операцию одобряют правила, без сотрудника
+            if (autoApprove(request, accountIndex)) {
+                execute();
+                return;
+            }
             sendResponse(clientSocket, 
                 "NOTICE: Large transfer requires security approval.\n"
                 "Request sent to security department. Please wait...");
-            
-            std::string requestId = createApprovalRequest(
-                session.accountId, "TRANSFER", amount, targetAccount, description
-            );
-            
-            if (!waitForApproval(requestId, 30)) {
-                sendResponse(clientSocket, "ERROR: Operation rejected by security or timeout exceeded");
+            requestApproval(clientSocket, request, execute);
+            return;
+        }
+        execute();
+    } catch (const std::exception& e) {
+        sendResponse(clientSocket, "ERROR: Invalid amount or account index");
+    }
+}
+
+void BankServer::handleBatchTransfer(int clientSocket, ClientSession& session, const std::vector<std::string>& args) {
+    // Строки пакета - тройки "получатель сумма описание" после индекса счёта и режима
+    if (args.size() < 5 || (args.size() - 2) % 3 != 0 || (args[1] != "ATOMIC" && args[1] != "EACH")) {
+        sendResponse(clientSocket, "ERROR: Usage: BATCH_TRANSFER <account_index> <ATOMIC|EACH> "
+                                   "<target> <amount> <description> [<target> <amount> <description> ...]");
+        return;
+    }
+    
+    try {
+        int accountIndex = std::stoi(args[0]);
+        bool atomic = args[1] == "ATOMIC";
+        
+        std::string accountNumber;
+        if (accountIndex < 0 || !database_.getAccountNumber(session.accountId, accountIndex, accountNumber)) {
+            sendResponse(clientSocket, "ERROR: Invalid account index");
+            return;
+        }
+        
+        // Суммы разбираются до любых проверок: ошибка в одной строке отклоняет весь пакет
+        std::vector<TransferItem> items;
+        items.reserve((args.size() - 2) / 3);
+        Money total;
+        for (size_t i = 2; i < args.size(); i += 3) {
+            TransferItem item;
+            item.amount = Money::parse(args[i + 1]);
+            // Отрицательная строка уменьшила бы общую сумму для лимита и одобрения
+            if (item.amount <= Money()) {
+                sendResponse(clientSocket, "ERROR: Amount must be positive in batch row #" + std::to_string(items.size()));
                 return;
             }
+            item.description = args[i + 2];
+            // Ненайденный получатель остаётся как есть - его строку отклонит база
+            if (!findTransferTarget(args[i], item.toNumber)) {
+                item.toNumber = args[i];
+            }
+            total += item.amount;
+            items.push_back(std::move(item));
         }
         
-        if (session.clientData->accounts[accountIndex].transfer(targetClient->accounts[0], amount, description)) {
-            database_.saveToFile();
-            sendResponse(clientSocket, "TRANSFER successful from account " + 
-                        session.clientData->accounts[accountIndex].getNumber());
-        } else {
-            sendResponse(clientSocket, "ERROR: Transfer failed - insufficient funds");
+        // Ограничения и одобрение - один раз на общую сумму пакета
+        if (!canPerformOperation(session, "TRANSFER", total)) {
+            sendResponse(clientSocket, "ERROR: Operation not allowed for unverified accounts or amount too large");
+            return;
+        }
+        
+        // Пакет целиком; крупный у верифицированного клиента выполнит решение сотрудника
+        auto execute = [this, clientSocket, accountNumber, items, atomic, args]() {
+            std::vector<bool> applied;
+            database_.transferBatch(accountNumber, items, atomic, &applied);
+            
+            size_t appliedCount = std::count(applied.begin(), applied.end(), true);
+            if (atomic && appliedCount == 0) {
+                sendResponse(clientSocket, "ERROR: Batch transfer failed - insufficient funds or invalid entries, nothing applied");
+                return;
+            }
+            
+            std::stringstream response;
+            response << "BATCH_TRANSFER completed from account " << accountNumber << ": "
+                     << appliedCount << " of " << items.size() << " transfers applied";
+            for (size_t i = 0; i < items.size(); i++) {
+                if (!applied[i]) {
+                    response << "\nFAILED #" << i << " " << args[2 + i * 3] << " " << items[i].amount;
+                }
+            }
+            sendResponse(clientSocket, response.str());
+        };
+        
+        BankSettings settings = database_.getSettings();
+        if (isClientVerified(session) && total > settings.largeOperationThreshold) {
+            ApprovalRequest request = makeApprovalRequest(session.accountId, "BATCH_TRANSFER", accountNumber, total,
+                                                          std::to_string(items.size()) + " recipients",
+                                                          "Batch transfer from " + accountNumber);
+            request.items = items;
+            request.atomic = atomic;
+            // Низкорисковую операцию одобряют правила, без сотрудника
+            if (autoApprove(request, accountIndex)) {
+                execute();
+                return;
+            }
+            sendResponse(clientSocket, 
+                "NOTICE: Large batch transfer requires security approval.\n"
+                "Request sent to security department. Please wait...");
+            requestApproval(clientSocket, request, execute);
+            return;
         }
+        execute();
     } catch (const std::exception& e) {
         sendResponse(clientSocket, "ERROR: Invalid amount or account index");
     }
@@ -1026,10 +1531,15 @@ void BankServer::handleCreateAccount(int clientSocket, ClientSession& session, c
             case AccountType::DEPOSIT: prefix = "DEP"; break;
         }
         
+        size_t accountCount;
+        {
+            Database::ClientLock lock = database_.lockClient(session.accountId);
+            accountCount = session.clientData->accounts.size();
+        }
         std::string newAccountNumber = session.accountId + "_" + prefix + "_" + 
-                                     std::to_string(session.clientData->accounts.size() + 1);
+                                     std::to_string(accountCount + 1);
         
-        Account newAccount(newAccountNumber, accountType, 0.0);
+        Account newAccount(newAccountNumber, accountType, Money());
         
         // Лимит для кредитного счёта
         if (accountType == AccountType::CREDIT) {
@@ -1037,8 +1547,10 @@ void BankServer::handleCreateAccount(int clientSocket, ClientSession& session, c
             newAccount.setCreditLimit(settings.largeLoanThreshold);
         }
         
-        session.clientData->accounts.push_back(newAccount);
-        database_.saveToFile();
+        if (!database_.addAccountToClient(session.accountId, newAccount)) {
+            sendResponse(clientSocket, "ERROR: Failed to create account");
+            return;
+        }
         
         std::stringstream response;
         response << "SUCCESS: New " << newAccount.getTypeString() 
@@ -1059,19 +1571,22 @@ void BankServer::handleAccountList(int clientSocket, ClientSession& session) {
     std::stringstream response;
     response << "Your accounts:\n";
     
-    for (size_t i = 0; i < session.clientData->accounts.size(); ++i) {
-        const auto& account = session.clientData->accounts[i];
-        response << "[" << i << "] " << account.getNumber() 
-                 << " (" << account.getTypeString() << "): $" 
-                 << account.getBalance();
-        if (account.getCreditLimit() > 0) {
-            response << " (Credit limit: $" << account.getCreditLimit() << ")";
+    {
+        Database::ClientLock lock = database_.lockClient(session.accountId);
+        for (size_t i = 0; i < session.clientData->accounts.size(); ++i) {
+            const auto& account = session.clientData->accounts[i];
+            response << "[" << i << "] " << account.getNumber() 
+                     << " (" << account.getTypeString() << "): $" 
+                     << account.getBalance();
+            if (account.getCreditLimit() > Money()) {
+                response << " (Credit limit: $" << account.getCreditLimit() << ")";
+            }
+            response << "\n";
+        }
+        
+        if (session.clientData->accounts.empty()) {
+            response << "No accounts yet.";
         }
-        response << "\n";
-    }
-    
-    if (session.clientData->accounts.empty()) {
-        response << "No accounts yet.";
     }
     
     sendResponse(clientSocket, response.str());
@@ -1089,28 +1604,36 @@ void BankServer::handleHistory(int clientSocket, ClientSession& session, const s
         }
     }
     
-    if (accountIndex < 0 || accountIndex >= static_cast<int>(session.clientData->accounts.size())) {
-        sendResponse(clientSocket, "ERROR: Invalid account index");
-        return;
-    }
-    
     std::stringstream response;
-    response << "Transaction history for " << session.clientData->accounts[accountIndex].getNumber() << ":\n";
-    
-    const auto& transactions = session.clientData->accounts[accountIndex].getTransactionHistory();
-    for (const auto& txn : transactions) {
-        response << txn.id << ": " << txn.type << " $" << txn.amount;
-        if (!txn.description.empty()) {
-            response << " (" << txn.description << ")";
-        }
-        if (!txn.targetAccount.empty()) {
-            response << " -> " << txn.targetAccount;
+    {
+        Database::ClientLock lock = database_.lockClient(session.accountId);
+        if (accountIndex >= 0 && accountIndex < static_cast<int>(session.clientData->accounts.size())) {
+            const Account& account = session.clientData->accounts[accountIndex];
+            response << "Transaction history for " << account.getNumber() << ":\n";
+            
+            const auto& transactions = account.getTransactionHistory();
+            for (const auto& txn : transactions) {
+                response << txn.id << ": " << txn.type << " $" << txn.amount;
+                if (!txn.description.empty()) {
+                    response << " (" << txn.description << ")";
+                }
+                if (!txn.targetAccount.empty()) {
+                    response << " -> " << txn.targetAccount;
+                }
+                response << "\n";
+            }
+            
+            if (transactions.empty()) {
+                response << "No transactions found";
+            }
+        } else {
+            accountIndex = -1;
         }
-        response << "\n";
     }
     
-    if (transactions.empty()) {
-        response << "No transactions found";
+    if (accountIndex < 0) {
+        sendResponse(clientSocket, "ERROR: Invalid account index");
+        return;
     }
     
     sendResponse(clientSocket, response.str());
@@ -1118,14 +1641,19 @@ void BankServer::handleHistory(int clientSocket, ClientSession& session, const s
 
 void BankServer::handleInfo(int clientSocket, ClientSession& session) {
     std::stringstream response;
-    response << "Client Information:\n"
-             << "Account ID: " << session.clientData->accountId << "\n"
-             << "Full Name: " << session.clientData->fullName << "\n"
-             << "Birth Date: " << session.clientData->birthDate << "\n"
-             << "Status: " << (session.clientData->status == ClientStatus::VERIFIED ? "VERIFIED" : "PENDING VERIFICATION") << "\n"
-             << "Number of accounts: " << session.clientData->accounts.size() << "\n";
-    
-    if (session.clientData->status != ClientStatus::VERIFIED) {
+    bool verified;
+    {
+        Database::ClientLock lock = database_.lockClient(session.accountId);
+        verified = session.clientData->status == ClientStatus::VERIFIED;
+        response << "Client Information:\n"
+                 << "Account ID: " << session.clientData->accountId << "\n"
+                 << "Full Name: " << session.clientData->fullName << "\n"
+                 << "Birth Date: " << session.clientData->birthDate << "\n"
+                 << "Status: " << (verified ? "VERIFIED" : "PENDING VERIFICATION") << "\n"
+                 << "Number of accounts: " << session.clientData->accounts.size() << "\n";
+    }
+    
+    if (!verified) {
         BankSettings settings = database_.getSettings();
         response << "\nUNVERIFIED ACCOUNT LIMITATIONS:\n"
                  << "- Max transaction: $" << settings.largeOperationThreshold / 10 << "\n"
@@ -1138,149 +1666,231 @@ void BankServer::handleInfo(int clientSocket, ClientSession& session) {
 }
 
 std::string BankServer::generateRequestId() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 9999);
+    return IdGenerator::next("REQ");
+}
+
+void BankServer::requestApproval(int clientSocket, ApprovalRequest request, std::function<void()> operation,
+                                 int timeoutSeconds) {
+    std::shared_ptr<Connection> conn = findConnection(clientSocket);
+    if (!conn) return;
+    
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        conn->parkedOperation = [this, clientSocket, operation](bool approved) {
+            if (!approved) {
+                sendResponse(clientSocket, "ERROR: Operation rejected by security or timeout exceeded");
+                return;
+            }
+            operation();
+        };
+        conn->decided = false;
+    }
+    
+    // Запрос и отложенная операция появляются под одной блокировкой:
+    // APPROVE не может застать запрос без операции
+    std::string record = "OPEN|";
+    {
+        std::lock_guard<std::mutex> lock(approvalMutex_);
+        std::string requestId = createApprovalRequest(request);
+        TimerWheel::TimerId timeout = timers_.schedule(std::chrono::seconds(timeoutSeconds), [this, requestId]() {
+            std::cout << "Approval timeout for request: " << requestId << std::endl;
+            resolveApproval(requestId, false);
+        });
+        parkedApprovals_[requestId] = ParkedApproval{conn, nullptr, timeout};
+        ApprovalStore::serialize(request, record);
+    }
     
-    std::stringstream ss;
-    ss << "REQ" << std::time(nullptr) << dis(gen);
-    return ss.str();
+    // Запись на диск - вне блокировки, чтобы fdatasync не задерживал другие запросы.
+    // Если решение успело раньше, его CLOSE в журнале идёт первым - recoverApprovals это учитывает
+    approvalJournal_.append(record);
 }
 
-std::string BankServer::createApprovalRequest(const std::string& clientAccountId, const std::string& operationType, 
-                                             double amount, const std::string& targetAccount, const std::string& description) {
-    std::lock_guard<std::mutex> lock(approvalMutex_);
+bool BankServer::autoApprove(const ApprovalRequest& request, size_t accountIndex) {
+    std::time_t now = std::time(nullptr);
+    std::time_t openedAt = now;
+    database_.getAccountOpenedAt(request.clientAccountId, accountIndex, now, openedAt);
     
-    ApprovalRequest request;
+    size_t ruleLine = 0;
+    if (!approvalRules_.tryApprove(request, openedAt, now, &ruleLine)) {
+        return false;
+    }
+    std::cout << "Auto-approved " << request.operationType << " $" << request.amount
+              << " for " << request.clientAccountId << " by rule at line " << ruleLine << std::endl;
+    return true;
+}
+
+void BankServer::scheduleRulesReload() {
+    timers_.schedule(kRulesReloadInterval, [this]() {
+        approvalRules_.reloadIfChanged();
+        scheduleRulesReload();
+    });
+}
+
+std::string BankServer::createApprovalRequest(ApprovalRequest& request) {
+    // Вызывается под approvalMutex_
     request.requestId = generateRequestId();
-    request.clientAccountId = clientAccountId;
-    request.operationType = operationType;
-    request.amount = amount;
-    request.targetAccount = targetAccount;
-    request.description = description;
     request.timestamp = std::time(nullptr);
     request.status = "PENDING";
     
-    approvalQueue_.push(request);
-    approvalCV_.notify_all();
+    approvalQueue_.add(request);
     
     std::cout << "Approval request created: " << request.requestId 
-              << " for " << clientAccountId << " - " << operationType << " $" << amount << std::endl;
+              << " for " << request.clientAccountId << " - " << request.operationType
+              << " $" << request.amount << std::endl;
     
     return request.requestId;
 }
 
-bool BankServer::waitForApproval(const std::string& requestId, int timeoutSeconds) {
-    auto startTime = std::chrono::steady_clock::now();
-    
-    while (true) {
-        std::unique_lock<std::mutex> lock(approvalMutex_);
-        
-        // Ищем запрос в очереди
-        std::queue<ApprovalRequest> tempQueue = approvalQueue_;
-        bool found = false;
-        std::string status;
-        
-        while (!tempQueue.empty()) {
-            const auto& request = tempQueue.front();
-            if (request.requestId == requestId) {
-                status = request.status;
-                found = true;
-                break;
-            }
-            tempQueue.pop();
-        }
-        
-        if (found) {
-            if (status == "APPROVED") {
-                // Удаляем одобренный запрос из очереди
-                std::queue<ApprovalRequest> newQueue;
-                while (!approvalQueue_.empty()) {
-                    if (approvalQueue_.front().requestId != requestId) {
-                        newQueue.push(approvalQueue_.front());
-                    }
-                    approvalQueue_.pop();
-                }
-                approvalQueue_ = newQueue;
-                return true;
-            } else if (status == "REJECTED") {
-                // Удаляем отклоненный запрос из очереди
-                std::queue<ApprovalRequest> newQueue;
-                while (!approvalQueue_.empty()) {
-                    if (approvalQueue_.front().requestId != requestId) {
-                        newQueue.push(approvalQueue_.front());
-                    }
-                    approvalQueue_.pop();
-                }
-                approvalQueue_ = newQueue;
-                return false;
-            }
-            // Если статус все еще PENDING, продолжаем ждать
-        } else {
-            // Если запрос не найден, значит он был обработан и удален
-            // Предполагаем, что он был одобрен (так как отклоненные мы явно обрабатываем)
-            return true;
-        }
-        
-        // Проверяем таймаут
-        auto currentTime = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(currentTime - startTime);
+void BankServer::resolveApproval(const std::string& requestId, bool approved) {
+    std::shared_ptr<Connection> conn;
+    std::function<void(bool)> recovered;
+    {
+        std::lock_guard<std::mutex> lock(approvalMutex_);
+        approvalQueue_.remove(requestId);
         
-        if (elapsed.count() >= timeoutSeconds) {
-            std::cout << "Approval timeout for request: " << requestId << std::endl;
-            
-            // Удаляем запрос по таймауту
-            std::queue<ApprovalRequest> newQueue;
-            while (!approvalQueue_.empty()) {
-                if (approvalQueue_.front().requestId != requestId) {
-                    newQueue.push(approvalQueue_.front());
-                }
-                approvalQueue_.pop();
-            }
-            approvalQueue_ = newQueue;
-            
-            return false;
+        auto it = parkedApprovals_.find(requestId);
+        if (it == parkedApprovals_.end()) {
+            return; // решение уже принято или срок истёк
         }
-        
-        // Ждем уведомления
-        approvalCV_.wait_for(lock, std::chrono::seconds(1));
+        conn = it->second.conn;
+        recovered = std::move(it->second.recovered);
+        timers_.cancel(it->second.timeout);
+        parkedApprovals_.erase(it);
+    }
+    
+    // Решение фиксируется до выполнения операции: после сбоя одобренная
+    // операция не повторится второй раз
+    std::string record = "CLOSE|";
+    Journal::appendField(record, requestId);
+    Journal::appendField(record, approved ? "APPROVED" : "REJECTED");
+    approvalJournal_.append(record);
+    
+    if (!conn) {
+        recovered(approved);
+        return;
     }
+    resumeParked(conn, approved);
 }
 
-bool BankServer::waitForVerification(const std::string& requestId, int timeoutSeconds) {
-    auto startTime = std::chrono::steady_clock::now();
+void BankServer::resumeParked(const std::shared_ptr<Connection>& conn, bool approved) {
+    bool resumeNow;
+    {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        conn->decided = true;
+        conn->approved = approved;
+        // Если команда ещё не отпустила поток, она продолжит сама (yieldIfParked)
+        resumeNow = conn->parked;
+        conn->parked = false;
+    }
     
-    while (true) {
-        std::unique_lock<std::mutex> lock(approvalMutex_);
-        
-        std::queue<ApprovalRequest> tempQueue = verificationQueue_;
-        bool found = false;
-        
-        while (!tempQueue.empty()) {
-            if (tempQueue.front().requestId == requestId) {
-                found = true;
-                break;
+    if (resumeNow && (!running_ || !workers_.submit([this, conn]() { resumeConnection(conn); }))) {
+        resumeConnection(conn);
+    }
+}
+
+void BankServer::releaseParkedApprovals() {
+    std::vector<std::pair<std::string, std::shared_ptr<Connection>>> waiting;
+    {
+        std::lock_guard<std::mutex> lock(approvalMutex_);
+        for (auto it = parkedApprovals_.begin(); it != parkedApprovals_.end();) {
+            if (!it->second.conn) {
+                ++it;
+                continue;
             }
-            tempQueue.pop();
+            waiting.emplace_back(it->first, it->second.conn);
+            timers_.cancel(it->second.timeout);
+            it = parkedApprovals_.erase(it);
         }
-        
-        // Если запрос удален из очереди - значит верифицирован
-        if (!found) {
-            return true;
+    }
+    
+    // CLOSE не пишется: после перезапуска запрос снова в очереди
+    for (auto& pair : waiting) {
+        std::shared_ptr<Connection> conn = pair.second;
+        std::string requestId = pair.first;
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            int clientSocket = conn->socket;
+            conn->parkedOperation = [this, clientSocket, requestId](bool) {
+                sendResponse(clientSocket, "NOTICE: Server is shutting down. Request " + requestId +
+                                           " stays pending and will be decided after restart");
+            };
         }
-        
-        // Проверяем таймаут
-        auto currentTime = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(currentTime - startTime);
-        
-        if (elapsed.count() >= timeoutSeconds) {
-            std::cout << "Verification timeout for request: " << requestId << std::endl;
-            return false;
+        resumeParked(conn, false);
+    }
+}
+
+void BankServer::recoverApprovals() {
+    // Журнал читается целиком: CLOSE может стоять раньше своего OPEN
+    ApprovalStore open;
+    std::unordered_set<std::string> closed;
+    approvalJournal_.replay([&open, &closed](const std::string& record) {
+        std::stringstream ss(record);
+        std::string type;
+        if (!std::getline(ss, type, '|')) {
+            return;
         }
         
-        // Ждем уведомления
-        approvalCV_.wait_for(lock, std::chrono::seconds(1));
+        if (type == "OPEN") {
+            ApprovalRequest request;
+            if (ApprovalStore::parse(ss, request) && !closed.count(request.requestId)) {
+                open.add(request);
+            }
+        } else if (type == "CLOSE") {
+            std::string requestId;
+            if (Journal::readField(ss, requestId) && !open.remove(requestId)) {
+                closed.insert(requestId);
+            }
+        }
+    });
+    
+    // Сжатие: в журнале остаются только открытые запросы
+    if (approvalJournal_.recordCount() > open.size()) {
+        approvalJournal_.reset();
+        for (const auto& request : open) {
+            std::string record = "OPEN|";
+            ApprovalStore::serialize(request, record);
+            approvalJournal_.append(record);
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(approvalMutex_);
+    for (const auto& request : open) {
+        std::string requestId = request.requestId;
+        approvalQueue_.add(request);
+        TimerWheel::TimerId timeout = timers_.schedule(std::chrono::seconds(kRecoveredApprovalTimeoutSeconds),
+                                                       [this, requestId]() {
+            std::cout << "Approval timeout for request: " << requestId << std::endl;
+            resolveApproval(requestId, false);
+        });
+        parkedApprovals_[requestId] = ParkedApproval{
+            nullptr, [this, request](bool approved) { executeRecoveredApproval(request, approved); }, timeout};
+    }
+    if (!open.empty()) {
+        std::cout << "Recovered " << open.size() << " pending approval requests." << std::endl;
+    }
+}
+
+void BankServer::executeRecoveredApproval(const ApprovalRequest& request, bool approved) {
+    // Клиента, ждавшего ответа, уже нет: результат виден в его истории операций
+    if (!approved) {
+        std::cout << "Recovered request " << request.requestId << " rejected" << std::endl;
+        return;
+    }
+    
+    const TransferItem& first = request.items.front();
+    bool success = false;
+    if (request.operationType == "WITHDRAW") {
+        success = database_.withdraw(request.sourceAccount, first.amount, first.description);
+    } else if (request.operationType == "TRANSFER") {
+        success = database_.transfer(request.sourceAccount, first.toNumber, first.amount, first.description);
+    } else if (request.operationType == "BATCH_TRANSFER") {
+        std::vector<bool> applied;
+        database_.transferBatch(request.sourceAccount, request.items, request.atomic, &applied);
+        success = std::find(applied.begin(), applied.end(), true) != applied.end();
     }
+    
+    std::cout << "Recovered request " << request.requestId << " - " << request.operationType
+              << (success ? " executed" : " failed") << std::endl;
 }
 
 void BankServer::handlePendingRequests(int clientSocket, ClientSession& session) {
@@ -1299,11 +1909,8 @@ void BankServer::handlePendingRequests(int clientSocket, ClientSession& session)
     std::stringstream response;
     response << "Pending Operation Requests:\n";
     
-    std::queue<ApprovalRequest> tempQueue = approvalQueue_;
     int index = 0;
-    
-    while (!tempQueue.empty()) {
-        const auto& request = tempQueue.front();
+    for (const auto& request : approvalQueue_) {
         response << "[" << index << "] " << request.requestId 
                  << " | Client: " << request.clientAccountId
                  << " | Operation: " << request.operationType
@@ -1318,7 +1925,6 @@ void BankServer::handlePendingRequests(int clientSocket, ClientSession& session)
         }
         
         response << " | Time: " << std::ctime(&request.timestamp);
-        tempQueue.pop();
         index++;
     }
     
@@ -1344,19 +1950,20 @@ void BankServer::handlePendingVerifications(int clientSocket, ClientSession& ses
     std::stringstream response;
     response << "Pending Verification Requests:\n";
     
-    std::queue<ApprovalRequest> tempQueue = verificationQueue_;
     int index = 0;
-    
-    while (!tempQueue.empty()) {
-        const auto& request = tempQueue.front();
+    for (const auto& request : verificationQueue_) {
         ClientData* client = database_.findClient(request.clientAccountId);
         
         response << "[" << index << "] " << request.requestId 
-                 << " | Client: " << request.clientAccountId
-                 << " | Name: " << (client ? client->fullName : "Unknown")
-                 << " | Passport: " << (client ? client->passportData : "Unknown")
-                 << " | Time: " << std::ctime(&request.timestamp);
-        tempQueue.pop();
+                 << " | Client: " << request.clientAccountId;
+        if (client) {
+            Database::ClientLock clientLock = database_.lockClient(request.clientAccountId);
+            response << " | Name: " << client->fullName
+                     << " | Passport: " << client->passportData;
+        } else {
+            response << " | Name: Unknown | Passport: Unknown";
+        }
+        response << " | Time: " << std::ctime(&request.timestamp);
         index++;
     }
     
@@ -1370,13 +1977,12 @@ void BankServer::handleApproveRequest(int clientSocket, ClientSession& session,
     }
     
     if (args.size() < 1) {
-        sendResponse(clientSocket, "ERROR: Usage: APPROVE <request_index>");
+        sendResponse(clientSocket, "ERROR: Usage: APPROVE <request_id|request_index>");
         return;
     }
     
-    try {
-        int requestIndex = std::stoi(args[0]);
-        
+    std::string requestId;
+    {
         std::lock_guard<std::mutex> lock(approvalMutex_);
         
         if (approvalQueue_.empty()) {
@@ -1384,44 +1990,21 @@ void BankServer::handleApproveRequest(int clientSocket, ClientSession& session,
             return;
         }
         
-        // Создаем временную копию для поиска
-        std::queue<ApprovalRequest> tempQueue = approvalQueue_;
-        std::vector<ApprovalRequest> requests;
-        
-        while (!tempQueue.empty()) {
-            requests.push_back(tempQueue.front());
-            tempQueue.pop();
-        }
-        
-        if (requestIndex < 0 || requestIndex >= static_cast<int>(requests.size())) {
-            sendResponse(clientSocket, "ERROR: Invalid request index");
+        // Id из PENDING_REQUESTS не сдвигается, когда соседние запросы уходят из очереди
+        const ApprovalRequest* request = approvalQueue_.lookup(args[0]);
+        if (!request) {
+            sendResponse(clientSocket, "ERROR: Invalid request id or index");
             return;
         }
-        
-        // Находим и обновляем целевой запрос
-        ApprovalRequest targetRequest = requests[requestIndex];
-        targetRequest.status = "APPROVED";
-        
-        // Создаем новую очередь с обновленным запросом
-        std::queue<ApprovalRequest> newQueue;
-        for (size_t i = 0; i < requests.size(); i++) {
-            if (i == static_cast<size_t>(requestIndex)) {
-                newQueue.push(targetRequest);
-            } else {
-                newQueue.push(requests[i]);
-            }
-        }
-        approvalQueue_ = newQueue;
-        
-        approvalCV_.notify_all();
-        
-        sendResponse(clientSocket, "SUCCESS: Request " + targetRequest.requestId + " approved");
-        std::cout << "Request approved: " << targetRequest.requestId 
-                  << " by " << session.accountId << std::endl;
-        
-    } catch (const std::exception& e) {
-        sendResponse(clientSocket, "ERROR: Invalid request index");
+        requestId = request->requestId;
     }
+    
+    // Отложенная операция клиента продолжается сразу, без опроса очереди
+    resolveApproval(requestId, true);
+    
+    sendResponse(clientSocket, "SUCCESS: Request " + requestId + " approved");
+    std::cout << "Request approved: " << requestId 
+              << " by " << session.accountId << std::endl;
 }
 
 void BankServer::handleRejectRequest(int clientSocket, ClientSession& session, const std::vector<std::string>& args) {
@@ -1431,13 +2014,12 @@ void BankServer::handleRejectRequest(int clientSocket, ClientSession& session, c
     }
     
     if (args.size() < 1) {
-        sendResponse(clientSocket, "ERROR: Usage: REJECT <request_index>");
+        sendResponse(clientSocket, "ERROR: Usage: REJECT <request_id|request_index>");
         return;
     }
     
-    try {
-        int requestIndex = std::stoi(args[0]);
-        
+    std::string requestId;
+    {
         std::lock_guard<std::mutex> lock(approvalMutex_);
         
         if (approvalQueue_.empty()) {
@@ -1445,44 +2027,21 @@ void BankServer::handleRejectRequest(int clientSocket, ClientSession& session, c
             return;
         }
         
-        // Создаем временную копию для поиска
-        std::queue<ApprovalRequest> tempQueue = approvalQueue_;
-        std::vector<ApprovalRequest> requests;
-        
-        while (!tempQueue.empty()) {
-            requests.push_back(tempQueue.front());
-            tempQueue.pop();
-        }
-        
-        if (requestIndex < 0 || requestIndex >= static_cast<int>(requests.size())) {
-            sendResponse(clientSocket, "ERROR: Invalid request index");
+        // Id из PENDING_REQUESTS не сдвигается, когда соседние запросы уходят из очереди
+        const ApprovalRequest* request = approvalQueue_.lookup(args[0]);
+        if (!request) {
+            sendResponse(clientSocket, "ERROR: Invalid request id or index");
             return;
         }
-        
-        // Находим и обновляем целевой запрос
-        ApprovalRequest targetRequest = requests[requestIndex];
-        targetRequest.status = "REJECTED";
-        
-        // Создаем новую очередь с обновленным запросом
-        std::queue<ApprovalRequest> newQueue;
-        for (size_t i = 0; i < requests.size(); i++) {
-            if (i == static_cast<size_t>(requestIndex)) {
-                newQueue.push(targetRequest);
-            } else {
-                newQueue.push(requests[i]);
-            }
-        }
-        approvalQueue_ = newQueue;
-        
-        approvalCV_.notify_all();
-        
-        sendResponse(clientSocket, "SUCCESS: Request " + targetRequest.requestId + " rejected");
-        std::cout << "Request rejected: " << targetRequest.requestId 
-                  << " by " << session.accountId << std::endl;
-        
-    } catch (const std::exception& e) {
-        sendResponse(clientSocket, "ERROR: Invalid request index");
+        requestId = request->requestId;
     }
+    
+    // Отложенная операция клиента продолжается сразу, без опроса очереди
+    resolveApproval(requestId, false);
+    
+    sendResponse(clientSocket, "SUCCESS: Request " + requestId + " rejected");
+    std::cout << "Request rejected: " << requestId 
+              << " by " << session.accountId << std::endl;
 }
 
 void BankServer::handleVerifyClient(int clientSocket, ClientSession& session, const std::vector<std::string>& args) {
@@ -1492,60 +2051,36 @@ void BankServer::handleVerifyClient(int clientSocket, ClientSession& session, co
     }
     
     if (args.size() < 1) {
-        sendResponse(clientSocket, "ERROR: Usage: VERIFY <verification_index>");
+        sendResponse(clientSocket, "ERROR: Usage: VERIFY <request_id|verification_index>");
         return;
     }
     
-    try {
-        int verificationIndex = std::stoi(args[0]);
-        
-        std::lock_guard<std::mutex> lock(approvalMutex_);
-        
-        if (verificationQueue_.empty()) {
-            sendResponse(clientSocket, "ERROR: No pending verifications");
-            return;
-        }
-        
-        std::vector<ApprovalRequest> requests;
-        std::queue<ApprovalRequest> tempQueue = verificationQueue_;
-        while (!tempQueue.empty()) {
-            requests.push_back(tempQueue.front());
-            tempQueue.pop();
-        }
-        
-        if (verificationIndex < 0 || verificationIndex >= static_cast<int>(requests.size())) {
-            sendResponse(clientSocket, "ERROR: Invalid verification index");
-            return;
-        }
-        
-        ApprovalRequest targetRequest = requests[verificationIndex];
+    std::lock_guard<std::mutex> lock(approvalMutex_);
+    
+    if (verificationQueue_.empty()) {
+        sendResponse(clientSocket, "ERROR: No pending verifications");
+        return;
+    }
+    
+    const ApprovalRequest* request = verificationQueue_.lookup(args[0]);
+    if (!request) {
+        sendResponse(clientSocket, "ERROR: Invalid verification id or index");
+        return;
+    }
+    ApprovalRequest targetRequest = *request;
+    
+    // Верифицируем клиента
+    if (database_.verifyClient(targetRequest.clientAccountId)) {
+        verificationQueue_.remove(targetRequest.requestId);
         
-        // Верифицируем клиента
-        if (database_.verifyClient(targetRequest.clientAccountId)) {
-            // Сохраняем базу
-            saveDatabase();
-            
-            // Удаляем запрос из очереди
-            std::queue<ApprovalRequest> newQueue;
-            for (size_t i = 0; i < requests.size(); i++) {
-                if (i != static_cast<size_t>(verificationIndex)) {
-                    newQueue.push(requests[i]);
-                }
-            }
-            verificationQueue_ = newQueue;
-            
-            // Сохраняем очередь
-            saveQueuesToFile();
-            
-            sendResponse(clientSocket, "SUCCESS: Client " + targetRequest.clientAccountId + " verified");
-            std::cout << "Client verified: " << targetRequest.clientAccountId 
-                      << " by " << session.accountId << std::endl;
-        } else {
-            sendResponse(clientSocket, "ERROR: Failed to verify client " + targetRequest.clientAccountId);
-        }
+        // Сохраняем очередь
+        saveQueuesToFile();
         
-    } catch (const std::exception& e) {
-        sendResponse(clientSocket, "ERROR: Invalid verification index");
+        sendResponse(clientSocket, "SUCCESS: Client " + targetRequest.clientAccountId + " verified");
+        std::cout << "Client verified: " << targetRequest.clientAccountId 
+                  << " by " << session.accountId << std::endl;
+    } else {
+        sendResponse(clientSocket, "ERROR: Failed to verify client " + targetRequest.clientAccountId);
     }
 }
 
@@ -1640,7 +2175,7 @@ void BankServer::checkAndCreateSuperUsers() {
         newSuperUser.passwordHash = Crypto::hashPassword("superpass123");
         newSuperUser.status = ClientStatus::VERIFIED;
         
-        Account superAccount("SUPER_ACC", AccountType::CHECKING, 0.0);
+        Account superAccount("SUPER_ACC", AccountType::CHECKING, Money());
         newSuperUser.accounts.push_back(superAccount);
         
         database_.addClient(newSuperUser);
@@ -7,10 +7,18 @@
 #include <unordered_map>
 #include <mutex>
 #include <vector>
-#include <queue>
-#include <condition_variable>
 #include <fstream>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <functional>
 #include "database.h"
+#include "worker_pool.h"
+#include "protocol.h"
+#include "approval_store.h"
+#include "timer_wheel.h"
+#include "journal.h"
+#include "approval_rules.h"
 
 struct ClientSession {
     std::string accountId;
@@ -19,15 +27,24 @@ struct ClientSession {
     bool isAuthenticated;
 };
 
-struct ApprovalRequest {
-    std::string requestId;
-    std::string clientAccountId;
-    std::string operationType;
-    double amount;
-    std::string targetAccount;
-    std::string description;
-    std::time_t timestamp;
-    std::string status;
+// Соединение, которым владеет реактор: сокет, сессия и очереди ввода-вывода
+struct Connection {
+    int socket;
+    ClientSession session;
+    MessageBuffer inBuffer;                  // недочитанные команды, трогает только реактор
+    std::mutex mutex;                        // защищает поля ниже
+    std::deque<std::string> pendingCommands; // команды, ожидающие обработки
+    std::string outBuffer;                   // неотправленная часть ответов
+    bool busy = false;                       // команда соединения выполняется в пуле
+    bool corked = false;                     // ответы копятся до конца пачки команд
+    bool closed = false;                     // клиент отключился
+    bool released = false;                   // сокет уже закрыт и удалён из реактора
+    // Операция, ждущая одобрения: соединение остаётся занятым, но поток пула свободен
+    std::function<void(bool)> parkedOperation;
+    bool parked = false;                     // обработка отложена до решения по запросу
+    bool decided = false;                    // решение уже принято
+    bool approved = false;
+    std::chrono::steady_clock::time_point lastActivity; // последнее чтение, трогает только реактор
 };
 
 class BankServer {
@@ -39,22 +56,68 @@ public:
     void stop();
     void run();
     
+    // Соединение без команд дольше timeout закрывается (по умолчанию 30 минут)
+    void setIdleTimeout(std::chrono::milliseconds timeout) { idleTimeout_ = timeout; }
+    
 private:
     int port_;
     std::atomic<bool> running_;
     std::thread serverThread_;
     Database database_;
-    std::unordered_map<int, ClientSession> clients_;
+    std::unordered_map<int, std::shared_ptr<Connection>> clients_;
     std::mutex clientsMutex_;
     
+    // Реактор на epoll и пул обработчиков команд
+    int epollFd_;
+    WorkerPool workers_;
+    
+    // Все сроки сервера: ожидание одобрения, простой соединений. Продвигается реактором,
+    // обработчики выполняются в его потоке
+    TimerWheel timers_;
+    std::chrono::milliseconds idleTimeout_;
+    
     // Система одобрения операций
     std::unordered_map<std::string, ClientSession> superUsers_;
-    std::queue<ApprovalRequest> approvalQueue_;
-    std::queue<ApprovalRequest> verificationQueue_;
+    ApprovalStore approvalQueue_;
+    ApprovalStore verificationQueue_;
     std::mutex approvalMutex_;
-    std::condition_variable approvalCV_;
     
-    void handleClient(int clientSocket);
+    // Отложенные операции по id запроса и таймеры их ожидания (под approvalMutex_).
+    // Общей condition variable нет: решение будит только операцию своего запроса.
+    // У запросов, восстановленных после перезапуска, соединения нет - решение
+    // выполняет recovered
+    struct ParkedApproval {
+        std::shared_ptr<Connection> conn;
+        std::function<void(bool)> recovered;
+        TimerWheel::TimerId timeout;
+    };
+    std::unordered_map<std::string, ParkedApproval> parkedApprovals_;
+    
+    // Журнал запросов на одобрение (<база>.approvals): запись OPEN при создании
+    // и CLOSE при решении, по одной строке. Незакрытые запросы переживают перезапуск
+    Journal approvalJournal_;
+    
+    // Правила автоодобрения (<база>.rules), перечитываются по таймеру
+    ApprovalRules approvalRules_;
+    
+    // Реактор
+    void acceptConnections(int serverSocket);
+    void readFromConnection(const std::shared_ptr<Connection>& conn);
+    void flushConnection(const std::shared_ptr<Connection>& conn);
+    void scheduleConnection(const std::shared_ptr<Connection>& conn);
+    void serviceConnection(const std::shared_ptr<Connection>& conn);
+    void closeConnection(const std::shared_ptr<Connection>& conn);
+    std::shared_ptr<Connection> findConnection(int clientSocket);
+    void sendWelcome(int clientSocket);
+    void scheduleIdleCheck(const std::shared_ptr<Connection>& conn, std::chrono::milliseconds delay);
+    void checkIdle(const std::shared_ptr<Connection>& conn);
+    void writeOutBuffer(Connection& conn);
+    // Отпускает поток, если команда отложила операцию до одобрения;
+    // невыполненный остаток пачки возвращается в очередь соединения
+    bool yieldIfParked(const std::shared_ptr<Connection>& conn, std::vector<std::string>& batch, size_t next);
+    void resumeConnection(const std::shared_ptr<Connection>& conn);
+    void finishService(const std::shared_ptr<Connection>& conn);
+    
     void processCommand(int clientSocket, ClientSession& session, const std::string& command);
     void sendResponse(int clientSocket, const std::string& response);
     
@@ -68,6 +131,7 @@ private:
     void handleWithdrawFromAccount(int clientSocket, ClientSession& session, const std::vector<std::string>& args);
     void handleTransfer(int clientSocket, ClientSession& session, const std::vector<std::string>& args);
     void handleTransferFromAccount(int clientSocket, ClientSession& session, const std::vector<std::string>& args);
+    void handleBatchTransfer(int clientSocket, ClientSession& session, const std::vector<std::string>& args);
     void handleHistory(int clientSocket, ClientSession& session, const std::vector<std::string>& args);
     void handleAccountList(int clientSocket, ClientSession& session);
     void handleCreateAccount(int clientSocket, ClientSession& session, const std::vector<std::string>& args);
@@ -92,12 +156,24 @@ private:
     void handleSetRates(int clientSocket, ClientSession& session, const std::vector<std::string>& args);
     void handleSettings(int clientSocket, ClientSession& session);
     
-    // Система одобрения
-    std::string createApprovalRequest(const std::string& clientAccountId, const std::string& operationType, 
-                                     double amount, const std::string& targetAccount, const std::string& description);
+    // Система одобрения.
+    // Крупная операция не держит поток: requestApproval ставит запрос в очередь
+    // и откладывает operation, APPROVE выполняет её, REJECT или истёкший срок
+    // отвечают клиенту отказом. request описывает операцию для журнала одобрений
+    void requestApproval(int clientSocket, ApprovalRequest request, std::function<void()> operation,
+                         int timeoutSeconds = 30);
+    std::string createApprovalRequest(ApprovalRequest& request);
+    // Правила автоодобрения: true - операцию можно выполнять сразу
+    bool autoApprove(const ApprovalRequest& request, size_t accountIndex);
+    void scheduleRulesReload();
+    void resolveApproval(const std::string& requestId, bool approved);
+    void resumeParked(const std::shared_ptr<Connection>& conn, bool approved);
+    // Остановка сервера: ожидающие клиенты получают уведомление, запросы остаются в журнале
+    void releaseParkedApprovals();
+    // Незакрытые запросы из журнала: снова в очереди, решение выполняет executeRecoveredApproval
+    void recoverApprovals();
+    void executeRecoveredApproval(const ApprovalRequest& request, bool approved);
     std::string createVerificationRequest(const std::string& clientAccountId, const std::string& clientName);
-    bool waitForApproval(const std::string& requestId, int timeoutSeconds = 30);
-    bool waitForVerification(const std::string& requestId, int timeoutSeconds = 30);
     void checkAndCreateSuperUsers();
     
     // Сохранение и загрузка состояния
@@ -110,7 +186,8 @@ private:
     // Утилиты
     bool isSuperUser(const std::string& accountId);
     bool isClientVerified(ClientSession& session);
-    bool canPerformOperation(ClientSession& session, const std::string& operationType, double amount = 0);
+    bool canPerformOperation(ClientSession& session, const std::string& operationType, Money amount = Money());
+    bool findTransferTarget(const std::string& target, std::string& accountNumber);
     std::string generateRequestId();
     void cleanupVerificationQueue(); 
 };
@@ -0,0 +1,451 @@
+#include "snapshot.h"
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const char kMagic[8] = {'B', 'A', 'N', 'K', 'S', 'N', 'A', 'P'};
+
+// Ссылка на строку в пуле
+struct StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fileSize;
+    uint64_t lsn;
+    uint64_t clientCount;
+    uint64_t clientsOffset;
+    uint64_t accountCount;
+    uint64_t accountsOffset;
+    uint64_t transactionCount;
+    uint64_t transactionsOffset;
+    uint64_t poolSize;
+    uint64_t poolOffset;
+};
+
+struct ClientRecord {
+    StringRef accountId;
+    StringRef fullName;
+    StringRef birthDate;
+    StringRef passportData;
+    StringRef passwordHash;
+    int32_t status;
+    uint32_t accountCount;
+    uint64_t firstAccount;
+};
+
+struct AccountRecord {
+    StringRef number;
+    int32_t type;
+    int32_t status;
+    int64_t balance;        // копейки; в версии 1 - биты double
+    int64_t creditLimit;
+    uint64_t firstTransaction;
+    uint64_t transactionCount;
+};
+
+struct TransactionRecord {
+    StringRef id;
+    StringRef type;
+    StringRef description;
+    StringRef targetAccount;
+    int64_t timestamp;
+    int64_t amount;
+};
+
+static_assert(sizeof(Header) == 96, "snapshot header layout changed");
+static_assert(sizeof(ClientRecord) == 56, "client record layout changed");
+static_assert(sizeof(AccountRecord) == 48, "account record layout changed");
+static_assert(sizeof(TransactionRecord) == 48, "transaction record layout changed");
+
+// Сумма из записи: версия 1 хранила double, версия 2 - копейки
+Money readMoney(uint32_t version, int64_t raw) {
+    if (version >= 2) {
+        return Money::fromCents(raw);
+    }
+    double value;
+    std::memcpy(&value, &raw, sizeof(value));
+    return Money::fromDouble(value);
+}
+
+size_t align8(size_t value) {
+    return (value + 7) & ~static_cast<size_t>(7);
+}
+
+template <typename T>
+void writeAt(std::string& out, size_t offset, const T& value) {
+    std::memcpy(&out[offset], &value, sizeof(T));
+}
+
+template <typename T>
+T readAt(const char* data, size_t offset) {
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    return value;
+}
+
+// Пул строк: повторяющиеся типы транзакций хранятся один раз
+class StringPool {
+public:
+    explicit StringPool(const std::string& key) : key_(key) {}
+
+    // Ссылки 32-битные: строка, не помещающаяся в первые 4 ГиБ пула, не
+    // добавляется, а снимок считается неудавшимся
+    StringRef add(const std::string& value) {
+        if (bytes_.size() + value.size() > UINT32_MAX) {
+            overflow_ = true;
+            return StringRef{};
+        }
+        StringRef ref{static_cast<uint32_t>(bytes_.size()), static_cast<uint32_t>(value.size())};
+        bytes_ += value;
+        return ref;
+    }
+
+    StringRef intern(const std::string& value) {
+        auto it = interned_.find(value);
+        if (it != interned_.end()) return it->second;
+        StringRef ref = add(value);
+        if (!overflow_) interned_.emplace(value, ref);
+        return ref;
+    }
+
+    std::string encrypted() const {
+        std::string out = bytes_;
+        for (size_t i = 0; i < out.size(); i++) {
+            out[i] ^= key_[i % key_.size()];
+        }
+        return out;
+    }
+
+    size_t size() const { return bytes_.size(); }
+    bool overflowed() const { return overflow_; }
+
+private:
+    const std::string& key_;
+    std::string bytes_;
+    bool overflow_ = false;
+    std::unordered_map<std::string, StringRef> interned_;
+};
+
+// Проверенный доступ к отображённому снимку
+class Reader {
+public:
+    Reader(const char* data, size_t size, const Header& header, const std::string& key)
+        : data_(data), size_(size), header_(header), key_(key) {}
+
+    bool tableFits(uint64_t offset, uint64_t count, size_t recordSize) const {
+        return offset % 8 == 0 && offset <= size_ &&
+               count <= (size_ - offset) / recordSize;
+    }
+
+    bool string(const StringRef& ref, std::string& out) const {
+        if (ref.offset > header_.poolSize || ref.length > header_.poolSize - ref.offset) {
+            return false;
+        }
+        out.resize(ref.length);
+        const char* src = data_ + header_.poolOffset + ref.offset;
+        size_t keyIndex = ref.offset % key_.size();
+        for (uint32_t i = 0; i < ref.length; i++) {
+            out[i] = src[i] ^ key_[keyIndex];
+            if (++keyIndex == key_.size()) keyIndex = 0;
+        }
+        return true;
+    }
+
+    ClientRecord client(uint64_t index) const {
+        return readAt<ClientRecord>(data_, header_.clientsOffset + index * sizeof(ClientRecord));
+    }
+
+    AccountRecord account(uint64_t index) const {
+        return readAt<AccountRecord>(data_, header_.accountsOffset + index * sizeof(AccountRecord));
+    }
+
+    TransactionRecord transaction(uint64_t index) const {
+        return readAt<TransactionRecord>(data_, header_.transactionsOffset + index * sizeof(TransactionRecord));
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+    const Header& header_;
+    const std::string& key_;
+};
+
+bool loadClient(const Reader& reader, const Header& header, uint64_t index, ClientData& client) {
+    ClientRecord clientRecord = reader.client(index);
+
+    if (!reader.string(clientRecord.accountId, client.accountId) ||
+        !reader.string(clientRecord.fullName, client.fullName) ||
+        !reader.string(clientRecord.birthDate, client.birthDate) ||
+        !reader.string(clientRecord.passportData, client.passportData) ||
+        !reader.string(clientRecord.passwordHash, client.passwordHash) ||
+        clientRecord.status < 0 || clientRecord.status > static_cast<int32_t>(ClientStatus::BLOCKED) ||
+        clientRecord.firstAccount > header.accountCount ||
+        clientRecord.accountCount > header.accountCount - clientRecord.firstAccount) {
+        std::cerr << "Error: Snapshot client record " << index << " is damaged." << std::endl;
+        return false;
+    }
+    client.status = static_cast<ClientStatus>(clientRecord.status);
+    client.accounts.reserve(clientRecord.accountCount);
+
+    for (uint64_t a = 0; a < clientRecord.accountCount; a++) {
+        AccountRecord accountRecord = reader.account(clientRecord.firstAccount + a);
+
+        std::string number;
+        if (!reader.string(accountRecord.number, number) ||
+            accountRecord.type < 0 || accountRecord.type > static_cast<int32_t>(AccountType::DEPOSIT) ||
+            accountRecord.status < 0 || accountRecord.status > static_cast<int32_t>(AccountStatus::CLOSED) ||
+            accountRecord.firstTransaction > header.transactionCount ||
+            accountRecord.transactionCount > header.transactionCount - accountRecord.firstTransaction) {
+            std::cerr << "Error: Snapshot account record for client " << client.accountId
+                      << " is damaged." << std::endl;
+            return false;
+        }
+
+        Account account(number, static_cast<AccountType>(accountRecord.type),
+                        readMoney(header.version, accountRecord.balance));
+        account.setCreditLimit(readMoney(header.version, accountRecord.creditLimit));
+        account.setStatus(static_cast<AccountStatus>(accountRecord.status));
+        account.reserveHistory(accountRecord.transactionCount);
+
+        for (uint64_t t = 0; t < accountRecord.transactionCount; t++) {
+            TransactionRecord txnRecord = reader.transaction(accountRecord.firstTransaction + t);
+
+            Transaction txn;
+            if (!reader.string(txnRecord.id, txn.id) ||
+                !reader.string(txnRecord.type, txn.type) ||
+                !reader.string(txnRecord.description, txn.description) ||
+                !reader.string(txnRecord.targetAccount, txn.targetAccount)) {
+                std::cerr << "Error: Snapshot transaction record for account " << number
+                          << " is damaged." << std::endl;
+                return false;
+            }
+            txn.timestamp = static_cast<std::time_t>(txnRecord.timestamp);
+            txn.amount = readMoney(header.version, txnRecord.amount);
+            account.appendTransaction(txn);
+        }
+
+        client.accounts.push_back(std::move(account));
+    }
+    return true;
+}
+
+}
+
+bool Snapshot::isSnapshot(const char* data, size_t size) {
+    return size >= sizeof(kMagic) && std::memcmp(data, kMagic, sizeof(kMagic)) == 0;
+}
+
+bool Snapshot::isLegacy(const char* data, size_t size) {
+    if (!isSnapshot(data, size) || size < sizeof(Header)) {
+        return false;
+    }
+    return readAt<Header>(data, 0).version < 3;
+}
+
+bool Snapshot::serialize(const std::unordered_map<std::string, ClientData>& clients,
+                         uint64_t lsn, const std::string& key, std::string& out) {
+    std::vector<const ClientData*> all;
+    all.reserve(clients.size());
+    for (const auto& pair : clients) {
+        all.push_back(&pair.second);
+    }
+    return serialize(all, lsn, key, out);
+}
+
+bool Snapshot::serialize(const std::vector<const ClientData*>& clients,
+                         uint64_t lsn, const std::string& key, std::string& out,
+                         const std::vector<AccountState>* frozen) {
+    size_t accountCount = 0;
+    size_t transactionCount = 0;
+    for (const ClientData* client : clients) {
+        for (const Account& account : client->accounts) {
+            transactionCount += frozen ? (*frozen)[accountCount].transactions
+                                       : account.getTransactionHistory().size();
+            accountCount++;
+        }
+    }
+
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.headerSize = sizeof(Header);
+    header.lsn = lsn;
+    header.clientCount = clients.size();
+    header.clientsOffset = sizeof(Header);
+    header.accountCount = accountCount;
+    header.accountsOffset = header.clientsOffset + clients.size() * sizeof(ClientRecord);
+    header.transactionCount = transactionCount;
+    header.transactionsOffset = header.accountsOffset + accountCount * sizeof(AccountRecord);
+    header.poolOffset = header.transactionsOffset + transactionCount * sizeof(TransactionRecord);
+
+    out.assign(header.poolOffset, '\0');
+    StringPool pool(key);
+
+    size_t clientIndex = 0;
+    size_t accountIndex = 0;
+    size_t transactionIndex = 0;
+    for (const ClientData* entry : clients) {
+        const ClientData& client = *entry;
+
+        ClientRecord clientRecord{};
+        clientRecord.accountId = pool.add(client.accountId);
+        clientRecord.fullName = pool.add(client.fullName);
+        clientRecord.birthDate = pool.add(client.birthDate);
+        clientRecord.passportData = pool.add(client.passportData);
+        clientRecord.passwordHash = pool.add(client.passwordHash);
+        clientRecord.status = static_cast<int32_t>(client.status);
+        clientRecord.accountCount = static_cast<uint32_t>(client.accounts.size());
+        clientRecord.firstAccount = accountIndex;
+        writeAt(out, header.clientsOffset + clientIndex++ * sizeof(ClientRecord), clientRecord);
+
+        for (const Account& account : client.accounts) {
+            const auto& transactions = account.getTransactionHistory();
+            size_t count = frozen ? (*frozen)[accountIndex].transactions : transactions.size();
+
+            AccountRecord accountRecord{};
+            accountRecord.number = pool.add(account.getNumber());
+            accountRecord.type = static_cast<int32_t>(account.getType());
+            accountRecord.status = static_cast<int32_t>(account.getStatus());
+            accountRecord.balance = (frozen ? (*frozen)[accountIndex].balance : account.getBalance()).cents();
+            accountRecord.creditLimit = account.getCreditLimit().cents();
+            accountRecord.firstTransaction = transactionIndex;
+            accountRecord.transactionCount = count;
+            writeAt(out, header.accountsOffset + accountIndex++ * sizeof(AccountRecord), accountRecord);
+
+            auto it = transactions.begin();
+            for (size_t t = 0; t < count; t++, ++it) {
+                const Transaction& txn = *it;
+                TransactionRecord txnRecord{};
+                txnRecord.id = pool.add(txn.id);
+                txnRecord.type = pool.intern(txn.type);
+                txnRecord.description = pool.add(txn.description);
+                txnRecord.targetAccount = pool.add(txn.targetAccount);
+                txnRecord.timestamp = static_cast<int64_t>(txn.timestamp);
+                txnRecord.amount = txn.amount.cents();
+                writeAt(out, header.transactionsOffset + transactionIndex++ * sizeof(TransactionRecord), txnRecord);
+            }
+        }
+    }
+
+    if (pool.overflowed()) {
+        std::cerr << "Error: Snapshot string pool exceeds 4 GiB." << std::endl;
+        out.clear();
+        return false;
+    }
+
+    header.poolSize = pool.size();
+    out += pool.encrypted();
+    out.resize(align8(out.size()), '\0');
+    header.fileSize = out.size();
+    writeAt(out, 0, header);
+    return true;
+}
+
+bool Snapshot::load(const char* data, size_t size, const std::string& key, WorkerPool& pool,
+                    std::unordered_map<std::string, ClientData>& clients, uint64_t& lsn) {
+    if (!isSnapshot(data, size) || size < sizeof(Header)) {
+        std::cerr << "Error: Not a database snapshot." << std::endl;
+        return false;
+    }
+
+    Header header = readAt<Header>(data, 0);
+    if (header.version == 0 || header.version > kVersion) {
+        std::cerr << "Error: Unsupported snapshot version " << header.version << std::endl;
+        return false;
+    }
+
+    Reader reader(data, size, header, key);
+    if (header.headerSize != sizeof(Header) || header.fileSize != size ||
+        !reader.tableFits(header.clientsOffset, header.clientCount, sizeof(ClientRecord)) ||
+        !reader.tableFits(header.accountsOffset, header.accountCount, sizeof(AccountRecord)) ||
+        !reader.tableFits(header.transactionsOffset, header.transactionCount, sizeof(TransactionRecord)) ||
+        !reader.tableFits(header.poolOffset, header.poolSize, 1) ||
+        header.poolSize > UINT32_MAX) {
+        std::cerr << "Error: Snapshot header is damaged." << std::endl;
+        return false;
+    }
+
+    size_t parts = std::min<uint64_t>(header.clientCount, pool.size() > 1 ? pool.size() * 4 : 1);
+    std::vector<std::unordered_map<std::string, ClientData>> partClients(parts);
+    std::vector<char> partOk(parts, 0);
+    pool.run(parts, [&](size_t i) {
+        uint64_t first = header.clientCount * i / parts;
+        uint64_t last = header.clientCount * (i + 1) / parts;
+        partClients[i].reserve(last - first);
+        for (uint64_t c = first; c < last; c++) {
+            ClientData client;
+            if (!loadClient(reader, header, c, client)) return;
+            std::string id = client.accountId;
+            partClients[i].emplace(std::move(id), std::move(client));
+        }
+        partOk[i] = 1;
+    });
+
+    std::unordered_map<std::string, ClientData> loaded;
+    loaded.reserve(header.clientCount);
+    for (size_t i = 0; i < parts; i++) {
+        if (!partOk[i]) return false;
+        loaded.merge(partClients[i]);
+    }
+
+    clients = std::move(loaded);
+    lsn = header.lsn;
+    return true;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            size_ = 0;
+            return false;
+        }
+        // Снимок читается последовательно от начала до конца
+        madvise(mapped, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(mapped);
+    }
+
+    // Отображение остаётся действительным и после закрытия дескриптора
+    ::close(fd);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
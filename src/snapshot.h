@@ -0,0 +1,69 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "database.h"
+#include "worker_pool.h"
+
+// Бинарный снимок базы (версия 3). Все числа - little-endian, суммы - копейки
+// в int64. Снимки версии 1 (суммы в double) читаются с округлением до копейки.
+// Версия 3 устроена как 2, но всегда пишется с контрольными суммами (DurableFile);
+// снимки версий 1 и 2 - без них.
+//
+//   [заголовок]  магическая строка, версия, размеры и смещения таблиц
+//   [клиенты]    записи фиксированной длины, у каждого - диапазон в таблице счетов
+//   [счета]      записи фиксированной длины, у каждого - диапазон в таблице транзакций
+//   [транзакции] записи фиксированной длины
+//   [строки]     общий пул строк, на который ссылаются записи (смещение + длина);
+//                байты пула шифруются XOR с ключом базы
+//
+// Файл отображается в память и проверяется на месте: все смещения и
+// диапазоны сверяются с размером файла до того, как по ним что-то читается.
+class Snapshot {
+public:
+    static const uint32_t kVersion = 3;
+
+    static bool isSnapshot(const char* data, size_t size);
+    // Снимок версии ниже 3 - записан без контрольных сумм
+    static bool isLegacy(const char* data, size_t size);
+
+    // false - строки клиентов не помещаются в 32-битные ссылки пула (больше
+    // 4 ГиБ); такой снимок не записывается вовсе
+    static bool serialize(const std::unordered_map<std::string, ClientData>& clients,
+                          uint64_t lsn, const std::string& key, std::string& out);
+    // Снимок части клиентов - одного сегмента базы. frozen - состояния всех
+    // счетов clients подряд; с ним из истории берётся лишь зафиксированный
+    // префикс, и в счета в это время могут писать. Без него всё читается текущим
+    static bool serialize(const std::vector<const ClientData*>& clients,
+                          uint64_t lsn, const std::string& key, std::string& out,
+                          const std::vector<AccountState>* frozen = nullptr);
+    // Диапазоны клиентов независимы и разбираются параллельно на потоках pool
+    static bool load(const char* data, size_t size, const std::string& key, WorkerPool& pool,
+                     std::unordered_map<std::string, ClientData>& clients, uint64_t& lsn);
+};
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+#endif
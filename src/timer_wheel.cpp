@@ -0,0 +1,127 @@
+#include "timer_wheel.h"
+#include <algorithm>
+#include <iostream>
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, Clock::time_point start)
+    : tick_(std::max(tick, std::chrono::milliseconds(1))), start_(start) {}
+
+TimerWheel::TimerId TimerWheel::schedule(std::chrono::milliseconds delay, Callback callback, Clock::time_point now) {
+    // Первый тик, начало которого не раньше now + delay
+    auto due = std::max(now + delay - start_, Clock::duration::zero());
+    uint64_t expires = (due + tick_ - Clock::duration(1)) / tick_;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (expires > currentTick_ + kMaxDelay) {
+        expires = currentTick_ + kMaxDelay;
+    }
+
+    Slot created;
+    TimerId id = nextId_++;
+    created.push_back(Timer{id, expires, std::move(callback), 0, 0});
+    timers_.emplace(id, created.begin());
+    place(created, created.begin());
+    return id;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = timers_.find(id);
+    if (it == timers_.end()) {
+        return false;
+    }
+    slotOf(*it->second).erase(it->second);
+    timers_.erase(it);
+    return true;
+}
+
+size_t TimerWheel::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return timers_.size();
+}
+
+TimerWheel::Slot& TimerWheel::slotOf(const Timer& timer) {
+    return timer.level == 0 ? root_[timer.slot] : levels_[timer.level - 1][timer.slot];
+}
+
+void TimerWheel::place(Slot& from, Slot::iterator timer) {
+    // splice не делает итераторы недействительными - индекс timers_ остаётся верным
+    if (timer->expires <= currentTick_) {
+        // Срок уже наступил: сработает на ближайшем тике
+        timer->level = 0;
+        timer->slot = currentTick_ & (kRootSize - 1);
+    } else {
+        uint64_t delta = timer->expires - currentTick_;
+        if (delta < kRootSize) {
+            timer->level = 0;
+            timer->slot = timer->expires & (kRootSize - 1);
+        } else {
+            int level = 1;
+            int shift = kRootBits;
+            while (level < kLevels - 1 && delta >= (uint64_t(1) << (shift + kLevelBits))) {
+                level++;
+                shift += kLevelBits;
+            }
+            timer->level = level;
+            timer->slot = (timer->expires >> shift) & (kLevelSize - 1);
+        }
+    }
+
+    Slot& to = slotOf(*timer);
+    to.splice(to.end(), from, timer);
+}
+
+void TimerWheel::cascade(int level, size_t slot) {
+    Slot moving;
+    moving.splice(moving.end(), levels_[level - 1][slot]);
+    while (!moving.empty()) {
+        place(moving, moving.begin());
+    }
+}
+
+size_t TimerWheel::advance(Clock::time_point now) {
+    if (now < start_) {
+        return 0;
+    }
+    uint64_t target = (now - start_) / tick_;
+
+    Slot expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (currentTick_ <= target) {
+            // Пустое колесо перематывается сразу, без прохода по тикам
+            if (timers_.empty()) {
+                currentTick_ = target + 1;
+                break;
+            }
+
+            size_t index = currentTick_ & (kRootSize - 1);
+            if (index == 0) {
+                // Первый уровень прошёл круг: раскладываем очередной слот старших уровней
+                int shift = kRootBits;
+                for (int level = 1; level < kLevels; level++, shift += kLevelBits) {
+                    size_t slot = (currentTick_ >> shift) & (kLevelSize - 1);
+                    cascade(level, slot);
+                    if (slot != 0) {
+                        break;
+                    }
+                }
+            }
+
+            Slot& due = root_[index];
+            for (const Timer& timer : due) {
+                timers_.erase(timer.id);
+            }
+            expired.splice(expired.end(), due);
+            currentTick_++;
+        }
+    }
+
+    for (Timer& timer : expired) {
+        try {
+            timer.callback();
+        } catch (const std::exception& e) {
+            std::cerr << "Timer callback failed: " << e.what() << std::endl;
+        }
+    }
+    return expired.size();
+}
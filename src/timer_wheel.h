@@ -0,0 +1,75 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+// Иерархическое колесо таймеров: все сроки сервера (ожидание одобрения,
+// простой сессии, отложенные задачи) в одном месте.
+//
+// Время делится на тики; первый уровень - 256 слотов по тику, каждый
+// следующий - 64 слота, покрывающих весь предыдущий уровень. Таймер кладётся
+// в слот по сроку, при переходе через границу уровня слот старшего уровня
+// раскладывается по младшим. Постановка и отмена - O(1), продвижение - O(1)
+// на тик плюс число сработавших таймеров. Потокобезопасно; обработчики
+// вызываются из advance() без внутренней блокировки.
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;
+    using Callback = std::function<void()>;
+
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(100),
+                        Clock::time_point start = Clock::now());
+
+    // Срок округляется вверх до тика: таймер не срабатывает раньше now + delay
+    TimerId schedule(std::chrono::milliseconds delay, Callback callback, Clock::time_point now = Clock::now());
+    // false, если таймер уже сработал или отменён
+    bool cancel(TimerId id);
+
+    // Продвигает колесо до now и вызывает обработчики истёкших таймеров.
+    // Возвращает их число
+    size_t advance(Clock::time_point now);
+
+    size_t size() const;
+
+private:
+    static const int kRootBits = 8;
+    static const int kLevelBits = 6;
+    static const int kLevels = 4;
+    static const uint64_t kRootSize = 1 << kRootBits;
+    static const uint64_t kLevelSize = 1 << kLevelBits;
+    // Дальше последнего уровня срок не откладывается (при тике 100 мс - около 77 суток)
+    static const uint64_t kMaxDelay = (uint64_t(1) << (kRootBits + (kLevels - 1) * kLevelBits)) - 1;
+
+    struct Timer {
+        TimerId id;
+        uint64_t expires;   // тик срабатывания
+        Callback callback;
+        int level;
+        size_t slot;
+    };
+    using Slot = std::list<Timer>;
+
+    void place(Slot& from, Slot::iterator timer);
+    void cascade(int level, size_t slot);
+
+    std::chrono::milliseconds tick_;
+    Clock::time_point start_;
+
+    mutable std::mutex mutex_;
+    uint64_t currentTick_ = 0;      // следующий необработанный тик
+    TimerId nextId_ = 1;
+    std::array<Slot, kRootSize> root_;
+    std::array<std::array<Slot, kLevelSize>, kLevels - 1> levels_;
+    std::unordered_map<TimerId, Slot::iterator> timers_;
+
+    Slot& slotOf(const Timer& timer);
+};
+
+#endif
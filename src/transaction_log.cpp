@@ -0,0 +1,168 @@
+#include "transaction_log.h"
+#include <new>
+#include <memory>
+
+const Transaction& TransactionLog::const_iterator::operator*() const {
+    return chunk_->slots[index_ - chunk_->base];
+}
+
+TransactionLog::const_iterator& TransactionLog::const_iterator::operator++() {
+    index_++;
+    if (index_ - chunk_->base == chunk_->capacity) {
+        chunk_ = chunk_->next.load(std::memory_order_acquire);
+    }
+    return *this;
+}
+
+TransactionLog::~TransactionLog() {
+    release();
+}
+
+TransactionLog::TransactionLog(const TransactionLog& other) {
+    reserve(other.size());
+    for (const Transaction& transaction : other) {
+        append(transaction);
+    }
+}
+
+TransactionLog& TransactionLog::operator=(const TransactionLog& other) {
+    if (this != &other) {
+        TransactionLog copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+TransactionLog::TransactionLog(TransactionLog&& other) noexcept {
+    *this = std::move(other);
+}
+
+TransactionLog& TransactionLog::operator=(TransactionLog&& other) noexcept {
+    if (this != &other) {
+        release();
+        head_.store(other.head_.exchange(nullptr));
+        tail_.store(other.tail_.exchange(nullptr));
+        reserved_.store(other.reserved_.exchange(0));
+        committed_.store(other.committed_.exchange(0));
+        firstChunk_ = other.firstChunk_;
+        other.firstChunk_ = kFirstChunk;
+    }
+    return *this;
+}
+
+void TransactionLog::reserve(size_t count) {
+    if (head_.load(std::memory_order_relaxed) == nullptr && count > firstChunk_) {
+        firstChunk_ = count;
+    }
+}
+
+void TransactionLog::append(const Transaction& transaction) {
+    size_t index = reserved_.fetch_add(1, std::memory_order_relaxed);
+    Chunk* chunk = chunkFor(index);
+    new (&chunk->slots[index - chunk->base]) Transaction(transaction);
+    chunk->ready[index - chunk->base].store(true);
+
+    publish(chunk);
+}
+
+void TransactionLog::publish(const Chunk* hint) {
+    // Отметка готовности и проверка соседнего слота - seq_cst: из двух писателей,
+    // закончивших одновременно, хотя бы один увидит слот другого и сдвинет границу
+    size_t committed = committed_.load();
+    while (committed < reserved_.load()) {
+        const Chunk* chunk = hint->base <= committed ? hint : head_.load(std::memory_order_acquire);
+        while (chunk && committed >= chunk->base + chunk->capacity) {
+            chunk = chunk->next.load(std::memory_order_acquire);
+        }
+        if (!chunk || !chunk->ready[committed - chunk->base].load()) {
+            return; // слот ещё пишется - его владелец сам продолжит сдвиг
+        }
+        // Неудачный CAS обновляет committed: кто-то уже продвинулся, проверяем дальше
+        committed_.compare_exchange_weak(committed, committed + 1);
+    }
+}
+
+TransactionLog::Chunk* TransactionLog::chunkFor(size_t index) {
+    Chunk* chunk = tail_.load(std::memory_order_acquire);
+    if (!chunk || chunk->base > index) {
+        chunk = head_.load(std::memory_order_acquire);
+    }
+
+    if (!chunk) {
+        Chunk* created = createChunk(0, firstChunk_);
+        Chunk* expected = nullptr;
+        if (head_.compare_exchange_strong(expected, created, std::memory_order_acq_rel)) {
+            chunk = created;
+        } else {
+            destroyChunk(created);
+            chunk = expected;
+        }
+    }
+
+    while (index >= chunk->base + chunk->capacity) {
+        Chunk* next = chunk->next.load(std::memory_order_acquire);
+        if (!next) {
+            // Блок ставит тот, кто первым до него добрался; проигравший освобождает свой
+            Chunk* created = createChunk(chunk->base + chunk->capacity, chunk->capacity * 2);
+            Chunk* expected = nullptr;
+            if (chunk->next.compare_exchange_strong(expected, created, std::memory_order_acq_rel)) {
+                next = created;
+            } else {
+                destroyChunk(created);
+                next = expected;
+            }
+        }
+        chunk = next;
+    }
+
+    tail_.store(chunk, std::memory_order_release);
+    return chunk;
+}
+
+TransactionLog::Chunk* TransactionLog::createChunk(size_t base, size_t capacity) {
+    Chunk* chunk = new Chunk;
+    chunk->base = base;
+    chunk->capacity = capacity;
+    chunk->slots = static_cast<Transaction*>(::operator new(capacity * sizeof(Transaction)));
+    chunk->ready = new std::atomic<bool>[capacity];
+    for (size_t i = 0; i < capacity; i++) {
+        chunk->ready[i].store(false, std::memory_order_relaxed);
+    }
+    chunk->next.store(nullptr, std::memory_order_relaxed);
+    return chunk;
+}
+
+void TransactionLog::destroyChunk(Chunk* chunk) {
+    ::operator delete(chunk->slots);
+    delete[] chunk->ready;
+    delete chunk;
+}
+
+void TransactionLog::release() {
+    size_t count = committed_.load(std::memory_order_acquire);
+    Chunk* chunk = head_.load(std::memory_order_acquire);
+    while (chunk) {
+        for (size_t i = 0; i < chunk->capacity && chunk->base + i < count; i++) {
+            chunk->slots[i].~Transaction();
+        }
+        Chunk* next = chunk->next.load(std::memory_order_relaxed);
+        destroyChunk(chunk);
+        chunk = next;
+    }
+    head_.store(nullptr);
+    tail_.store(nullptr);
+    reserved_.store(0);
+    committed_.store(0);
+}
+
+const Transaction& TransactionLog::operator[](size_t index) const {
+    const Chunk* chunk = head_.load(std::memory_order_acquire);
+    while (index >= chunk->base + chunk->capacity) {
+        chunk = chunk->next.load(std::memory_order_acquire);
+    }
+    return chunk->slots[index - chunk->base];
+}
+
+TransactionLog::const_iterator TransactionLog::begin() const {
+    return const_iterator(head_.load(std::memory_order_acquire), 0);
+}
@@ -0,0 +1,109 @@
+#ifndef TRANSACTION_LOG_H
+#define TRANSACTION_LOG_H
+
+#include <string>
+#include <ctime>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include "money.h"
+
+struct Transaction {
+    std::string id;
+    std::time_t timestamp;
+    std::string type;
+    Money amount;   // списания хранятся с минусом
+    std::string description;
+    std::string targetAccount;
+};
+
+// История операций счёта: только добавление, без блокировок.
+//
+// Записи лежат в цепочке блоков, каждый следующий вдвое больше, поэтому
+// добавление никогда не переносит уже записанные операции. Писатель
+// резервирует номер атомарным счётчиком, пишет запись в свой слот и
+// отмечает слот готовым; границу опубликованного префикса сдвигает любой
+// писатель, заметивший готовые слоты, - никто не ждёт соседа. Читатели
+// видят только опубликованный префикс и работают одновременно с писателями.
+//
+// Копирование и перемещение - только когда в историю никто не пишет
+// (загрузка, контрольная точка под исключительной блокировкой базы).
+class TransactionLog {
+    struct Chunk;
+
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Transaction;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Transaction*;
+        using reference = const Transaction&;
+
+        const_iterator() = default;
+
+        reference operator*() const;
+        pointer operator->() const { return &**this; }
+        const_iterator& operator++();
+        const_iterator operator++(int) { const_iterator old = *this; ++*this; return old; }
+
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+
+    private:
+        friend class TransactionLog;
+        const_iterator(const Chunk* chunk, size_t index) : chunk_(chunk), index_(index) {}
+
+        const Chunk* chunk_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    TransactionLog() = default;
+    ~TransactionLog();
+
+    TransactionLog(const TransactionLog& other);
+    TransactionLog& operator=(const TransactionLog& other);
+    TransactionLog(TransactionLog&& other) noexcept;
+    TransactionLog& operator=(TransactionLog&& other) noexcept;
+
+    // Можно вызывать из нескольких потоков одновременно
+    void append(const Transaction& transaction);
+
+    // Размер первого блока при загрузке, когда число операций известно заранее
+    void reserve(size_t count);
+
+    size_t size() const { return committed_.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+
+    const Transaction& operator[](size_t index) const;
+    const Transaction& back() const { return (*this)[size() - 1]; }
+
+    const_iterator begin() const;
+    const_iterator end() const { return const_iterator(nullptr, size()); }
+
+private:
+    struct Chunk {
+        size_t base;                    // номер первой записи блока
+        size_t capacity;
+        Transaction* slots;             // сырая память, записи создаются по мере добавления
+        std::atomic<bool>* ready;       // запись в слоте полностью создана
+        std::atomic<Chunk*> next;
+    };
+
+    static const size_t kFirstChunk = 4;
+
+    Chunk* chunkFor(size_t index);
+    Chunk* createChunk(size_t base, size_t capacity);
+    static void destroyChunk(Chunk* chunk);
+    // Сдвигает границу опубликованного префикса через все готовые слоты
+    void publish(const Chunk* hint);
+    void release();
+
+    std::atomic<Chunk*> head_{nullptr};
+    std::atomic<Chunk*> tail_{nullptr};     // подсказка: последний известный блок
+    std::atomic<size_t> reserved_{0};
+    std::atomic<size_t> committed_{0};
+    size_t firstChunk_ = kFirstChunk;
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include <string>
 #include "database.h"
 #include "crypto.h"
+#include "snapshot.h"
+#include "durable_file.h"
 
 // Функция для вычисления реальной ширины строки с учетом Unicode
 size_t utf8_strlen(const std::string& str) {
@@ -26,10 +28,8 @@ std::string pad_string(const std::string& str, size_t width) {
     return str + std::string(width - utf8_len, ' ');
 }
 
-std::string formatBalance(double balance) {
-    std::stringstream ss;
-    ss << std::fixed << std::setprecision(2) << balance;
-    return ss.str();
+std::string formatBalance(Money balance) {
+    return balance.toString();
 }
 
 std::string formatAccountType(AccountType type) {
@@ -79,8 +79,8 @@ void printClientData(const ClientData& client, int clientIndex) {
         std::cout << "+" << std::string(BOX_WIDTH - 2, '-') << "+" << std::endl;
         
         // Общая статистика по счетам
-        double totalBalance = 0;
-        double totalCreditLimit = 0;
+        Money totalBalance;
+        Money totalCreditLimit;
         
         for (const auto& account : client.accounts) {
             totalBalance += account.getBalance();
@@ -88,7 +88,7 @@ void printClientData(const ClientData& client, int clientIndex) {
         }
         
         printBoxLine("Общий баланс: $" + formatBalance(totalBalance), BOX_WIDTH);
-        if (totalCreditLimit > 0) {
+        if (totalCreditLimit > Money()) {
             printBoxLine("Кредитный лимит: $" + formatBalance(totalCreditLimit), BOX_WIDTH);
             printBoxLine("Доступно: $" + formatBalance(totalBalance + totalCreditLimit), BOX_WIDTH);
         }
@@ -108,7 +108,7 @@ void printClientData(const ClientData& client, int clientIndex) {
             std::string balanceLine = "     Баланс: $" + formatBalance(account.getBalance());
             printBoxLine(balanceLine, BOX_WIDTH);
             
-            if (account.getCreditLimit() > 0) {
+            if (account.getCreditLimit() > Money()) {
                 std::string creditLine = "     Кредитный лимит: $" + formatBalance(account.getCreditLimit());
                 printBoxLine(creditLine, BOX_WIDTH);
             }
@@ -121,9 +121,9 @@ void printClientData(const ClientData& client, int clientIndex) {
                 int showCount = std::min(2, static_cast<int>(transactions.size()));
                 for (int j = transactions.size() - showCount; j < static_cast<int>(transactions.size()); ++j) {
                     const auto& txn = transactions[j];
-                    std::string txnStr = "       • " + txn.type + " $" + formatBalance(std::abs(txn.amount));
-                    if (txn.amount < 0) {
-                        txnStr = "       • " + txn.type + " -$" + formatBalance(std::abs(txn.amount));
+                    std::string txnStr = "       • " + txn.type + " $" + formatBalance(txn.amount);
+                    if (txn.amount < Money()) {
+                        txnStr = "       • " + txn.type + " -$" + formatBalance(-txn.amount);
                     }
                     if (utf8_strlen(txnStr) > BOX_WIDTH - 10) {
                         txnStr = txnStr.substr(0, BOX_WIDTH - 13) + "...";
@@ -154,6 +154,25 @@ void viewEncryptedFile(const std::string& filename) {
     
     std::cout << "ЗАШИФРОВАННЫЙ ФАЙЛ: " << filename << std::endl;
     std::cout << "Размер: " << encryptedData.length() << " байт" << std::endl;
+    
+    size_t payloadSize = 0;
+    auto legacy = [](const char* data, size_t size) {
+        return Snapshot::isSnapshot(data, size) ? Snapshot::isLegacy(data, size)
+                                                : DurableFile::isLegacyText(data, size);
+    };
+    if (!DurableFile::verify(encryptedData.data(), encryptedData.size(), payloadSize, legacy)) {
+        std::cout << "Контрольные суммы: НЕ СОВПАДАЮТ или отсутствуют, файл повреждён" << std::endl;
+    } else if (payloadSize < encryptedData.size()) {
+        std::cout << "Контрольные суммы: в порядке" << std::endl;
+        encryptedData.resize(payloadSize);
+    } else {
+        std::cout << "Контрольные суммы: нет (файл прежней версии)" << std::endl;
+    }
+    
+    if (Snapshot::isSnapshot(encryptedData.data(), encryptedData.size())) {
+        std::cout << "Формат: бинарный снимок (строки зашифрованы в пуле)" << std::endl;
+        return;
+    }
     std::cout << "Первые 200 символов:" << std::endl;
     std::cout << "-----------------------------------------" << std::endl;
     
@@ -206,8 +225,8 @@ void viewDecryptedData(const std::string& filename) {
     
     int verified = 0, pending = 0, blocked = 0;
     int totalAccounts = 0;
-    double totalBalance = 0;
-    double totalCreditLimit = 0;
+    Money totalBalance;
+    Money totalCreditLimit;
     
     for (const auto& accountId : allAccounts) {
         ClientData* client = db.findClient(accountId);
@@ -269,6 +288,20 @@ int main(int argc, char* argv[]) {
         filename = argv[1];
     }
     
+    // Выгрузка и загрузка текстового формата: view_db <файл> --export|--import <путь>
+    if (argc > 3) {
+        std::string option = argv[2];
+        Database db(filename);
+        if (option == "--export") {
+            return db.exportToText(argv[3]) ? 0 : 1;
+        }
+        if (option == "--import") {
+            return db.importFromText(argv[3]) ? 0 : 1;
+        }
+        std::cout << "ОШИБКА: Неизвестный параметр: " << option << std::endl;
+        return 1;
+    }
+    
     std::cout << "ПРОСМОТР БАЗЫ ДАННЫХ БАНКА" << std::endl;
     std::cout << "=========================================" << std::endl << std::endl;
     
@@ -0,0 +1,108 @@
+#include "worker_pool.h"
+#include <iostream>
+#include <chrono>
+
+WorkerPool::WorkerPool(size_t threadCount)
+    : threadCount_(threadCount == 0 ? 1 : threadCount), running_(false) {}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+void WorkerPool::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) return;
+
+    running_ = true;
+    for (size_t i = 0; i < threadCount_; i++) {
+        workers_.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+    tasks_.clear();
+}
+
+bool WorkerPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return false;
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void WorkerPool::run(size_t count, const std::function<void(size_t)>& task) {
+    std::mutex doneMutex;
+    std::condition_variable doneCV;
+    size_t remaining = count;
+
+    // Счётчик уменьшается и тогда, когда задача завершилась исключением
+    struct Completion {
+        std::mutex& mutex;
+        std::condition_variable& cv;
+        size_t& remaining;
+        ~Completion() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--remaining == 0) cv.notify_all();
+        }
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        bool submitted = submit([&, i]() {
+            Completion done{doneMutex, doneCV, remaining};
+            task(i);
+        });
+        if (!submitted) {
+            // Пул не запущен - выполняем в вызывающем потоке
+            Completion done{doneMutex, doneCV, remaining};
+            try {
+                task(i);
+            } catch (const std::exception& e) {
+                std::cerr << "Worker task failed: " << e.what() << std::endl;
+            }
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    while (remaining > 0) {
+        doneCV.wait_for(lock, std::chrono::milliseconds(100));
+    }
+}
+
+void WorkerPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (running_ && tasks_.empty()) {
+                cv_.wait_for(lock, std::chrono::milliseconds(500));
+            }
+
+            if (!running_) return;
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "Worker task failed: " << e.what() << std::endl;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Пул рабочих потоков фиксированного размера.
+// Реактор передаёт сюда разобранные команды, сами потоки сокеты не читают.
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threadCount);
+    ~WorkerPool();
+
+    void start();
+    void stop();
+    bool submit(std::function<void()> task);
+
+    // Выполняет task(0) ... task(count - 1) на потоках пула и ждёт завершения всех.
+    // Нельзя вызывать из задачи этого же пула
+    void run(size_t count, const std::function<void(size_t)>& task);
+
+    size_t size() const { return threadCount_; }
+
+private:
+    size_t threadCount_;
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool running_;
+
+    void workerLoop();
+};
+
+#endif
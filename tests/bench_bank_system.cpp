@@ -0,0 +1,546 @@
+// Нагрузочные замеры банковской системы.
+// Запуск: bank_bench [сценарий] [число клиентов]
+//   load     - загрузка снимка по числу потоков (по умолчанию 1 000 000 клиентов)
+//   passport - проверка паспорта при регистрации (по умолчанию до 10 000 000 клиентов,
+//              на 10M нужно около 6 ГБ памяти)
+//   hot      - пополнения одного "горячего" счёта из 32 потоков (число - операций на поток)
+//   approval - задержка решения при множестве ожидающих одобрения операций
+//              (по умолчанию до 1000 одновременно отложенных снятий)
+//   ids      - генерация id операций: прежний random_device + mt19937 против IdGenerator
+//              (число - id на поток, 8 потоков)
+//   save     - сохранение базы после изменения одного клиента: все сегменты против
+//              одного (по умолчанию 200 000 клиентов)
+//   checkpoint - задержка пополнений из 8 потоков, когда контрольную точку пишет
+//              обработчик и когда фоновый поток (по умолчанию 200 000 клиентов)
+// Без аргументов выполняются все сценарии.
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include "../src/database.h"
+#include "../src/server.h"
+#include "../src/protocol.h"
+#include "../src/snapshot.h"
+#include "../src/crypto.h"
+#include "../src/id_generator.h"
+
+namespace {
+
+const std::string kBenchDir = "bench_data";
+const std::string kKey = "bank-system-key-2024";
+
+// Синтетическая база: у каждого клиента один счёт и две операции
+std::unordered_map<std::string, ClientData> makeClients(size_t count, bool withAccounts = true) {
+    std::unordered_map<std::string, ClientData> clients;
+    clients.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+        std::string id = "ACC" + std::to_string(1000000 + i);
+
+        ClientData client;
+        client.accountId = id;
+        client.fullName = "Client " + std::to_string(i);
+        client.birthDate = "1990-01-01";
+        client.passportData = std::to_string(4000000000ULL + i);
+        client.passwordHash = Crypto::hashPassword("password" + std::to_string(i));
+        client.status = ClientStatus::VERIFIED;
+
+        if (!withAccounts) {
+            clients.emplace(std::move(id), std::move(client));
+            continue;
+        }
+
+        Account account(id + "_SAV_1", AccountType::SAVINGS, Money::fromUnits(1000 + i % 1000));
+        account.appendTransaction({"TXN" + std::to_string(2 * i), 1700000000, "DEPOSIT",
+                                   Money::fromUnits(1000), "Initial deposit", ""});
+        account.appendTransaction({"TXN" + std::to_string(2 * i + 1), 1700000100, "DEPOSIT",
+                                   Money::fromUnits(i % 1000), "Salary", ""});
+        client.accounts.push_back(std::move(account));
+
+        clients.emplace(std::move(id), std::move(client));
+    }
+    return clients;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Сообщения базы о загрузке не нужны в отчёте
+class QuietOutput {
+public:
+    QuietOutput() : saved_(std::cout.rdbuf(sink_.rdbuf())) {}
+    ~QuietOutput() { std::cout.rdbuf(saved_); }
+
+private:
+    std::ostringstream sink_;
+    std::streambuf* saved_;
+};
+
+double timeLoad(const std::string& filename, size_t threads, size_t expectedClients) {
+    Database::setLoadThreads(threads);
+
+    QuietOutput quiet;
+    auto start = std::chrono::steady_clock::now();
+    Database db(filename);
+    double seconds = secondsSince(start);
+
+    if (db.getClientCount() != expectedClients) {
+        std::cerr << "Loaded " << db.getClientCount() << " clients, expected " << expectedClients << std::endl;
+        std::exit(1);
+    }
+    return seconds;
+}
+
+void writeSnapshot(const std::string& filename, size_t clientCount, bool withAccounts) {
+    std::string data;
+    {
+        auto clients = makeClients(clientCount, withAccounts);
+        if (!Snapshot::serialize(clients, 0, kKey, data)) {
+            std::exit(1);
+        }
+    }
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out << data;
+}
+
+void benchSnapshotLoad(size_t clientCount) {
+    std::cout << "=== Snapshot load: " << clientCount << " clients ===" << std::endl;
+
+    std::string binaryFile = kBenchDir + "/accounts.dat";
+    std::string textFile = kBenchDir + "/legacy.dat";
+    writeSnapshot(binaryFile, clientCount, true);
+    {
+        QuietOutput quiet;
+        Database db(binaryFile);
+        db.exportToText(textFile);
+    }
+
+    std::vector<size_t> threadCounts;
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads < cores; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(cores);
+
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "binary, s" << std::setw(14) << "text, s" << std::endl;
+    for (size_t threads : threadCounts) {
+        double binary = timeLoad(binaryFile, threads, clientCount);
+        double text = timeLoad(textFile, threads, clientCount);
+        std::cout << std::setw(8) << threads
+                  << std::setw(14) << std::fixed << std::setprecision(3) << binary
+                  << std::setw(14) << text << std::endl;
+    }
+}
+
+// Время проверки паспорта не должно зависеть от размера базы
+void benchPassportCheck(size_t maxClients) {
+    std::cout << "=== Passport duplicate check: up to " << maxClients << " clients ===" << std::endl;
+    std::cout << std::setw(12) << "clients" << std::setw(16) << "hit, ns" << std::setw(16) << "miss, ns" << std::endl;
+
+    const size_t lookups = 1000000;
+    std::string filename = kBenchDir + "/passports.dat";
+
+    for (size_t clientCount = 10000; clientCount <= maxClients; clientCount *= 10) {
+        writeSnapshot(filename, clientCount, false);
+
+        std::unique_ptr<Database> db;
+        {
+            QuietOutput quiet;
+            db = std::make_unique<Database>(filename);
+        }
+
+        // Существующие паспорта - повторная регистрация, остальные - новые клиенты
+        std::vector<std::string> existing, fresh;
+        existing.reserve(lookups);
+        fresh.reserve(lookups);
+        for (size_t i = 0; i < lookups; i++) {
+            existing.push_back(std::to_string(4000000000ULL + (i * 7919) % clientCount));
+            fresh.push_back(std::to_string(5000000000ULL + i));
+        }
+
+        size_t found = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& passport : existing) {
+            found += db->isPassportExists(passport);
+        }
+        double hit = secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        for (const auto& passport : fresh) {
+            found += db->isPassportExists(passport);
+        }
+        double miss = secondsSince(start);
+
+        if (found != lookups) {
+            std::cerr << "Unexpected passport lookup result: " << found << std::endl;
+            std::exit(1);
+        }
+
+        std::cout << std::setw(12) << clientCount
+                  << std::setw(16) << std::fixed << std::setprecision(1) << hit * 1e9 / lookups
+                  << std::setw(16) << miss * 1e9 / lookups << std::endl;
+    }
+}
+
+
+// Горячий счёт магазина: все потоки пополняют один и тот же счёт.
+// Для сравнения - тот же поток операций под общим мьютексом, как при блокировке счёта
+void benchHotAccount(size_t opsPerThread) {
+    const size_t threads = 32;
+    std::cout << "=== Hot account: " << threads << " threads x " << opsPerThread << " deposits ===" << std::endl;
+
+    auto run = [&](bool locked) {
+        Account merchant("MERCHANT_CHK_1", AccountType::CHECKING);
+        std::mutex accountMutex;
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&]() {
+                for (size_t i = 0; i < opsPerThread; i++) {
+                    if (locked) {
+                        std::lock_guard<std::mutex> lock(accountMutex);
+                        merchant.deposit(Money::fromCents(100), "Sale");
+                    } else {
+                        merchant.deposit(Money::fromCents(100), "Sale");
+                    }
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        double seconds = secondsSince(start);
+
+        if (merchant.getBalance() != Money::fromCents(static_cast<int64_t>(100 * threads * opsPerThread))) {
+            std::cerr << "Hot account balance mismatch: " << merchant.getBalance() << std::endl;
+            std::exit(1);
+        }
+        return threads * opsPerThread / seconds;
+    };
+
+    double lockFree = run(false);
+    double locked = run(true);
+    std::cout << std::setw(12) << "mode" << std::setw(16) << "ops/s" << std::endl;
+    std::cout << std::setw(12) << "lock-free" << std::setw(16) << std::fixed << std::setprecision(0) << lockFree << std::endl;
+    std::cout << std::setw(12) << "mutex" << std::setw(16) << locked << std::endl;
+}
+
+
+// Клиент бенчмарка: команды строками, ответы кадрами
+class BenchClient {
+public:
+    explicit BenchClient(int port) : socket_(socket(AF_INET, SOCK_STREAM, 0)) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        if (socket_ < 0 || connect(socket_, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            std::cerr << "Cannot connect to bench server" << std::endl;
+            std::exit(1);
+        }
+        read(); // приветствие
+    }
+    ~BenchClient() { close(socket_); }
+
+    void send(const std::string& commands) {
+        ::send(socket_, commands.data(), commands.size(), MSG_NOSIGNAL);
+    }
+
+    std::string read() {
+        std::string payload;
+        char chunk[4096];
+        while (!buffer_.nextFrame(payload)) {
+            ssize_t received = recv(socket_, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                std::cerr << "Bench server closed connection" << std::endl;
+                std::exit(1);
+            }
+            buffer_.append(chunk, received);
+        }
+        return payload;
+    }
+
+private:
+    int socket_;
+    MessageBuffer buffer_;
+};
+
+// Сотрудник одобряет по одному запросу, пока висят все остальные: задержка
+// от APPROVE до ответа клиенту не должна зависеть от числа ожидающих операций
+void benchPendingApprovals(size_t maxPending) {
+    std::cout << "=== Pending approvals: up to " << maxPending << " parked operations ===" << std::endl;
+    
+    // Каждое соединение - два дескриптора в одном процессе
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    
+    std::cout << std::setw(10) << "pending" << std::setw(14) << "avg, us" << std::setw(14) << "p99, us"
+              << std::setw(16) << "decisions/s" << std::endl;
+    
+    const int port = 9190;
+    for (size_t pending = 10; pending <= maxPending; pending *= 10) {
+        std::string filename = kBenchDir + "/approvals_" + std::to_string(pending) + ".dat";
+        std::vector<double> latencies;
+        double seconds;
+        {
+            QuietOutput quiet;
+            {
+                Database db(filename);
+                ClientData client;
+                client.accountId = "BENCH001";
+                client.fullName = "Bench Client";
+                client.birthDate = "1990-01-01";
+                client.passportData = "9000000001";
+                client.passwordHash = Crypto::hashPassword("benchpass");
+                client.status = ClientStatus::VERIFIED;
+                client.accounts.push_back(Account("BENCH001_CHK_1", AccountType::CHECKING, Money::fromUnits(1000000000)));
+                db.addClient(client);
+            }
+            
+            BankServer server(port, filename);
+            server.start();
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            
+            // Все крупные снятия откладываются до решения сотрудника
+            std::vector<std::unique_ptr<BenchClient>> clients;
+            for (size_t i = 0; i < pending; i++) {
+                clients.push_back(std::make_unique<BenchClient>(port));
+                clients.back()->send("LOGIN BENCH001 benchpass\nWITHDRAW 200000\n");
+                clients.back()->read();
+                clients.back()->read();
+            }
+            
+            BenchClient officer(port);
+            officer.send("SUPERLOGIN SUPER001 superpass123\n");
+            officer.read();
+            
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < pending; i++) {
+                auto sent = std::chrono::steady_clock::now();
+                officer.send("APPROVE 0\n");
+                officer.read();
+                std::string result = clients[i]->read();
+                latencies.push_back(secondsSince(sent) * 1e6);
+                if (result.find("WITHDRAW successful") == std::string::npos) {
+                    std::cerr << "Unexpected approval result: " << result << std::endl;
+                    std::exit(1);
+                }
+            }
+            seconds = secondsSince(start);
+            
+            clients.clear();
+            server.stop();
+        }
+        
+        std::sort(latencies.begin(), latencies.end());
+        double average = 0;
+        for (double latency : latencies) {
+            average += latency / latencies.size();
+        }
+        std::cout << std::setw(10) << pending
+                  << std::setw(14) << std::fixed << std::setprecision(1) << average
+                  << std::setw(14) << latencies[latencies.size() * 99 / 100]
+                  << std::setw(16) << std::setprecision(0) << pending / seconds << std::endl;
+    }
+}
+
+// Прежний генератор id операции: системный вызов random_device и новый mt19937 на каждый id
+std::string legacyTransactionId() {
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<> dis(0, 15);
+
+    std::stringstream ss;
+    ss << "TXN";
+    for (int i = 0; i < 12; i++) {
+        ss << std::hex << dis(gen);
+    }
+    return ss.str();
+}
+
+void benchIdGeneration(size_t idsPerThread) {
+    const size_t threads = 8;
+    std::cout << "=== Transaction ids: " << threads << " threads x " << idsPerThread << " ids ===" << std::endl;
+
+    auto run = [&](std::string (*generate)(), bool checkUnique) {
+        std::vector<std::vector<std::string>> ids(threads);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t]() {
+                ids[t].reserve(idsPerThread);
+                for (size_t i = 0; i < idsPerThread; i++) {
+                    ids[t].push_back(generate());
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        double seconds = secondsSince(start);
+
+        if (checkUnique) {
+            std::unordered_set<std::string> unique;
+            for (const auto& chunk : ids) {
+                unique.insert(chunk.begin(), chunk.end());
+            }
+            if (unique.size() != threads * idsPerThread) {
+                std::cerr << "Duplicate ids: " << threads * idsPerThread - unique.size() << std::endl;
+                std::exit(1);
+            }
+        }
+        return threads * idsPerThread / seconds;
+    };
+
+    double legacy = run(legacyTransactionId, false);
+    double snowflake = run([]() { return IdGenerator::next("TXN"); }, true);
+    std::cout << std::setw(12) << "generator" << std::setw(16) << "ids/s" << std::endl;
+    std::cout << std::setw(12) << "legacy" << std::setw(16) << std::fixed << std::setprecision(0) << legacy << std::endl;
+    std::cout << std::setw(12) << "snowflake" << std::setw(16) << snowflake << std::endl;
+}
+
+// Сохранение после изменения одного клиента: первое сохранение пишет все
+// сегменты (как прежняя полная перезапись), следующие - только изменённый
+void benchIncrementalSave(size_t clientCount) {
+    const size_t rounds = 20;
+    std::cout << "=== Save after one change: " << clientCount << " clients ===" << std::endl;
+
+    std::string filename = kBenchDir + "/segments.dat";
+    writeSnapshot(filename, clientCount, true);
+
+    double full, incremental;
+    {
+        QuietOutput quiet;
+        Database db(filename);
+        auto start = std::chrono::steady_clock::now();
+        db.saveToFile();
+        full = secondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < rounds; i++) {
+            std::string number = "ACC" + std::to_string(1000000 + i * 7919 % clientCount) + "_SAV_1";
+            db.deposit(number, Money::fromUnits(1), "Bench");
+            db.saveToFile();
+        }
+        incremental = secondsSince(start) / rounds;
+    }
+
+    std::cout << std::setw(14) << "save" << std::setw(14) << "ms" << std::endl;
+    std::cout << std::setw(14) << "full" << std::setw(14) << std::fixed << std::setprecision(2) << full * 1000 << std::endl;
+    std::cout << std::setw(14) << "incremental" << std::setw(14) << incremental * 1000 << std::endl;
+}
+
+// Задержка операций во время контрольных точек: запись сегментов на потоке
+// обработчика под исключительной блокировкой (как было) против фонового потока
+void benchCheckpointLatency(size_t clientCount) {
+    const size_t threads = 8;
+    const size_t opsPerThread = 1000;
+    // Чуть раньше порога фоновой точки (1000 записей журнала), чтобы она не срабатывала сама
+    const size_t inlineInterval = 900;
+    std::cout << "=== Checkpoint latency: " << clientCount << " clients, " << threads << " threads x "
+              << opsPerThread << " deposits ===" << std::endl;
+
+    auto run = [&](bool inlineSave) {
+        std::string filename = kBenchDir + (inlineSave ? "/checkpoint_inline.dat" : "/checkpoint_background.dat");
+        writeSnapshot(filename, clientCount, true);
+
+        std::vector<double> latencies;
+        {
+            QuietOutput quiet;
+            Database db(filename);
+            db.saveToFile(); // раскладка по сегментам - вне замера
+
+            std::vector<std::vector<double>> perThread(threads);
+            std::atomic<size_t> done{0};
+            std::vector<std::thread> workers;
+            for (size_t t = 0; t < threads; t++) {
+                workers.emplace_back([&, t]() {
+                    perThread[t].reserve(opsPerThread);
+                    for (size_t i = 0; i < opsPerThread; i++) {
+                        std::string number = "ACC" + std::to_string(1000000 + (t * opsPerThread + i) * 7919 % clientCount) + "_SAV_1";
+                        auto start = std::chrono::steady_clock::now();
+                        db.deposit(number, Money::fromUnits(1), "Bench");
+                        if (inlineSave && ++done % inlineInterval == 0) {
+                            db.saveToFile();
+                        }
+                        perThread[t].push_back(secondsSince(start) * 1e6);
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            for (const auto& chunk : perThread) {
+                latencies.insert(latencies.end(), chunk.begin(), chunk.end());
+            }
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << std::setw(12) << (inlineSave ? "inline" : "background")
+                  << std::setw(12) << std::fixed << std::setprecision(0) << latencies[latencies.size() / 2]
+                  << std::setw(12) << latencies[latencies.size() * 99 / 100]
+                  << std::setw(12) << latencies.back() << std::endl;
+    };
+
+    std::cout << std::setw(12) << "checkpoint" << std::setw(12) << "p50, us" << std::setw(12) << "p99, us"
+              << std::setw(12) << "max, us" << std::endl;
+    run(true);
+    run(false);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string scenario = argc > 1 ? argv[1] : "all";
+    size_t clientCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+
+    std::filesystem::remove_all(kBenchDir);
+    std::filesystem::create_directories(kBenchDir);
+
+    if (scenario == "load" || scenario == "all") {
+        benchSnapshotLoad(clientCount ? clientCount : 1000000);
+    }
+    if (scenario == "passport" || scenario == "all") {
+        benchPassportCheck(clientCount ? clientCount : 10000000);
+    }
+    if (scenario == "hot" || scenario == "all") {
+        benchHotAccount(clientCount ? clientCount : 100000);
+    }
+    if (scenario == "approval" || scenario == "all") {
+        benchPendingApprovals(clientCount ? clientCount : 1000);
+    }
+    if (scenario == "ids" || scenario == "all") {
+        benchIdGeneration(clientCount ? clientCount : 200000);
+    }
+    if (scenario == "save" || scenario == "all") {
+        benchIncrementalSave(clientCount ? clientCount : 200000);
+    }
+    if (scenario == "checkpoint" || scenario == "all") {
+        benchCheckpointLatency(clientCount ? clientCount : 200000);
+    }
+
+    std::filesystem::remove_all(kBenchDir);
+    return 0;
+}
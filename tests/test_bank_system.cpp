@@ -1,8 +1,10 @@
 #include <gtest/gtest.h>
 #include <thread>
+#include <atomic>
 #include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <cstdio>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -10,11 +12,25 @@
 #include <iostream>
 #include <vector>
 #include <sstream>
+#include <cerrno>
+#include <fstream>
+#include <unordered_set>
 #include "../src/server.h"
 #include "../src/client.h"
 #include "../src/database.h"
 #include "../src/account.h"
 #include "../src/crypto.h"
+#include "../src/protocol.h"
+#include "../src/journal.h"
+#include "../src/snapshot.h"
+#include "../src/approval_store.h"
+#include "../src/timer_wheel.h"
+#include "../src/approval_rules.h"
+#include "../src/id_generator.h"
+#include "../src/account_id_allocator.h"
+#include "../src/crc32c.h"
+#include "../src/durable_file.h"
+#include <filesystem>
 
 class BankSystemTest : public ::testing::Test {
 protected:
@@ -47,7 +63,7 @@ protected:
         client.passwordHash = Crypto::hashPassword("testpass");
         client.status = ClientStatus::VERIFIED;
         
-        Account acc("TEST001_SAV_1", AccountType::SAVINGS, 100000.0);
+        Account acc("TEST001_SAV_1", AccountType::SAVINGS, Money::fromUnits(100000));
         client.accounts.push_back(acc);
         
         db.addClient(client);
@@ -61,7 +77,7 @@ protected:
         superUser.passwordHash = Crypto::hashPassword("superpass");
         superUser.status = ClientStatus::VERIFIED;
         
-        Account superAcc("SUPER_ACC", AccountType::CHECKING, 0.0);
+        Account superAcc("SUPER_ACC", AccountType::CHECKING, Money());
         superUser.accounts.push_back(superAcc);
         
         db.addClient(superUser);
@@ -76,10 +92,10 @@ protected:
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     
-    std::string sendCommandAndReadResponse(const std::string& command, int port = 9090) {
+    int connectToServer(int port) {
         int sockfd = socket(AF_INET, SOCK_STREAM, 0);
         if (sockfd < 0) {
-            return "SOCKET_ERROR";
+            return -1;
         }
         
         sockaddr_in server_addr{};
@@ -94,10 +110,19 @@ protected:
         
         if (connect(sockfd, (sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
             close(sockfd);
+            return -1;
+        }
+        return sockfd;
+    }
+    
+    std::string sendCommandAndReadResponse(const std::string& command, int port = 9090) {
+        int sockfd = connectToServer(port);
+        if (sockfd < 0) {
             return "CONNECT_ERROR";
         }
         
-        std::string welcome_message = readSocketResponse(sockfd);
+        MessageBuffer buffer;
+        std::string welcome_message = readSocketResponse(sockfd, buffer);
         
         // Отправляем команду
         std::string cmd = command + "\n";
@@ -107,35 +132,26 @@ protected:
         }
         
         // Ответ на команду
-        std::string response = readSocketResponse(sockfd);
+        std::string response = readSocketResponse(sockfd, buffer);
         
         close(sockfd);
         return response;
     }
     
-    std::string readSocketResponse(int sockfd) {
+    // Читает ровно один кадр ответа; лишние байты остаются в buffer
+    std::string readSocketResponse(int sockfd, MessageBuffer& buffer) {
         std::string response;
-        char buffer[256];
+        char chunk[256];
         
-        // Читаем все доступные данные с таймаутом
-        while (true) {
-            memset(buffer, 0, sizeof(buffer));
-            int bytes_read = recv(sockfd, buffer, sizeof(buffer) - 1, 0);
-            
-            if (bytes_read > 0) {
-                response.append(buffer, bytes_read);
-                // Проверяем, есть ли еще данные для чтения
-                timeval timeout{0, 100000}; // 100ms
-                setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-                
-                bytes_read = recv(sockfd, buffer, sizeof(buffer) - 1, 0);
-                if (bytes_read <= 0) {
-                    break;
-                }
-                response.append(buffer, bytes_read);
-            } else {
-                break;
+        while (!buffer.nextFrame(response)) {
+            int bytes_read = recv(sockfd, chunk, sizeof(chunk), 0);
+            if (bytes_read < 0 && errno == EINTR) {
+                continue;
             }
+            if (bytes_read <= 0) {
+                return "";
+            }
+            buffer.append(chunk, bytes_read);
         }
         
         return response;
@@ -143,26 +159,13 @@ protected:
     
     // Вспомогательная функция для отправки нескольких команд в одной сессии
     std::vector<std::string> sendMultipleCommands(const std::vector<std::string>& commands, int port = 9090) {
-        int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        int sockfd = connectToServer(port);
         if (sockfd < 0) {
-            return {"SOCKET_ERROR"};
-        }
-        
-        sockaddr_in server_addr{};
-        server_addr.sin_family = AF_INET;
-        server_addr.sin_port = htons(port);
-        inet_pton(AF_INET, "127.0.0.1", &server_addr.sin_addr);
-        
-        timeval timeout{3, 0};
-        setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-        setsockopt(sockfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
-        
-        if (connect(sockfd, (sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-            close(sockfd);
             return {"CONNECT_ERROR"};
         }
         
-        readSocketResponse(sockfd);
+        MessageBuffer buffer;
+        readSocketResponse(sockfd, buffer);
         
         std::vector<std::string> responses;
         for (const auto& command : commands) {
@@ -172,11 +175,8 @@ protected:
                 break;
             }
             
-            std::string response = readSocketResponse(sockfd);
+            std::string response = readSocketResponse(sockfd, buffer);
             responses.push_back(response);
-            
-            // Пауза между командами
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
         }
         
         close(sockfd);
@@ -308,7 +308,7 @@ TEST_F(BankSystemTest, UserVerification) {
     // Извлекаем ID нового пользователя
     size_t acc_pos = reg_response.find("ACC");
     ASSERT_NE(acc_pos, std::string::npos) << "Should generate account ID";
-    std::string new_user_id = reg_response.substr(acc_pos, 7);
+    std::string new_user_id = reg_response.substr(acc_pos, AccountIdAllocator::kLength);
     
     // Суперпользователь проверяет и верифицирует
     std::vector<std::string> commands = {
@@ -346,7 +346,7 @@ TEST_F(BankSystemTest, LargeTransferWithApproval) {
     receiver.passwordHash = Crypto::hashPassword("receiverpass");
     receiver.status = ClientStatus::VERIFIED;
     
-    Account rec_acc("RECEIVER1_SAV_1", AccountType::SAVINGS, 50000.0);
+    Account rec_acc("RECEIVER1_SAV_1", AccountType::SAVINGS, Money::fromUnits(50000));
     receiver.accounts.push_back(rec_acc);
     db.addClient(receiver);
     
@@ -354,7 +354,7 @@ TEST_F(BankSystemTest, LargeTransferWithApproval) {
     ClientData* sender = db.findClient("TEST001");
     ASSERT_NE(sender, nullptr);
     // Добавляем достаточно средств для перевода
-    sender->accounts[0].deposit(250000.0, "Test funding for large transfer");
+    sender->accounts[0].deposit(Money::fromUnits(250000), "Test funding for large transfer");
     db.updateClient(*sender);
     
     // Запускаем сервер после настройки данных
@@ -419,14 +419,14 @@ TEST_F(BankSystemTest, LargeTransferWithApproval) {
     ASSERT_NE(receiver_after, nullptr);
     
     // Проверяем изменения балансов
-    double sender_balance = sender_after->accounts[0].getBalance();
-    double receiver_balance = receiver_after->accounts[0].getBalance();
+    Money sender_balance = sender_after->accounts[0].getBalance();
+    Money receiver_balance = receiver_after->accounts[0].getBalance();
     
     // Исходные балансы: sender = 100000 + 250000 = 350000, receiver = 50000
     // После перевода 200000: sender = 150000, receiver = 250000
-    EXPECT_NEAR(sender_balance, 150000.0, 0.01)
+    EXPECT_EQ(sender_balance, Money::fromUnits(150000))
         << "Sender balance should be around 150000 after transfer";
-    EXPECT_NEAR(receiver_balance, 250000.0, 0.01)
+    EXPECT_EQ(receiver_balance, Money::fromUnits(250000))
         << "Receiver balance should be around 250000 after transfer";
 }
 
@@ -444,19 +444,19 @@ TEST_F(BankSystemTest, LargeTransferWithRejection) {
     receiver.passwordHash = Crypto::hashPassword("receiverpass2");
     receiver.status = ClientStatus::VERIFIED;
     
-    Account rec_acc("RECEIVER2_SAV_1", AccountType::SAVINGS, 50000.0);
+    Account rec_acc("RECEIVER2_SAV_1", AccountType::SAVINGS, Money::fromUnits(50000));
     receiver.accounts.push_back(rec_acc);
     db.addClient(receiver);
     
     // Увеличиваем баланс отправителя
     ClientData* sender = db.findClient("TEST001");
     ASSERT_NE(sender, nullptr);
-    sender->accounts[0].deposit(250000.0, "Test funding for rejection test");
+    sender->accounts[0].deposit(Money::fromUnits(250000), "Test funding for rejection test");
     db.updateClient(*sender);
     
     // Сохраняем исходные балансы
-    double initial_sender_balance = sender->accounts[0].getBalance();
-    double initial_receiver_balance = receiver.accounts[0].getBalance();
+    Money initial_sender_balance = sender->accounts[0].getBalance();
+    Money initial_receiver_balance = receiver.accounts[0].getBalance();
     
     // Запускаем сервер после настройки данных
     startTestServer();
@@ -519,9 +519,9 @@ TEST_F(BankSystemTest, LargeTransferWithRejection) {
     ASSERT_NE(sender_after, nullptr);
     ASSERT_NE(receiver_after, nullptr);
     
-    EXPECT_NEAR(sender_after->accounts[0].getBalance(), initial_sender_balance, 0.01)
+    EXPECT_EQ(sender_after->accounts[0].getBalance(), initial_sender_balance)
         << "Sender balance should not change after rejected transfer";
-    EXPECT_NEAR(receiver_after->accounts[0].getBalance(), initial_receiver_balance, 0.01)
+    EXPECT_EQ(receiver_after->accounts[0].getBalance(), initial_receiver_balance)
         << "Receiver balance should not change after rejected transfer";
 }
 
@@ -568,6 +568,1577 @@ TEST_F(BankSystemTest, InternalTransfer) {
     }
 }
 
+// Тест 14: Кадрирование - команда из двух кусков и длинный ответ HISTORY
+TEST_F(BankSystemTest, FramedProtocol) {
+    startTestServer();
+    
+    int sockfd = connectToServer(9090);
+    ASSERT_GE(sockfd, 0);
+    
+    MessageBuffer buffer;
+    readSocketResponse(sockfd, buffer);
+    
+    // Команда, разбитая на два send, должна собраться на сервере
+    std::string part1 = "LOGIN TEST0";
+    std::string part2 = "01 testpass\n";
+    send(sockfd, part1.c_str(), part1.length(), 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    send(sockfd, part2.c_str(), part2.length(), 0);
+    EXPECT_NE(readSocketResponse(sockfd, buffer).find("SUCCESS"), std::string::npos);
+    
+    for (int i = 0; i < 150; i++) {
+        std::string cmd = "DEPOSIT 1 \"Deposit number " + std::to_string(i) + "\"\n";
+        send(sockfd, cmd.c_str(), cmd.length(), 0);
+        readSocketResponse(sockfd, buffer);
+    }
+    
+    std::string cmd = "HISTORY 0\n";
+    send(sockfd, cmd.c_str(), cmd.length(), 0);
+    std::string history = readSocketResponse(sockfd, buffer);
+    
+    EXPECT_GT(history.size(), 4096u);
+    EXPECT_NE(history.find("Deposit number 0"), std::string::npos);
+    EXPECT_NE(history.find("Deposit number 149"), std::string::npos);
+    
+    close(sockfd);
+}
+
+// Тест 15: Конвейер - сотня команд одной записью, ответы в исходном порядке
+TEST_F(BankSystemTest, PipelinedCommands) {
+    startTestServer();
+    
+    int sockfd = connectToServer(9090);
+    ASSERT_GE(sockfd, 0);
+    
+    MessageBuffer buffer;
+    readSocketResponse(sockfd, buffer);
+    
+    std::string batch = "LOGIN TEST001 testpass\n";
+    for (int i = 0; i < 100; i++) {
+        batch += "DEPOSIT_TO 0 1 \"Batch settlement\"\n";
+    }
+    batch += "ACCOUNTS\n";
+    ASSERT_EQ(send(sockfd, batch.c_str(), batch.length(), 0), static_cast<ssize_t>(batch.length()));
+    
+    EXPECT_NE(readSocketResponse(sockfd, buffer).find("SUCCESS"), std::string::npos);
+    for (int i = 0; i < 100; i++) {
+        std::string response = readSocketResponse(sockfd, buffer);
+        ASSERT_NE(response.find("DEPOSIT successful"), std::string::npos)
+            << "Response " << i << " out of order. Got: " << response;
+    }
+    
+    std::string accounts = readSocketResponse(sockfd, buffer);
+    EXPECT_NE(accounts.find("$100100"), std::string::npos)
+        << "ACCOUNTS should see all deposits. Got: " << accounts;
+    
+    close(sockfd);
+}
+
+// Тест 16: Операции пишутся в журнал и восстанавливаются без полной перезаписи базы
+TEST_F(BankSystemTest, JournalReplay) {
+    const std::string tricky = "Rent|1|DEPOSIT|999999|evil\\|\nnext";
+    {
+        Database db("test_data/accounts.dat");
+        ClientData* client = db.findClient("TEST001");
+        ASSERT_NE(client, nullptr);
+        
+        ASSERT_TRUE(db.deposit(client->accounts[0], Money::fromUnits(500), "Journaled deposit"));
+        ASSERT_TRUE(db.withdraw(client->accounts[0], Money::fromUnits(200), "Journaled withdrawal"));
+        ASSERT_TRUE(db.addAccountToClient("TEST001", Account("TEST001_CHK_2", AccountType::CHECKING, Money())));
+        
+        // Описание с '|' и переводом строки не сдвигает сумму и получателя в записи
+        ASSERT_TRUE(db.transfer("TEST001_SAV_1", "SUPER_ACC", Money::fromUnits(50), tricky));
+        ASSERT_TRUE(db.transferBatch("TEST001_SAV_1", {{"SUPER_ACC", Money::fromUnits(3), tricky}}, true));
+        ASSERT_TRUE(db.deposit("SUPER_ACC", Money::fromUnits(7), tricky));
+    }
+    
+    // Новый экземпляр видит операции из журнала
+    Database db("test_data/accounts.dat");
+    ClientData* client = db.findClient("TEST001");
+    ASSERT_NE(client, nullptr);
+    ASSERT_EQ(client->accounts.size(), 2u);
+    EXPECT_EQ(client->accounts[0].getBalance(), Money::fromUnits(100247));
+    ASSERT_EQ(client->accounts[0].getTransactionHistory().size(), 4u);
+    EXPECT_EQ(client->accounts[0].getTransactionHistory()[0].description, "Journaled deposit");
+    EXPECT_EQ(client->accounts[0].getTransactionHistory()[2].description, tricky);
+    EXPECT_EQ(client->accounts[0].getTransactionHistory()[3].description, tricky);
+    EXPECT_EQ(client->accounts[0].getTransactionHistory()[3].targetAccount, "SUPER_ACC");
+    const ClientData* officer = db.findClient("SUPER001");
+    ASSERT_NE(officer, nullptr);
+    EXPECT_EQ(officer->accounts[0].getBalance(), Money::fromUnits(60));
+    ASSERT_EQ(officer->accounts[0].getTransactionHistory().size(), 3u);
+    EXPECT_EQ(officer->accounts[0].getTransactionHistory()[2].description, tricky);
+    EXPECT_EQ(officer->accounts[0].getTransactionHistory()[2].amount, Money::fromUnits(7));
+    
+    // Контрольная точка переносит журнал в основной файл и обнуляет его
+    ASSERT_TRUE(db.saveToFile());
+    std::ifstream journal("test_data/accounts.dat.journal", std::ios::binary | std::ios::ate);
+    EXPECT_EQ(journal.tellg(), 0);
+    
+    Database reloaded("test_data/accounts.dat");
+    EXPECT_EQ(reloaded.findClient("TEST001")->accounts[0].getBalance(), Money::fromUnits(100247));
+    EXPECT_EQ(reloaded.findClient("TEST001")->accounts[0].getTransactionHistory().size(), 4u);
+    
+    // Журнал недоступен для записи: отказавшая операция не меняет ни баланс, ни историю
+    journal.close();
+    std::remove("test_data/accounts.dat.journal");
+    ASSERT_TRUE(std::filesystem::create_directory("test_data/accounts.dat.journal"));
+    EXPECT_FALSE(reloaded.deposit("TEST001_SAV_1", Money::fromUnits(5), "Lost"));
+    EXPECT_FALSE(reloaded.withdraw("TEST001_SAV_1", Money::fromUnits(5), "Lost"));
+    EXPECT_FALSE(reloaded.transfer("TEST001_SAV_1", "SUPER_ACC", Money::fromUnits(5), "Lost"));
+    std::vector<bool> applied;
+    EXPECT_FALSE(reloaded.transferBatch("TEST001_SAV_1", {{"SUPER_ACC", Money::fromUnits(5), "Lost"}}, false, &applied));
+    EXPECT_EQ(applied, std::vector<bool>{false});
+    EXPECT_EQ(reloaded.findClient("TEST001")->accounts[0].getBalance(), Money::fromUnits(100247));
+    EXPECT_EQ(reloaded.findClient("TEST001")->accounts[0].getTransactionHistory().size(), 4u);
+    EXPECT_EQ(reloaded.findClient("SUPER001")->accounts[0].getBalance(), Money::fromUnits(60));
+    EXPECT_EQ(reloaded.findClient("SUPER001")->accounts[0].getTransactionHistory().size(), 3u);
+    
+    ASSERT_TRUE(std::filesystem::remove("test_data/accounts.dat.journal"));
+    EXPECT_TRUE(reloaded.deposit("TEST001_SAV_1", Money::fromUnits(5), "Journal is back"));
+    EXPECT_EQ(reloaded.findClient("TEST001")->accounts[0].getBalance(), Money::fromUnits(100252));
+}
+
+// Тест 17: Параллельные записи в журнал фиксируются группами и не теряются
+TEST_F(BankSystemTest, JournalGroupCommit) {
+    const int threadCount = 8;
+    const int recordsPerThread = 50;
+    {
+        Journal journal("test_data/group.journal", "test-key");
+        ASSERT_TRUE(journal.reset());
+        
+        std::vector<std::thread> writers;
+        std::vector<int> failures(threadCount, 0);
+        for (int t = 0; t < threadCount; t++) {
+            writers.emplace_back([&journal, &failures, t]() {
+                for (int i = 0; i < recordsPerThread; i++) {
+                    if (!journal.append("TXN|" + std::to_string(t) + "|" + std::to_string(i) + "|")) {
+                        failures[t]++;
+                    }
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        
+        for (int t = 0; t < threadCount; t++) {
+            EXPECT_EQ(failures[t], 0);
+        }
+        // Вернувшийся append означает, что запись уже на диске
+        EXPECT_EQ(journal.recordCount(), static_cast<size_t>(threadCount * recordsPerThread));
+    }
+    
+    Journal reopened("test_data/group.journal", "test-key");
+    std::vector<int> seen(threadCount, 0);
+    ASSERT_TRUE(reopened.replay([&seen](const std::string& record) {
+        seen[std::stoi(record.substr(4))]++;
+    }));
+    for (int t = 0; t < threadCount; t++) {
+        EXPECT_EQ(seen[t], recordsPerThread);
+    }
+}
+
+// Тест 18: База сохраняется бинарным снимком, текстовый формат доступен для выгрузки
+TEST_F(BankSystemTest, BinarySnapshot) {
+    {
+        Database db("test_data/accounts.dat");
+        ClientData* client = db.findClient("TEST001");
+        ASSERT_NE(client, nullptr);
+        ASSERT_TRUE(db.deposit(client->accounts[0], Money::fromCents(123456), "Snapshot deposit"));
+        ASSERT_TRUE(db.saveToFile());
+        ASSERT_TRUE(db.exportToText("test_data/export.txt"));
+    }
+    
+    MappedFile file;
+    ASSERT_TRUE(file.open("test_data/accounts.dat"));
+    EXPECT_TRUE(Snapshot::isSnapshot(file.data(), file.size()));
+    // Строки в пуле зашифрованы
+    EXPECT_EQ(std::string(file.data(), file.size()).find("Test User"), std::string::npos);
+    
+    Database reloaded("test_data/accounts.dat");
+    ClientData* client = reloaded.findClient("TEST001");
+    ASSERT_NE(client, nullptr);
+    EXPECT_EQ(client->fullName, "Test User");
+    EXPECT_EQ(client->accounts[0].getBalance(), Money::fromCents(10123456));
+    ASSERT_EQ(client->accounts[0].getTransactionHistory().size(), 1u);
+    EXPECT_EQ(client->accounts[0].getTransactionHistory()[0].description, "Snapshot deposit");
+    
+    // Повреждённый снимок отвергается, а не читается за пределами файла
+    std::string damaged(file.data(), file.size());
+    damaged.resize(damaged.size() / 2);
+    std::unordered_map<std::string, ClientData> clients;
+    uint64_t lsn = 0;
+    WorkerPool pool(1);
+    EXPECT_FALSE(Snapshot::load(damaged.data(), damaged.size(), "bank-system-key-2024", pool, clients, lsn));
+    
+    // Импорт текстовой выгрузки в чистую базу
+    Database imported("test_data/imported.dat");
+    ASSERT_TRUE(imported.importFromText("test_data/export.txt"));
+    ASSERT_NE(imported.findClient("SUPER001"), nullptr);
+    EXPECT_EQ(imported.findClient("TEST001")->accounts[0].getBalance(), Money::fromCents(10123456));
+}
+
+// Тест 19: Параллельная загрузка даёт ту же базу, что и последовательная
+TEST_F(BankSystemTest, ParallelSnapshotLoad) {
+    {
+        Database db("test_data/accounts.dat");
+        for (int i = 0; i < 300; i++) {
+            ClientData client;
+            client.accountId = "PAR" + std::to_string(1000 + i);
+            client.fullName = "Parallel Client " + std::to_string(i);
+            client.birthDate = "1990-01-01";
+            client.passportData = "P" + std::to_string(i);
+            client.passwordHash = Crypto::hashPassword("pass");
+            client.status = ClientStatus::VERIFIED;
+            client.accounts.push_back(Account(client.accountId + "_SAV_1", AccountType::SAVINGS, Money::fromUnits(i)));
+            ASSERT_TRUE(db.addClient(client));
+        }
+        ASSERT_TRUE(db.exportToText("test_data/legacy.dat"));
+    }
+    
+    for (const std::string& file : {std::string("test_data/accounts.dat"), std::string("test_data/legacy.dat")}) {
+        Database::setLoadThreads(1);
+        Database sequential(file);
+        Database::setLoadThreads(4);
+        Database parallel(file);
+        Database::setLoadThreads(0);
+        
+        ASSERT_EQ(parallel.getClientCount(), 302u) << file;
+        EXPECT_EQ(parallel.getClientCount(), sequential.getClientCount());
+        EXPECT_EQ(parallel.getTotalBalance(), sequential.getTotalBalance());
+        ClientData* client = parallel.findClient("PAR1299");
+        ASSERT_NE(client, nullptr);
+        EXPECT_EQ(client->fullName, "Parallel Client 299");
+        EXPECT_EQ(client->accounts[0].getBalance(), Money::fromUnits(299));
+    }
+}
+
+// Тест 20: Счёт находится по номеру через индекс, перевод можно адресовать номеру счёта
+TEST_F(BankSystemTest, AccountNumberIndex) {
+    {
+        Database db("test_data/accounts.dat");
+        ClientData* owner = nullptr;
+        Account* account = nullptr;
+        ASSERT_TRUE(db.findAccount("SUPER_ACC", &owner, &account));
+        EXPECT_EQ(owner->accountId, "SUPER001");
+        EXPECT_EQ(account->getNumber(), "SUPER_ACC");
+        
+        // Новый счёт сразу доступен по номеру, повтор номера в другой записи отвергается
+        ASSERT_TRUE(db.addAccountToClient("TEST001", Account("TEST001_CHK_2", AccountType::CHECKING, Money())));
+        ASSERT_TRUE(db.findAccount("TEST001_CHK_2", &owner, &account));
+        EXPECT_EQ(owner->accountId, "TEST001");
+        EXPECT_EQ(account, &owner->accounts[1]);
+        EXPECT_FALSE(db.addAccountToClient("SUPER001", Account("TEST001_CHK_2", AccountType::CHECKING, Money())));
+        
+        ASSERT_TRUE(db.removeClient("SUPER001"));
+        EXPECT_FALSE(db.findAccount("SUPER_ACC"));
+    }
+    
+    // После перезагрузки индекс восстановлен из снимка и журнала
+    Database reloaded("test_data/accounts.dat");
+    EXPECT_TRUE(reloaded.findAccount("TEST001_CHK_2"));
+    EXPECT_FALSE(reloaded.findAccount("SUPER_ACC"));
+    
+    ASSERT_TRUE(reloaded.addAccountToClient("TEST001", Account("TEST001_DEP_3", AccountType::DEPOSIT, Money())));
+    
+    startTestServer();
+    std::vector<std::string> responses = sendMultipleCommands({
+        "LOGIN TEST001 testpass",
+        "TRANSFER TEST001_DEP_3 250 \"By number\"",
+        "TRANSFER NO_SUCH_ACC 1"
+    });
+    ASSERT_EQ(responses.size(), 3u);
+    EXPECT_NE(responses[1].find("TRANSFER successful"), std::string::npos) << responses[1];
+    EXPECT_NE(responses[2].find("Target account not found"), std::string::npos) << responses[2];
+}
+
+// Тест 21: Индекс паспортов следует за добавлением, изменением и удалением клиентов
+TEST_F(BankSystemTest, PassportIndex) {
+    {
+        Database db("test_data/accounts.dat");
+        EXPECT_TRUE(db.isPassportExists("1234567890"));
+        EXPECT_FALSE(db.isPassportExists("5555555555"));
+        
+        ClientData client = *db.findClient("TEST001");
+        client.passportData = "5555555555";
+        ASSERT_TRUE(db.updateClient(client));
+        EXPECT_FALSE(db.isPassportExists("1234567890"));
+        EXPECT_TRUE(db.isPassportExists("5555555555"));
+        
+        ASSERT_TRUE(db.removeClient("SUPER001"));
+        EXPECT_FALSE(db.isPassportExists("SUPER001"));
+    }
+    
+    Database reloaded("test_data/accounts.dat");
+    EXPECT_TRUE(reloaded.isPassportExists("5555555555"));
+    EXPECT_FALSE(reloaded.isPassportExists("1234567890"));
+    EXPECT_FALSE(reloaded.isPassportExists("SUPER001"));
+}
+
+// Тест 22: Встречные переводы и пополнения из нескольких потоков не теряют и не создают денег
+TEST_F(BankSystemTest, ConcurrentTransfers) {
+    const int threads = 4;
+    const int rounds = 25;
+    {
+        Database db("test_data/accounts.dat");
+        ASSERT_TRUE(db.addAccountToClient("SUPER001", Account("SUPER_SAV_2", AccountType::SAVINGS, Money())));
+        ASSERT_TRUE(db.deposit("SUPER_SAV_2", Money::fromUnits(50000), "Initial"));
+        Money before = db.getTotalBalance();
+        
+        // Чётные потоки переводят в одну сторону, нечётные - навстречу
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&db, t]() {
+                std::string from = t % 2 ? "SUPER_SAV_2" : "TEST001_SAV_1";
+                std::string to = t % 2 ? "TEST001_SAV_1" : "SUPER_SAV_2";
+                for (int i = 0; i < rounds; i++) {
+                    db.transfer(from, to, Money::fromUnits(10), "Cross");
+                    db.deposit(to, Money::fromUnits(1), "Top up");
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        
+        EXPECT_EQ(db.getTotalBalance(), before + Money::fromUnits(threads * rounds));
+    }
+    
+    // Журнал, записанный параллельно, воспроизводится в тот же итог
+    Database reloaded("test_data/accounts.dat");
+    Account* test = nullptr;
+    Account* super = nullptr;
+    ASSERT_TRUE(reloaded.findAccount("TEST001_SAV_1", nullptr, &test));
+    ASSERT_TRUE(reloaded.findAccount("SUPER_SAV_2", nullptr, &super));
+    EXPECT_EQ(test->getBalance(), Money::fromUnits(100000 + threads / 2 * rounds));
+    EXPECT_EQ(super->getBalance(), Money::fromUnits(50000 + threads / 2 * rounds));
+}
+
+// Тест 23: Суммы в копейках - точный разбор, форматирование и контроль переполнения
+TEST_F(BankSystemTest, MoneyArithmetic) {
+    Money amount;
+    ASSERT_TRUE(Money::parse("1234.5", amount));
+    EXPECT_EQ(amount, Money::fromCents(123450));
+    EXPECT_EQ(amount.toString(), "1234.50");
+    ASSERT_TRUE(Money::parse("-0.05", amount));
+    EXPECT_EQ(amount.toString(), "-0.05");
+    
+    // Экспонента, лишние знаки после копеек и мусор в конце отвергаются
+    for (const char* bad : {"", "-", ".5", "12.", "1e3", "1.005", "10abc", " 10", "99999999999999999"}) {
+        EXPECT_FALSE(Money::parse(bad, amount)) << bad;
+    }
+    EXPECT_THROW(Money::parse("abc"), std::invalid_argument);
+    
+    // Десять раз по 0.1 - ровно рубль, в отличие от double
+    Money sum;
+    for (int i = 0; i < 10; i++) {
+        sum += Money::fromCents(10);
+    }
+    EXPECT_EQ(sum, Money::fromUnits(1));
+    
+    Money max = Money::fromCents(INT64_MAX);
+    EXPECT_THROW(max + Money::fromCents(1), std::overflow_error);
+    EXPECT_FALSE(Money::add(max, Money::fromCents(1), amount));
+    EXPECT_EQ(Money::fromCents(INT64_MIN).toString(), "-92233720368547758.08");
+    
+    // Старые файлы хранили double
+    EXPECT_EQ(Money::parseLegacy("1234.5600000000001"), Money::fromCents(123456));
+    EXPECT_EQ(Money::parseLegacy("1.5e+06"), Money::fromUnits(1500000));
+    
+    // Переполнение баланса - отказ операции без изменения счёта
+    Account account("OVERFLOW_1", AccountType::SAVINGS, max);
+    EXPECT_FALSE(account.deposit(Money::fromCents(1)));
+    EXPECT_EQ(account.getBalance(), max);
+    EXPECT_TRUE(account.getTransactionHistory().empty());
+    
+    startTestServer();
+    std::vector<std::string> responses = sendMultipleCommands({
+        "LOGIN TEST001 testpass",
+        "DEPOSIT 0.10",
+        "DEPOSIT 0.20",
+        "DEPOSIT 1.005",
+        "ACCOUNTS"
+    });
+    ASSERT_EQ(responses.size(), 5u);
+    EXPECT_NE(responses[3].find("Invalid amount"), std::string::npos) << responses[3];
+    EXPECT_NE(responses[4].find("$100000.30"), std::string::npos) << responses[4];
+}
+
+// Тест 24: Один счёт из многих потоков без блокировок - баланс точный, лимит не пробит
+TEST_F(BankSystemTest, LockFreeAccountOperations) {
+    const int threads = 8;
+    const int rounds = 2000;
+    Account account("HOT_1", AccountType::CHECKING, Money());
+    account.setCreditLimit(Money::fromUnits(100));
+    
+    // Пополнения идут вперемешку со списаниями, которые упираются в кредитный лимит
+    std::atomic<int> withdrawn(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&account, &withdrawn, t]() {
+            for (int i = 0; i < rounds; i++) {
+                if (t % 2) {
+                    account.deposit(Money::fromCents(1));
+                } else if (account.withdraw(Money::fromCents(3))) {
+                    withdrawn++;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    int deposits = threads / 2 * rounds;
+    EXPECT_EQ(account.getBalance(), Money::fromCents(deposits - 3 * withdrawn.load()));
+    EXPECT_GE(account.getBalance(), -account.getCreditLimit());
+    
+    const TransactionLog& history = account.getTransactionHistory();
+    ASSERT_EQ(history.size(), static_cast<size_t>(deposits + withdrawn.load()));
+    Money total;
+    size_t counted = 0;
+    for (const Transaction& txn : history) {
+        total += txn.amount;
+        counted++;
+    }
+    EXPECT_EQ(counted, history.size());
+    EXPECT_EQ(total, account.getBalance());
+}
+
+// Тест 25: Перевод - одна запись журнала; переводы по кольцу счетов из разных потоков
+TEST_F(BankSystemTest, TransferEngine) {
+    const std::vector<std::string> ring = {"TEST001_SAV_1", "SUPER_ACC", "SUPER_SAV_2"};
+    const int rounds = 20;
+    {
+        Database db("test_data/accounts.dat");
+        ASSERT_TRUE(db.addAccountToClient("SUPER001", Account("SUPER_SAV_2", AccountType::SAVINGS, Money())));
+        ASSERT_TRUE(db.deposit("SUPER_ACC", Money::fromUnits(100), "Initial deposit"));
+        ASSERT_TRUE(db.deposit("SUPER_SAV_2", Money::fromUnits(100), "Initial deposit"));
+        ASSERT_TRUE(db.saveToFile());
+        
+        // Каждый поток переводит по кругу со своего места: наборы счетов пересекаются
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < ring.size(); t++) {
+            workers.emplace_back([&db, &ring, t]() {
+                for (int i = 0; i < rounds; i++) {
+                    size_t from = (t + i) % ring.size();
+                    size_t to = (from + 1) % ring.size();
+                    db.transfer(ring[from], ring[to], Money::fromUnits(1), "Ring");
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        
+        // Недостаток средств и неположительная сумма не оставляют следов
+        EXPECT_FALSE(db.transfer("SUPER_ACC", "TEST001_SAV_1", Money::fromUnits(1000000)));
+        EXPECT_FALSE(db.transfer("TEST001_SAV_1", "SUPER_ACC", Money()));
+        EXPECT_EQ(db.getTotalBalance(), Money::fromUnits(100200));
+    }
+    
+    // Журнал: ровно одна запись на каждый перевод
+    std::ifstream journal("test_data/accounts.dat.journal");
+    std::string line;
+    size_t records = 0;
+    while (std::getline(journal, line)) {
+        records += !line.empty();
+    }
+    EXPECT_EQ(records, ring.size() * rounds);
+    
+    Database reloaded("test_data/accounts.dat");
+    EXPECT_EQ(reloaded.getTotalBalance(), Money::fromUnits(100200));
+    ClientData* owner = nullptr;
+    Account* account = nullptr;
+    ASSERT_TRUE(reloaded.findAccount("SUPER_SAV_2", &owner, &account));
+    // Пополнение из снимка плюс по одной записи на каждый входящий и исходящий перевод
+    EXPECT_EQ(account->getTransactionHistory().size(), 1u + 2 * rounds);
+    for (const Transaction& txn : account->getTransactionHistory()) {
+        EXPECT_TRUE(txn.description == "Initial deposit" || !txn.targetAccount.empty()) << txn.description;
+    }
+}
+
+// Тест 26: Пакетный перевод - атомарно или по строкам, одна запись журнала на пакет
+TEST_F(BankSystemTest, BatchTransfer) {
+    {
+        Database db("test_data/accounts.dat");
+        ASSERT_TRUE(db.addAccountToClient("SUPER001", Account("SUPER_SAV_2", AccountType::SAVINGS, Money())));
+        ASSERT_TRUE(db.saveToFile());
+        Money total = db.getTotalBalance();
+        
+        // Атомарный пакет с несуществующим получателем не проводит ничего
+        std::vector<bool> applied;
+        EXPECT_FALSE(db.transferBatch("TEST001_SAV_1", {
+            {"SUPER_ACC", Money::fromUnits(10), "Salary"},
+            {"NO_SUCH_ACC", Money::fromUnits(10), "Salary"},
+        }, true, &applied));
+        EXPECT_EQ(applied, std::vector<bool>({false, false}));
+        
+        // Атомарный пакет сверх остатка тоже
+        EXPECT_FALSE(db.transferBatch("SUPER_ACC", {
+            {"SUPER_SAV_2", Money::fromUnits(1), "Salary"},
+        }, true, &applied));
+        EXPECT_EQ(db.getTotalBalance(), total);
+        
+        EXPECT_TRUE(db.transferBatch("TEST001_SAV_1", {
+            {"SUPER_ACC", Money::fromUnits(100), "Salary"},
+            {"SUPER_SAV_2", Money::fromUnits(50), ""},
+        }, true, &applied));
+        EXPECT_EQ(applied, std::vector<bool>({true, true}));
+        
+        // По строкам: проводится то, на что хватает средств
+        EXPECT_FALSE(db.transferBatch("SUPER_ACC", {
+            {"SUPER_SAV_2", Money::fromUnits(60), "Bonus"},
+            {"SUPER_SAV_2", Money::fromUnits(60), "Bonus"},
+            {"TEST001_SAV_1", Money(), "Zero"},
+            {"TEST001_SAV_1", Money::fromUnits(40), "Refund"},
+        }, false, &applied));
+        EXPECT_EQ(applied, std::vector<bool>({true, false, false, true}));
+        EXPECT_EQ(db.getTotalBalance(), total);
+    }
+    
+    // Журнал: по записи на каждый пакет, в котором что-то проведено
+    std::ifstream journal("test_data/accounts.dat.journal");
+    std::string line;
+    size_t records = 0;
+    while (std::getline(journal, line)) {
+        records += !line.empty();
+    }
+    EXPECT_EQ(records, 2u);
+    
+    Money clientBalance;
+    {
+        Database reloaded("test_data/accounts.dat");
+        ClientData* owner = nullptr;
+        Account* account = nullptr;
+        ASSERT_TRUE(reloaded.findAccount("SUPER_ACC", &owner, &account));
+        EXPECT_EQ(account->getBalance(), Money::fromUnits(0));
+        ASSERT_TRUE(reloaded.findAccount("SUPER_SAV_2", &owner, &account));
+        EXPECT_EQ(account->getBalance(), Money::fromUnits(110));
+        ASSERT_EQ(account->getTransactionHistory().size(), 2u);
+        EXPECT_EQ(account->getTransactionHistory()[0].description, "Transfer from TEST001_SAV_1");
+        EXPECT_EQ(account->getTransactionHistory()[1].targetAccount, "SUPER_ACC");
+        ASSERT_TRUE(reloaded.findAccount("TEST001_SAV_1", &owner, &account));
+        clientBalance = account->getBalance();
+    }
+    
+    // Отрицательная строка не уменьшает сумму пакета: иначе крупный перевод
+    // прошёл бы мимо лимита и одобрения, а отрицательную строку отбросила бы база
+    startTestServer();
+    std::vector<std::string> responses = sendMultipleCommands({
+        "LOGIN TEST001 testpass",
+        "BATCH_TRANSFER 0 EACH SUPER_ACC 90000 Big SUPER_ACC -89999 Back",
+        "BATCH_TRANSFER 0 EACH SUPER_ACC 10 Ok SUPER_ACC 0 Zero",
+    });
+    ASSERT_EQ(responses.size(), 3u);
+    EXPECT_NE(responses[1].find("ERROR"), std::string::npos) << responses[1];
+    EXPECT_NE(responses[2].find("ERROR"), std::string::npos) << responses[2];
+    server_->stop();
+    server_thread_.join();
+    
+    Database after("test_data/accounts.dat");
+    ClientData* owner = nullptr;
+    Account* account = nullptr;
+    ASSERT_TRUE(after.findAccount("TEST001_SAV_1", &owner, &account));
+    EXPECT_EQ(account->getBalance(), clientBalance);
+}
+
+// Тест 27: Ожидание одобрения не занимает поток пула - отложенных операций больше, чем потоков
+TEST_F(BankSystemTest, ApprovalDoesNotPinWorkers) {
+    startTestServer();
+    
+    // Потоков в пуле не меньше 4: при блокирующем ожидании сотрудник не смог бы даже войти
+    const size_t clients = 6;
+    std::vector<int> sockets;
+    std::vector<MessageBuffer> buffers(clients);
+    for (size_t i = 0; i < clients; i++) {
+        int sockfd = connectToServer(9090);
+        ASSERT_GE(sockfd, 0);
+        sockets.push_back(sockfd);
+        readSocketResponse(sockfd, buffers[i]);
+        
+        // Команда после крупной операции ждёт решения и отвечает строго после неё
+        std::string batch = "LOGIN TEST001 testpass\nWITHDRAW 200000\nDEPOSIT 5\n";
+        ASSERT_EQ(send(sockfd, batch.c_str(), batch.length(), 0), static_cast<ssize_t>(batch.length()));
+        EXPECT_NE(readSocketResponse(sockfd, buffers[i]).find("SUCCESS"), std::string::npos);
+        EXPECT_NE(readSocketResponse(sockfd, buffers[i]).find("approval"), std::string::npos);
+    }
+    
+    std::vector<std::string> officer = {"SUPERLOGIN SUPER001 superpass", "PENDING_REQUESTS"};
+    for (size_t i = 0; i + 1 < clients; i++) {
+        officer.push_back("REJECT 0");
+    }
+    officer.push_back("APPROVE 0");
+    std::vector<std::string> responses = sendMultipleCommands(officer);
+    ASSERT_EQ(responses.size(), officer.size());
+    EXPECT_NE(responses[1].find("[" + std::to_string(clients - 1) + "]"), std::string::npos)
+        << "All parked operations should be pending. Got: " << responses[1];
+    for (size_t i = 2; i < responses.size(); i++) {
+        EXPECT_NE(responses[i].find("SUCCESS"), std::string::npos) << responses[i];
+    }
+    
+    // Пять отказов и одно одобрение, которое упирается в остаток на счёте
+    size_t rejected = 0, insufficient = 0;
+    for (size_t i = 0; i < clients; i++) {
+        std::string decision = readSocketResponse(sockets[i], buffers[i]);
+        rejected += decision.find("rejected by security") != std::string::npos;
+        insufficient += decision.find("insufficient funds") != std::string::npos;
+        EXPECT_NE(readSocketResponse(sockets[i], buffers[i]).find("DEPOSIT successful"), std::string::npos);
+        close(sockets[i]);
+    }
+    EXPECT_EQ(rejected, clients - 1);
+    EXPECT_EQ(insufficient, 1u);
+}
+
+// Тест 28: Хранилище запросов на одобрение - порядок поступления, поиск по id и номеру
+TEST_F(BankSystemTest, ApprovalStore) {
+    ApprovalStore store;
+    for (int i = 0; i < 5; i++) {
+        ApprovalRequest request;
+        request.requestId = "REQ" + std::to_string(i);
+        request.clientAccountId = "TEST001";
+        request.amount = Money::fromUnits(1000 * i);
+        request.status = "PENDING";
+        ASSERT_TRUE(store.add(request));
+    }
+    
+    ApprovalRequest duplicate;
+    duplicate.requestId = "REQ3";
+    EXPECT_FALSE(store.add(duplicate));
+    EXPECT_EQ(store.size(), 5u);
+    
+    // Удаление из середины не сдвигает id остальных, номера - сдвигает
+    ASSERT_TRUE(store.remove("REQ1"));
+    EXPECT_FALSE(store.remove("REQ1"));
+    EXPECT_EQ(store.find("REQ1"), nullptr);
+    ASSERT_NE(store.lookup("REQ3"), nullptr);
+    EXPECT_EQ(store.lookup("REQ3")->amount, Money::fromUnits(3000));
+    ASSERT_NE(store.lookup("1"), nullptr);
+    EXPECT_EQ(store.lookup("1")->requestId, "REQ2");
+    EXPECT_EQ(store.lookup("4"), nullptr);
+    EXPECT_EQ(store.lookup("-1"), nullptr);
+    EXPECT_EQ(store.lookup("REQ9"), nullptr);
+    
+    store.find("REQ4")->status = "APPROVED";
+    std::vector<std::string> order;
+    for (const auto& request : store) {
+        order.push_back(request.requestId + ":" + request.status);
+    }
+    EXPECT_EQ(order, std::vector<std::string>({"REQ0:PENDING", "REQ2:PENDING", "REQ3:PENDING", "REQ4:APPROVED"}));
+    
+    // Описание от клиента с '|' и переводом строки не подменяет поля в журнале одобрений
+    ApprovalRequest forged;
+    forged.requestId = "REQ5";
+    forged.clientAccountId = "TEST001";
+    forged.operationType = "TRANSFER";
+    forged.amount = Money::fromUnits(200000);
+    forged.targetAccount = "SUPER001";
+    forged.description = "x|0|PENDING|VICTIM_ACC|0|1|MINE|999999|y\\n";
+    forged.timestamp = 1700000000;
+    forged.status = "PENDING";
+    forged.sourceAccount = "TEST001_SAV_1";
+    forged.items.push_back(TransferItem{"SUPER_ACC", forged.amount, forged.description + "\nnext"});
+    std::string record;
+    ApprovalStore::serialize(forged, record);
+    std::stringstream ss(record);
+    ApprovalRequest parsed;
+    ASSERT_TRUE(ApprovalStore::parse(ss, parsed));
+    EXPECT_EQ(parsed.description, forged.description);
+    EXPECT_EQ(parsed.sourceAccount, "TEST001_SAV_1");
+    EXPECT_EQ(parsed.timestamp, forged.timestamp);
+    EXPECT_TRUE(parsed.atomic);
+    ASSERT_EQ(parsed.items.size(), 1u);
+    EXPECT_EQ(parsed.items[0].toNumber, "SUPER_ACC");
+    EXPECT_EQ(parsed.items[0].amount, Money::fromUnits(200000));
+    EXPECT_EQ(parsed.items[0].description, forged.description + "\nnext");
+}
+
+// Тест 29: Колесо таймеров - срабатывание по тикам, перенос со старших уровней, отмена
+TEST_F(BankSystemTest, TimerWheel) {
+    using std::chrono::milliseconds;
+    TimerWheel::Clock::time_point start{};
+    TimerWheel wheel(milliseconds(100), start);
+    
+    std::vector<std::string> fired;
+    wheel.schedule(milliseconds(250), [&]() { fired.push_back("short"); }, start);
+    wheel.schedule(std::chrono::seconds(30), [&]() { fired.push_back("approval"); }, start);
+    wheel.schedule(std::chrono::hours(1), [&]() { fired.push_back("idle"); }, start);
+    TimerWheel::TimerId cancelled = wheel.schedule(std::chrono::seconds(60), [&]() { fired.push_back("cancelled"); }, start);
+    EXPECT_EQ(wheel.size(), 4u);
+    
+    // Срок округляется вверх: 250 мс срабатывают на третьем тике, не раньше
+    EXPECT_EQ(wheel.advance(start + milliseconds(200)), 0u);
+    EXPECT_EQ(wheel.advance(start + milliseconds(300)), 1u);
+    EXPECT_EQ(fired, std::vector<std::string>({"short"}));
+    
+    EXPECT_TRUE(wheel.cancel(cancelled));
+    EXPECT_FALSE(wheel.cancel(cancelled));
+    EXPECT_EQ(wheel.size(), 2u);
+    
+    // 30 с - за пределами первого уровня (256 тиков), таймер переносится вниз
+    EXPECT_EQ(wheel.advance(start + milliseconds(29900)), 0u);
+    EXPECT_EQ(wheel.advance(start + std::chrono::seconds(30)), 1u);
+    EXPECT_EQ(fired.back(), "approval");
+    
+    // Большой скачок времени: истёкшие таймеры срабатывают один раз
+    EXPECT_EQ(wheel.advance(start + std::chrono::hours(2)), 1u);
+    EXPECT_EQ(fired, std::vector<std::string>({"short", "approval", "idle"}));
+    EXPECT_EQ(wheel.size(), 0u);
+    
+    // Таймер, поставленный из обработчика, срабатывает на следующем продвижении
+    auto later = start + std::chrono::hours(2);
+    wheel.schedule(milliseconds(0), [&]() {
+        wheel.schedule(milliseconds(100), [&]() { fired.push_back("nested"); }, later);
+    }, later);
+    EXPECT_EQ(wheel.advance(later + milliseconds(100)), 1u);
+    EXPECT_EQ(wheel.advance(later + milliseconds(200)), 1u);
+    EXPECT_EQ(fired.back(), "nested");
+}
+
+// Тест 30: Запрос на одобрение переживает перезапуск и выполняется после него
+TEST_F(BankSystemTest, ApprovalSurvivesRestart) {
+    startTestServer();
+    
+    int sockfd = connectToServer(9090);
+    ASSERT_GE(sockfd, 0);
+    MessageBuffer buffer;
+    readSocketResponse(sockfd, buffer);
+    std::string batch = "LOGIN TEST001 testpass\nDEPOSIT 100000\nTRANSFER SUPER_ACC 160000 recovered\n";
+    ASSERT_EQ(send(sockfd, batch.c_str(), batch.length(), 0), static_cast<ssize_t>(batch.length()));
+    EXPECT_NE(readSocketResponse(sockfd, buffer).find("SUCCESS"), std::string::npos);
+    EXPECT_NE(readSocketResponse(sockfd, buffer).find("DEPOSIT successful"), std::string::npos);
+    EXPECT_NE(readSocketResponse(sockfd, buffer).find("approval"), std::string::npos);
+    
+    // Остановка не отклоняет запрос: клиент узнаёт, что решение будет после перезапуска
+    server_->stop();
+    server_thread_.join();
+    EXPECT_NE(readSocketResponse(sockfd, buffer).find("stays pending"), std::string::npos);
+    close(sockfd);
+    
+    // Сбой посреди дописывания журнала одобрений: от второй записи - полстроки.
+    // Хвост отрезается, и CLOSE после перезапуска не склеивается с ним
+    {
+        std::ifstream journal("test_data/accounts.dat.approvals", std::ios::binary);
+        std::string line;
+        ASSERT_TRUE(std::getline(journal, line));
+        std::ofstream torn("test_data/accounts.dat.approvals", std::ios::binary | std::ios::app);
+        torn << line.substr(0, line.size() / 2);
+    }
+    
+    startTestServer();
+    std::vector<std::string> responses = sendMultipleCommands({"SUPERLOGIN SUPER001 superpass", "PENDING_REQUESTS", "APPROVE 0"});
+    ASSERT_EQ(responses.size(), 3u);
+    EXPECT_NE(responses[1].find("TRANSFER"), std::string::npos) << responses[1];
+    EXPECT_NE(responses[2].find("approved"), std::string::npos) << responses[2];
+    
+    // Решение записано: после второго перезапуска очередь пуста и перевод не повторяется
+    server_->stop();
+    server_thread_.join();
+    startTestServer();
+    responses = sendMultipleCommands({"SUPERLOGIN SUPER001 superpass", "PENDING_REQUESTS"});
+    EXPECT_NE(responses[1].find("No pending operation requests"), std::string::npos) << responses[1];
+    server_->stop();
+    server_thread_.join();
+    
+    Database db("test_data/accounts.dat");
+    ClientData* officer = db.findClient("SUPER001");
+    ASSERT_NE(officer, nullptr);
+    EXPECT_EQ(officer->accounts[0].getBalance(), Money::fromUnits(160000));
+    ClientData* client = db.findClient("TEST001");
+    ASSERT_NE(client, nullptr);
+    EXPECT_EQ(client->accounts[0].getBalance(), Money::fromUnits(40000));
+}
+
+// Тест 31: Правила автоодобрения - полосы сумм, доверенные получатели, возраст счёта, суточные лимиты, перезагрузка
+TEST_F(BankSystemTest, ApprovalRules) {
+    {
+        std::ofstream rules("test_data/accounts.dat.rules");
+        rules << "# доверенный получатель\n"
+              << "APPROVE op=TRANSFER trusted=SUPER_ACC,PAYROLL max_amount=500000\n"
+              << "REVIEW op=BATCH_TRANSFER\n"
+              << "APPROVE op=WITHDRAW,TRANSFER max_amount=300000 min_age_days=30 max_daily_count=3\n";
+    }
+    ApprovalRules rules;
+    ASSERT_TRUE(rules.load("test_data/accounts.dat.rules"));
+    EXPECT_EQ(rules.ruleCount(), 3u);
+    
+    auto operation = [](const std::string& type, const std::string& target, int64_t units) {
+        ApprovalRequest request;
+        request.clientAccountId = "TEST001";
+        request.operationType = type;
+        request.amount = Money::fromUnits(units);
+        request.items.push_back(TransferItem{target, request.amount, ""});
+        return request;
+    };
+    std::time_t now = 100 * 24 * 3600;
+    std::time_t oldAccount = now - 60 * 24 * 3600;
+    
+    size_t line = 0;
+    EXPECT_TRUE(rules.tryApprove(operation("TRANSFER", "SUPER_ACC", 400000), now, now, &line));
+    EXPECT_EQ(line, 2u);
+    EXPECT_FALSE(rules.tryApprove(operation("TRANSFER", "SUPER_ACC", 600000), oldAccount, now));
+    // Новый счёт: доверенных правил нет - только сотрудник
+    EXPECT_FALSE(rules.tryApprove(operation("TRANSFER", "OTHER", 200000), now, now));
+    EXPECT_FALSE(rules.tryApprove(operation("BATCH_TRANSFER", "SUPER_ACC", 200000), oldAccount, now));
+    
+    // Счётчик общий для всех правил: с доверенным переводом выше это четвёртое
+    // автоодобрение за сутки - оно идёт сотруднику; на следующие сутки счётчик сбрасывается
+    EXPECT_TRUE(rules.tryApprove(operation("WITHDRAW", "", 200000), oldAccount, now, &line));
+    EXPECT_EQ(line, 4u);
+    EXPECT_TRUE(rules.tryApprove(operation("TRANSFER", "OTHER", 200000), oldAccount, now));
+    EXPECT_FALSE(rules.tryApprove(operation("WITHDRAW", "", 200000), oldAccount, now));
+    EXPECT_TRUE(rules.tryApprove(operation("WITHDRAW", "", 200000), oldAccount, now + 24 * 3600));
+    
+    // Лимиты у каждого клиента свои: клиентов больше, чем полос счётчиков,
+    // и каждый получает все три автоодобрения, а четвёртое - нет
+    const int clientCount = 5000;
+    int approved = 0;
+    for (int round = 0; round < 4; round++) {
+        for (int c = 0; c < clientCount; c++) {
+            ApprovalRequest request = operation("WITHDRAW", "", 200000);
+            request.clientAccountId = "CLIENT" + std::to_string(c);
+            approved += rules.tryApprove(request, oldAccount, now + 2 * 24 * 3600);
+        }
+        EXPECT_EQ(approved, clientCount * std::min(round + 1, 3));
+    }
+    
+    // Ошибка в файле не сбрасывает действующие правила; исправленный файл подхватывается
+    {
+        std::ofstream broken("test_data/accounts.dat.rules");
+        broken << "APPROVE max_amount=abc\n";
+    }
+    EXPECT_FALSE(rules.reloadIfChanged());
+    EXPECT_EQ(rules.ruleCount(), 3u);
+    {
+        std::ofstream updated("test_data/accounts.dat.rules");
+        updated << "REVIEW\n";
+    }
+    EXPECT_TRUE(rules.reloadIfChanged());
+    EXPECT_EQ(rules.ruleCount(), 1u);
+    EXPECT_FALSE(rules.tryApprove(operation("TRANSFER", "SUPER_ACC", 400000), oldAccount, now));
+    
+    // Сервер применяет правила до очереди одобрения
+    {
+        std::ofstream serverRules("test_data/accounts.dat.rules");
+        serverRules << "APPROVE op=TRANSFER trusted=SUPER_ACC\n";
+    }
+    startTestServer();
+    std::vector<std::string> responses = sendMultipleCommands(
+        {"LOGIN TEST001 testpass", "DEPOSIT 100000", "TRANSFER SUPER_ACC 160000", "WITHDRAW 160000"});
+    ASSERT_EQ(responses.size(), 4u);
+    EXPECT_NE(responses[2].find("TRANSFER successful"), std::string::npos) << responses[2];
+    EXPECT_NE(responses[3].find("approval"), std::string::npos) << responses[3];
+}
+
+// Тест 32: Генератор id - фиксированная ширина, уникальность между потоками, возрастание в потоке
+TEST_F(BankSystemTest, IdGenerator) {
+    char formatted[IdGenerator::kLength];
+    IdGenerator::format("TXN", 0, formatted);
+    EXPECT_EQ(std::string(formatted, IdGenerator::kLength), "TXN000000000000");
+    IdGenerator::format("REQ", (uint64_t(1) << 60) - 1, formatted);
+    EXPECT_EQ(std::string(formatted, IdGenerator::kLength), "REQZZZZZZZZZZZZ");
+    
+    // Потоков больше, чем шардов: завершившиеся отдают шард следующим
+    const size_t rounds = 3, threads = 40, perThread = 2000;
+    std::vector<std::vector<std::string>> ids(rounds * threads);
+    for (size_t round = 0; round < rounds; round++) {
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&ids, round, t, threads, perThread]() {
+                auto& out = ids[round * threads + t];
+                for (size_t i = 0; i < perThread; i++) {
+                    out.push_back(IdGenerator::next("TXN"));
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+    
+    std::unordered_set<std::string> unique;
+    for (const auto& chunk : ids) {
+        for (size_t i = 0; i < chunk.size(); i++) {
+            ASSERT_EQ(chunk[i].size(), IdGenerator::kLength);
+            ASSERT_EQ(chunk[i].compare(0, 3, "TXN"), 0);
+            if (i > 0) {
+                ASSERT_LT(chunk[i - 1], chunk[i]) << "Ids of one thread must increase";
+            }
+            unique.insert(chunk[i]);
+        }
+    }
+    EXPECT_EQ(unique.size(), rounds * threads * perThread);
+    
+    // Операции счёта получают id нового формата
+    Account account("ID_TEST_1", AccountType::CHECKING);
+    ASSERT_TRUE(account.deposit(Money::fromUnits(10)));
+    EXPECT_EQ(account.getTransactionHistory().back().id.size(), IdGenerator::kLength);
+    
+    // Часы теста - системные со сдвигом. Сдвиг вперёд на час уводит их дальше
+    // отметок, оставленных серверами прошлых тестов
+    static std::atomic<int64_t> clockShiftMs{3600000};
+    auto testClockMs = []() -> uint64_t {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count() - 1704067200000 + clockShiftMs.load();
+    };
+    IdGenerator::setClock(testClockMs);
+    
+    // Без отметки исчерпанный счётчик ждёт часов, а не забегает вперёд: иначе
+    // процесс, перезапущенный через миллисекунды, повторил бы эти id
+    IdGenerator::setStateFile("");
+    uint64_t last = 0;
+    for (int i = 0; i < 200000; i++) {
+        last = IdGenerator::nextValue();
+    }
+    EXPECT_LE(last >> 19, testClockMs());
+    
+    // Часы переводят назад на минуту: выдача не ждёт, пока они догонят выданное,
+    // а время id не превышает отметки на диске
+    IdGenerator::setStateFile("test_data/accounts.dat.idclock");
+    uint64_t previous = IdGenerator::nextValue();
+    clockShiftMs -= 60000;
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < 20000; i++) {
+        uint64_t value = IdGenerator::nextValue();
+        ASSERT_GT(value, previous);
+        previous = value;
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(1));
+    uint64_t mark = 0;
+    {
+        std::ifstream markFile("test_data/accounts.dat.idclock");
+        ASSERT_TRUE(markFile >> mark);
+    }
+    EXPECT_LE(previous >> 19, mark);
+    
+    // Перезапуск при отставших часах: выдача продолжается выше отметки
+    IdGenerator::setStateFile("test_data/accounts.dat.idclock");
+    EXPECT_GT(IdGenerator::nextValue() >> 19, mark);
+    
+    // Без отметки исчерпанный счётчик тоже не ждёт часы, переведённые назад
+    IdGenerator::setStateFile("");
+    clockShiftMs -= 60000;
+    started = std::chrono::steady_clock::now();
+    for (int i = 0; i < 20000; i++) {
+        uint64_t value = IdGenerator::nextValue();
+        ASSERT_GT(value, previous);
+        previous = value;
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(1));
+    IdGenerator::setClock(nullptr);
+}
+
+// Тест 33: Номера клиентов - контрольная цифра, уникальность между потоками, продолжение после перезапуска
+TEST_F(BankSystemTest, AccountIdAllocator) {
+    EXPECT_EQ(AccountIdAllocator::format(1), "ACC0000000018");
+    EXPECT_FALSE(AccountIdAllocator::isMistyped("ACC0000000018"));
+    EXPECT_TRUE(AccountIdAllocator::isMistyped("ACC0000000019"));   // цифра
+    EXPECT_TRUE(AccountIdAllocator::isMistyped("ACC0000000108"));   // перестановка соседних
+    EXPECT_FALSE(AccountIdAllocator::isMistyped("ACC1234"));        // старый формат
+    EXPECT_FALSE(AccountIdAllocator::isMistyped("SUPER001"));
+    
+    std::vector<std::string> ids;
+    std::mutex idsMutex;
+    {
+        AccountIdAllocator allocator("test_data/accounts.dat.ids");
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 8; t++) {
+            workers.emplace_back([&]() {
+                for (int i = 0; i < 500; i++) {
+                    std::string id = allocator.allocate();
+                    std::lock_guard<std::mutex> lock(idsMutex);
+                    ids.push_back(id);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+    std::unordered_set<std::string> unique(ids.begin(), ids.end());
+    EXPECT_EQ(unique.size(), ids.size());
+    for (const auto& id : ids) {
+        ASSERT_EQ(id.size(), AccountIdAllocator::kLength);
+        ASSERT_FALSE(AccountIdAllocator::isMistyped(id)) << id;
+    }
+    
+    // После перезапуска выдача идёт с границы блока, выше всех прежних номеров
+    std::string highest = *std::max_element(ids.begin(), ids.end());
+    AccountIdAllocator restarted("test_data/accounts.dat.ids");
+    std::string next = restarted.allocate();
+    EXPECT_GT(next, highest);
+    EXPECT_EQ(unique.count(next), 0u);
+    
+    // Без файла границы номера загруженных клиентов не выдаются повторно
+    AccountIdAllocator lost("test_data/missing.ids");
+    lost.observe(AccountIdAllocator::format(5000));
+    EXPECT_EQ(lost.allocate(), AccountIdAllocator::format(5001));
+    
+    // Последний номер выдаётся, дальше - отказ, а не номер с переполнением
+    AccountIdAllocator full("test_data/full.ids");
+    full.observe(AccountIdAllocator::format(AccountIdAllocator::kMaxSequence - 1));
+    EXPECT_EQ(full.allocate(), AccountIdAllocator::format(AccountIdAllocator::kMaxSequence));
+    EXPECT_EQ(full.allocate(), "");
+    EXPECT_EQ(full.allocate(), "");
+    
+    // Регистрация выдаёт номер нового формата, войти с опечаткой нельзя
+    startTestServer();
+    std::string response = sendCommandAndReadResponse(
+        "REGISTER \"Allocator User\" \"1990-01-01\" \"2222222222\" \"allocpass\"");
+    size_t pos = response.find("ACC");
+    ASSERT_NE(pos, std::string::npos) << response;
+    std::string registered = response.substr(pos, AccountIdAllocator::kLength);
+    EXPECT_FALSE(AccountIdAllocator::isMistyped(registered));
+    std::string mistyped = registered;
+    mistyped.back() = mistyped.back() == '9' ? '0' : mistyped.back() + 1;
+    EXPECT_NE(sendCommandAndReadResponse("LOGIN " + mistyped + " allocpass").find("Invalid account ID"), std::string::npos);
+    EXPECT_NE(sendCommandAndReadResponse("LOGIN " + registered + " allocpass").find("SUCCESS"), std::string::npos);
+    
+    // Номера кончились: регистрация отклоняется, клиент не создаётся
+    server_->stop();
+    server_thread_.join();
+    {
+        std::ofstream ids("test_data/accounts.dat.ids", std::ios::trunc);
+        ids << AccountIdAllocator::kMaxSequence + 1 << "\n";
+    }
+    startTestServer();
+    response = sendCommandAndReadResponse("REGISTER \"Overflow User\" \"1990-01-01\" \"3333333333\" \"overflowpass\"");
+    EXPECT_NE(response.find("ERROR"), std::string::npos) << response;
+    server_->stop();
+    server_thread_.join();
+    Database db("test_data/accounts.dat");
+    EXPECT_FALSE(db.isPassportExists("3333333333"));
+    ClientData nameless;
+    EXPECT_FALSE(db.addClient(nameless));
+}
+
+// Тест 34: Сохранение переписывает только сегменты изменённых клиентов
+TEST_F(BankSystemTest, SegmentedSave) {
+    auto readFile = [](const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    };
+    auto writeFile = [](const std::string& path, const std::string& data) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << data;
+    };
+    auto segmentFile = [](size_t segment) {
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), ".seg.%02zu", segment);
+        return "test_data/accounts.dat" + std::string(suffix);
+    };
+    const int clientCount = 32;
+    
+    std::vector<std::string> before(Database::kSegments), saved(Database::kSegments);
+    std::string journalCopy;
+    {
+        Database db("test_data/accounts.dat");
+        for (int i = 0; i < clientCount; i++) {
+            ClientData client;
+            client.accountId = "SEG" + std::to_string(i);
+            client.fullName = "Segment Client " + std::to_string(i);
+            client.birthDate = "1990-01-01";
+            client.passportData = "S" + std::to_string(i);
+            client.passwordHash = Crypto::hashPassword("pass");
+            client.status = ClientStatus::VERIFIED;
+            client.accounts.push_back(Account(client.accountId + "_SAV_1", AccountType::SAVINGS, Money()));
+            ASSERT_TRUE(db.addClient(client));
+        }
+        // Регистрации лежат в журнале, сегменты пишет контрольная точка
+        ASSERT_TRUE(db.saveToFile());
+        for (size_t s = 0; s < Database::kSegments; s++) {
+            before[s] = readFile(segmentFile(s));
+            ASSERT_FALSE(before[s].empty()) << segmentFile(s);
+        }
+        
+        // Одна операция - один переписанный сегмент
+        ASSERT_TRUE(db.deposit("SEG0_SAV_1", Money::fromUnits(10), "Single"));
+        ASSERT_TRUE(db.saveToFile());
+        size_t changed = 0;
+        for (size_t s = 0; s < Database::kSegments; s++) {
+            std::string now = readFile(segmentFile(s));
+            changed += now != before[s];
+            before[s] = now;
+        }
+        EXPECT_EQ(changed, 1u);
+        
+        // Операции по всем клиентам; журнал запоминаем до контрольной точки
+        for (int i = 0; i < clientCount; i++) {
+            ASSERT_TRUE(db.deposit("SEG" + std::to_string(i) + "_SAV_1", Money::fromUnits(5), "Many"));
+        }
+        journalCopy = readFile("test_data/accounts.dat.journal");
+        ASSERT_FALSE(journalCopy.empty());
+        ASSERT_TRUE(db.saveToFile());
+        for (size_t s = 0; s < Database::kSegments; s++) {
+            saved[s] = readFile(segmentFile(s));
+        }
+    }
+    
+    // Сбой посреди сохранения: часть сегментов уже записана, остальные и журнал - прежние
+    size_t changed = 0, rolledBack = 0;
+    for (size_t s = 0; s < Database::kSegments; s++) {
+        if (saved[s] != before[s] && ++changed % 2 == 0) {
+            writeFile(segmentFile(s), before[s]);
+            rolledBack++;
+        }
+    }
+    ASSERT_GT(rolledBack, 0u);
+    ASSERT_LT(rolledBack, changed);
+    writeFile("test_data/accounts.dat.journal", journalCopy);
+    
+    // Каждый сегмент доигрывает только то, чего в нём нет: операции не теряются и не удваиваются
+    Database reloaded("test_data/accounts.dat");
+    for (int i = 0; i < clientCount; i++) {
+        ClientData* owner = nullptr;
+        Account* account = nullptr;
+        ASSERT_TRUE(reloaded.findAccount("SEG" + std::to_string(i) + "_SAV_1", &owner, &account));
+        EXPECT_EQ(account->getBalance(), Money::fromUnits(i == 0 ? 15 : 5)) << owner->accountId;
+        EXPECT_EQ(account->getTransactionHistory().size(), i == 0 ? 2u : 1u) << owner->accountId;
+    }
+    EXPECT_NE(reloaded.findClient("TEST001"), nullptr);
+}
+
+// Тест 35: Контрольная точка пишется в фоне, операции во время неё не теряются
+TEST_F(BankSystemTest, BackgroundCheckpoint) {
+    {
+        Journal journal("test_data/rotate.journal", "test-key");
+        ASSERT_TRUE(journal.append("A"));
+        ASSERT_TRUE(journal.rotate());
+        ASSERT_TRUE(journal.append("B"));
+        // Архив неудачной контрольной точки не затирается, а дополняется
+        ASSERT_TRUE(journal.rotate());
+        ASSERT_TRUE(journal.append("C"));
+        EXPECT_EQ(journal.recordCount(), 1u);
+    }
+    Journal reopened("test_data/rotate.journal", "test-key");
+    std::string order;
+    ASSERT_TRUE(reopened.replay([&order](const std::string& record) { order += record; }));
+    EXPECT_EQ(order, "ABC");
+    reopened.dropArchive();
+    order.clear();
+    ASSERT_TRUE(reopened.replay([&order](const std::string& record) { order += record; }));
+    EXPECT_EQ(order, "C");
+    
+    auto journalLines = []() {
+        std::ifstream journal("test_data/accounts.dat.journal");
+        std::string line;
+        size_t lines = 0;
+        while (std::getline(journal, line)) {
+            lines += !line.empty();
+        }
+        return lines;
+    };
+    auto archiveExists = []() {
+        return std::ifstream("test_data/accounts.dat.journal.checkpoint").good();
+    };
+    
+    const int threadCount = 4;
+    const int depositsPerThread = 300;
+    const size_t total = threadCount * depositsPerThread;
+    {
+        Database db("test_data/accounts.dat");
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threadCount; t++) {
+            workers.emplace_back([&db]() {
+                for (int i = 0; i < depositsPerThread; i++) {
+                    EXPECT_TRUE(db.deposit("TEST001_SAV_1", Money::fromUnits(1), "Background"));
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        
+        // Операции вернулись сразу; журнал переносится в сегменты фоновым потоком
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while ((archiveExists() || journalLines() >= total) && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_FALSE(archiveExists());
+        EXPECT_LT(journalLines(), total);
+    }
+    
+    // Снимок взят посреди потока операций: остальные доигрываются из нового журнала
+    Database reloaded("test_data/accounts.dat");
+    ClientData* owner = nullptr;
+    Account* account = nullptr;
+    ASSERT_TRUE(reloaded.findAccount("TEST001_SAV_1", &owner, &account));
+    EXPECT_EQ(account->getBalance(), Money::fromUnits(100000 + total));
+    EXPECT_EQ(account->getTransactionHistory().size(), total);
+    
+    // Сбой после дописывания архива, но до усечения журнала: записи лежат в обоих
+    // файлах и доигрываются один раз
+    ASSERT_TRUE(reloaded.deposit("TEST001_SAV_1", Money::fromUnits(1), "Duplicated"));
+    {
+        std::ifstream journal("test_data/accounts.dat.journal", std::ios::binary);
+        std::ofstream archive("test_data/accounts.dat.journal.checkpoint", std::ios::binary | std::ios::app);
+        archive << journal.rdbuf();
+    }
+    Database recovered("test_data/accounts.dat");
+    ASSERT_TRUE(recovered.findAccount("TEST001_SAV_1", &owner, &account));
+    EXPECT_EQ(account->getBalance(), Money::fromUnits(100000 + total + 1));
+    EXPECT_EQ(account->getTransactionHistory().size(), total + 1);
+}
+
+// Тест 36: Файлы заменяются целиком, повреждения ловятся контрольными суммами
+TEST_F(BankSystemTest, DurableFiles) {
+    auto readFile = [](const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    };
+    auto writeFile = [](const std::string& path, const std::string& data) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << data;
+    };
+    auto segmentFile = [](size_t segment) {
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), ".seg.%02zu", segment);
+        return "test_data/accounts.dat" + std::string(suffix);
+    };
+    
+    // Контрольное значение CRC-32C и подсчёт по частям
+    const std::string check = "123456789";
+    EXPECT_EQ(Crc32c::compute(check.data(), check.size()), 0xE3069283u);
+    EXPECT_EQ(Crc32c::compute(check.data() + 4, 5, Crc32c::compute(check.data(), 4)), 0xE3069283u);
+    
+    // Несколько блоков с неполным последним; проверка в пуле и без него
+    std::string payload(3 * DurableFile::kBlockSize + 123, '\0');
+    for (size_t i = 0; i < payload.size(); i++) {
+        payload[i] = static_cast<char>(i * 131 + i / 7);
+    }
+    std::string sealed = payload;
+    DurableFile::appendChecksums(sealed);
+    WorkerPool pool(4);
+    pool.start();
+    size_t payloadSize = 0;
+    const DurableFile::LegacyCheck text = DurableFile::isLegacyText;
+    ASSERT_TRUE(DurableFile::verify(sealed.data(), sealed.size(), payloadSize, text, &pool));
+    EXPECT_EQ(payloadSize, payload.size());
+    
+    std::string flipped = sealed;
+    flipped[2 * DurableFile::kBlockSize + 5] ^= 0x10;
+    EXPECT_FALSE(DurableFile::verify(flipped.data(), flipped.size(), payloadSize, text, &pool));
+    flipped = sealed;
+    flipped[payload.size() + 2] ^= 0x01; // таблица сумм
+    EXPECT_FALSE(DurableFile::verify(flipped.data(), flipped.size(), payloadSize, text));
+    std::string cut = sealed.substr(0, payload.size()) + sealed.substr(payload.size() + 4);
+    EXPECT_FALSE(DurableFile::verify(cut.data(), cut.size(), payloadSize, text));
+    pool.stop();
+    
+    // Испорченная магия или оборванный хвост не превращают файл в "прежнюю версию"
+    flipped = sealed;
+    flipped[sealed.size() - 20] ^= 0x01;
+    EXPECT_FALSE(DurableFile::verify(flipped.data(), flipped.size(), payloadSize, text));
+    std::string torn = sealed.substr(0, sealed.size() - 10);
+    EXPECT_FALSE(DurableFile::verify(torn.data(), torn.size(), payloadSize, text));
+    std::string sealedText = "REQ1|ACC1|VERIFICATION|0||Name|1700000000|PENDING|\n";
+    DurableFile::appendChecksums(sealedText);
+    torn = sealedText.substr(0, sealedText.size() - 3);
+    EXPECT_FALSE(DurableFile::verify(torn.data(), torn.size(), payloadSize, text));
+    
+    // Файл без сумм принимается, только если формат прежний
+    EXPECT_FALSE(DurableFile::verify(payload.data(), payload.size(), payloadSize, text));
+    const std::string legacyText = "REQ1|ACC1|VERIFICATION|0||Name|1700000000|PENDING|\n";
+    ASSERT_TRUE(DurableFile::verify(legacyText.data(), legacyText.size(), payloadSize, text));
+    EXPECT_EQ(payloadSize, legacyText.size());
+    
+    // Запись через временный файл: после неё в каталоге только сам файл
+    ASSERT_TRUE(DurableFile::write("test_data/durable/nested/file.bin", sealed));
+    std::string loaded;
+    ASSERT_TRUE(DurableFile::read("test_data/durable/nested/file.bin", loaded, text));
+    EXPECT_EQ(loaded, payload);
+    size_t entries = 0;
+    for (const auto& entry : std::filesystem::directory_iterator("test_data/durable/nested")) {
+        entries++;
+        EXPECT_EQ(entry.path().filename().string(), "file.bin");
+    }
+    EXPECT_EQ(entries, 1u);
+    
+    // Настройки переживают перезапуск
+    BankSettings settings;
+    settings.creditInterestRate = 15.5;
+    settings.largeOperationThreshold = Money::fromUnits(777);
+    {
+        Database db("test_data/accounts.dat");
+        ASSERT_TRUE(db.saveSettings(settings));
+    }
+    {
+        Database db("test_data/accounts.dat");
+        EXPECT_DOUBLE_EQ(db.getSettings().creditInterestRate, 15.5);
+        EXPECT_EQ(db.getSettings().largeOperationThreshold, Money::fromUnits(777));
+    }
+    
+    // Восстановление из копии прервано до удаления сегментов: они старше копии и пропускаются
+    std::vector<std::string> staleSegments;
+    {
+        Database db("test_data/accounts.dat");
+        ASSERT_TRUE(db.backupDatabase("test_data/backup/accounts.bak"));
+        ASSERT_TRUE(db.deposit("TEST001_SAV_1", Money::fromUnits(50), "After backup"));
+        ASSERT_TRUE(db.saveToFile());
+        for (size_t s = 0; s < Database::kSegments; s++) {
+            staleSegments.push_back(readFile(segmentFile(s)));
+        }
+        ASSERT_TRUE(db.restoreFromBackup("test_data/backup/accounts.bak"));
+    }
+    for (size_t s = 0; s < Database::kSegments; s++) {
+        writeFile(segmentFile(s), staleSegments[s]);
+    }
+    {
+        Database db("test_data/accounts.dat");
+        ClientData* owner = nullptr;
+        Account* account = nullptr;
+        ASSERT_TRUE(db.findAccount("TEST001_SAV_1", &owner, &account));
+        EXPECT_EQ(account->getBalance(), Money::fromUnits(100000));
+        EXPECT_DOUBLE_EQ(db.getSettings().creditInterestRate, 15.5);
+        
+        // Повреждённая копия отвергается, база не трогается
+        std::string backup = readFile("test_data/backup/accounts.bak");
+        backup[backup.size() / 3] ^= 0x20;
+        writeFile("test_data/backup/accounts.bak", backup);
+        EXPECT_FALSE(db.restoreFromBackup("test_data/backup/accounts.bak"));
+        ASSERT_TRUE(db.deposit("TEST001_SAV_1", Money::fromUnits(1), "After failed restore"));
+        ASSERT_TRUE(db.saveToFile());
+    }
+    
+    // Испорченный байт в сегменте - загрузка отказывает, а не читает мусор
+    std::string segment;
+    std::string segmentPath;
+    for (size_t s = 0; s < Database::kSegments && segment.size() < 64; s++) {
+        segmentPath = segmentFile(s);
+        segment = readFile(segmentPath);
+    }
+    ASSERT_GE(segment.size(), 64u);
+    
+    // Снимок версии 3 без хвоста сумм - оборванная запись, а не файл прежней версии
+    writeFile(segmentPath, segment.substr(0, segment.size() - 24));
+    {
+        Database truncated("test_data/accounts.dat");
+        EXPECT_FALSE(truncated.loadFromFile());
+    }
+    
+    segment[segment.size() / 4] ^= 0x04;
+    writeFile(segmentPath, segment);
+    Database damaged("test_data/accounts.dat");
+    EXPECT_FALSE(damaged.loadFromFile());
+}
+
+// Тест 37: Оборванная сбоем запись журнала отрезается и не поглощает следующие
+TEST_F(BankSystemTest, TornJournalTail) {
+    auto readFile = [](const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    };
+    auto writeFile = [](const std::string& path, const std::string& data) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << data;
+    };
+    const std::string journalPath = "test_data/accounts.dat.journal";
+    
+    std::string firstRecord;
+    {
+        Database db("test_data/accounts.dat");
+        ASSERT_TRUE(db.deposit("TEST001_SAV_1", Money::fromUnits(100), "Before crash"));
+        firstRecord = readFile(journalPath);
+        ASSERT_TRUE(db.deposit("TEST001_SAV_1", Money::fromUnits(1000), "Torn"));
+    }
+    
+    // Сбой посреди дописывания: от второй записи на диске лишь половина строки
+    std::string journal = readFile(journalPath);
+    ASSERT_GT(journal.size(), firstRecord.size());
+    size_t tornSize = firstRecord.size() + (journal.size() - firstRecord.size()) / 2;
+    writeFile(journalPath, journal.substr(0, tornSize));
+    
+    {
+        Database db("test_data/accounts.dat");
+        ClientData* owner = nullptr;
+        Account* account = nullptr;
+        ASSERT_TRUE(db.findAccount("TEST001_SAV_1", &owner, &account));
+        EXPECT_EQ(account->getBalance(), Money::fromUnits(100100));
+        // Хвост отрезан до того, как журнал снова открылся на дописывание
+        EXPECT_EQ(readFile(journalPath), firstRecord);
+        ASSERT_TRUE(db.deposit("TEST001_SAV_1", Money::fromUnits(200), "After restart"));
+    }
+    
+    // Подтверждённая после перезапуска операция переживает и второй перезапуск
+    {
+        Database db("test_data/accounts.dat");
+        ClientData* owner = nullptr;
+        Account* account = nullptr;
+        ASSERT_TRUE(db.findAccount("TEST001_SAV_1", &owner, &account));
+        EXPECT_EQ(account->getBalance(), Money::fromUnits(100300));
+        ASSERT_EQ(account->getTransactionHistory().size(), 2u);
+        EXPECT_EQ(account->getTransactionHistory()[1].description, "After restart");
+    }
+    
+    // Испорченный байт внутри записи: запись отбрасывается целиком по сумме,
+    // соседние читаются
+    {
+        Journal writer("test_data/damaged.journal", "test-key");
+        ASSERT_TRUE(writer.append("A|"));
+        ASSERT_TRUE(writer.append("B|"));
+        ASSERT_TRUE(writer.append("C|"));
+    }
+    std::string damaged = readFile("test_data/damaged.journal");
+    size_t second = damaged.find('\n') + 1;
+    damaged[damaged.find('\n', second) - 2] ^= 0x01;
+    writeFile("test_data/damaged.journal", damaged);
+    
+    Journal reopened("test_data/damaged.journal", "test-key");
+    std::string order;
+    ASSERT_TRUE(reopened.replay([&order](const std::string& record) { order += record; }));
+    EXPECT_EQ(order, "A|C|");
+    
+    // Поле без завершающего '|' - обрезанная запись, а не последнее поле
+    std::stringstream unterminated("Rent|1");
+    std::string field;
+    EXPECT_TRUE(Journal::readField(unterminated, field));
+    EXPECT_EQ(field, "Rent");
+    EXPECT_FALSE(Journal::readField(unterminated, field));
+}
+
+// Тест 38: Обрезанная запись пакета при восстановлении не применяется даже частично
+TEST_F(BankSystemTest, TruncatedBatchReplay) {
+    const std::string journalPath = "test_data/accounts.dat.journal";
+    std::string key;
+    {
+        Database db("test_data/accounts.dat");
+        key = db.getEncryptionKey();
+        // Клиенты - в сегментах, в журнале останется только пакет
+        ASSERT_TRUE(db.saveToFile());
+        ASSERT_TRUE(db.transferBatch("TEST001_SAV_1", {{"SUPER_ACC", Money::fromUnits(10), "First"},
+                                                       {"SUPER_ACC", Money::fromUnits(20), "Second"},
+                                                       {"SUPER_ACC", Money::fromUnits(30), "Third"}}, true));
+    }
+    
+    std::string batch;
+    {
+        Journal journal(journalPath, key);
+        ASSERT_TRUE(journal.replay([&batch](const std::string& record) { batch = record; }));
+    }
+    ASSERT_EQ(batch.compare(0, 6, "BATCH|"), 0);
+    
+    // Запись с верной суммой, но без полей последней строки: первые две строки
+    // не должны примениться без третьей
+    std::remove(journalPath.c_str());
+    {
+        Journal journal(journalPath, key);
+        std::string truncated = batch.substr(0, batch.size() - 1);
+        ASSERT_TRUE(journal.append(truncated.substr(0, truncated.rfind('|') + 1)));
+    }
+    {
+        Database db("test_data/accounts.dat");
+        EXPECT_EQ(db.findClient("TEST001")->accounts[0].getBalance(), Money::fromUnits(100000));
+        EXPECT_TRUE(db.findClient("TEST001")->accounts[0].getTransactionHistory().empty());
+        EXPECT_EQ(db.findClient("SUPER001")->accounts[0].getBalance(), Money());
+    }
+    
+    // Целая запись применяется целиком
+    std::remove(journalPath.c_str());
+    {
+        Journal journal(journalPath, key);
+        ASSERT_TRUE(journal.append(batch));
+    }
+    Database db("test_data/accounts.dat");
+    EXPECT_EQ(db.findClient("TEST001")->accounts[0].getBalance(), Money::fromUnits(99940));
+    EXPECT_EQ(db.findClient("TEST001")->accounts[0].getTransactionHistory().size(), 3u);
+    EXPECT_EQ(db.findClient("SUPER001")->accounts[0].getBalance(), Money::fromUnits(60));
+}
+
+// Тест 39: Регистрация и верификация клиента пишутся в журнал, а не переписывают сегменты
+TEST_F(BankSystemTest, RegistrationJournaled) {
+    auto readFile = [](const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    };
+    auto segmentFile = [](size_t segment) {
+        char suffix[16];
+        std::snprintf(suffix, sizeof(suffix), ".seg.%02zu", segment);
+        return "test_data/accounts.dat" + std::string(suffix);
+    };
+    const std::string journalPath = "test_data/accounts.dat.journal";
+    
+    ClientData client;
+    client.accountId = "REG001";
+    client.fullName = "Journal | Client";
+    client.birthDate = "1985-05-05";
+    client.passportData = "R|1";
+    client.passwordHash = Crypto::hashPassword("pass");
+    client.status = ClientStatus::PENDING_VERIFICATION;
+    client.accounts.push_back(Account("REG001_SAV_1", AccountType::SAVINGS, Money::fromUnits(50)));
+    client.accounts.back().addTransaction("DEPOSIT", Money::fromUnits(50), "Opening | deposit");
+    
+    {
+        Database db("test_data/accounts.dat");
+        ASSERT_TRUE(db.saveToFile());
+        std::vector<std::string> segments(Database::kSegments);
+        for (size_t s = 0; s < Database::kSegments; s++) {
+            segments[s] = readFile(segmentFile(s));
+        }
+        size_t journalSize = readFile(journalPath).size();
+        
+        ASSERT_TRUE(db.addClient(client));
+        EXPECT_FALSE(db.addClient(client));
+        ASSERT_TRUE(db.verifyClient("REG001"));
+        EXPECT_FALSE(db.verifyClient("MISSING"));
+        
+        // Сегменты не тронуты, обе записи - в журнале
+        for (size_t s = 0; s < Database::kSegments; s++) {
+            EXPECT_EQ(readFile(segmentFile(s)), segments[s]) << segmentFile(s);
+        }
+        EXPECT_GT(readFile(journalPath).size(), journalSize);
+        
+        // Новый клиент сразу доступен для операций, и они тоже ложатся в журнал
+        ASSERT_TRUE(db.deposit("REG001_SAV_1", Money::fromUnits(25), "After register"));
+    }
+    
+    // Перезапуск без контрольной точки: клиент, статус и операции - из журнала
+    {
+        Database db("test_data/accounts.dat");
+        ClientData* restored = db.findClient("REG001");
+        ASSERT_NE(restored, nullptr);
+        EXPECT_EQ(restored->fullName, "Journal | Client");
+        EXPECT_EQ(restored->passportData, "R|1");
+        EXPECT_EQ(restored->passwordHash, client.passwordHash);
+        EXPECT_EQ(restored->status, ClientStatus::VERIFIED);
+        ASSERT_EQ(restored->accounts.size(), 1u);
+        EXPECT_EQ(restored->accounts[0].getBalance(), Money::fromUnits(75));
+        const TransactionLog& history = restored->accounts[0].getTransactionHistory();
+        ASSERT_EQ(history.size(), 2u);
+        EXPECT_EQ(history[0].description, "Opening | deposit");
+        EXPECT_EQ(history[1].description, "After register");
+        
+        // После контрольной точки журнал пуст, а клиент - в сегменте
+        ASSERT_TRUE(db.saveToFile());
+    }
+    Database db("test_data/accounts.dat");
+    ClientData* restored = db.findClient("REG001");
+    ASSERT_NE(restored, nullptr);
+    EXPECT_EQ(restored->status, ClientStatus::VERIFIED);
+    EXPECT_EQ(restored->accounts[0].getBalance(), Money::fromUnits(75));
+    EXPECT_EQ(restored->accounts[0].getTransactionHistory().size(), 2u);
+    
+    // Журнал недоступен - регистрация не проходит и не оставляет клиента
+    std::remove(journalPath.c_str());
+    ASSERT_TRUE(std::filesystem::create_directory(journalPath));
+    ClientData other = client;
+    other.accountId = "REG002";
+    other.accounts = {Account("REG002_SAV_1", AccountType::SAVINGS, Money())};
+    EXPECT_FALSE(db.addClient(other));
+    EXPECT_EQ(db.findClient("REG002"), nullptr);
+    EXPECT_FALSE(db.findAccount("REG002_SAV_1"));
+    ASSERT_TRUE(std::filesystem::remove(journalPath));
+    ASSERT_TRUE(db.addClient(other));
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     